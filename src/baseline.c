@@ -0,0 +1,198 @@
+#include <config.h>
+
+#include "baseline.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BASELINE_HEADER "# stest baseline 1"
+
+typedef struct {
+    char *name;
+    double *samples;
+    size_t len;
+} BaselineEntry;
+
+struct baseline_t {
+    BaselineEntry *entries;
+    size_t len;
+    size_t size;
+    /** whether entries are sorted by name */
+    int sorted;
+};
+
+Baseline * baseline_new(void)
+{
+    Baseline *b = calloc(1, sizeof(Baseline));
+    b->sorted = 1;
+    return b;
+}
+
+void baseline_free(Baseline *b)
+{
+    size_t i;
+
+    if (b) {
+        for (i = 0; i < b->len; i++) {
+            free(b->entries[i].name);
+            free(b->entries[i].samples);
+        }
+        free(b->entries);
+    }
+    free(b);
+}
+
+void baseline_add(Baseline *b, const char *name,
+                  const double *samples, size_t len)
+{
+    BaselineEntry *e;
+
+    if (b->len == b->size) {
+        b->size = b->size ? 2 * b->size : 64;
+        b->entries = realloc(b->entries, b->size * sizeof(BaselineEntry));
+    }
+    e = &b->entries[b->len++];
+    e->name = strdup(name);
+    e->samples = malloc((len ? len : 1) * sizeof(double));
+    memcpy(e->samples, samples, len * sizeof(double));
+    e->len = len;
+    b->sorted = 0;
+}
+
+static int
+compare_entries(const void *a, const void *b)
+{
+    return strcmp(((const BaselineEntry *) a)->name,
+                  ((const BaselineEntry *) b)->name);
+}
+
+const double * baseline_find(Baseline *b, const char *name, size_t *len)
+{
+    BaselineEntry key, *e;
+
+    if (!b->sorted) {
+        qsort(b->entries, b->len, sizeof(BaselineEntry), compare_entries);
+        b->sorted = 1;
+    }
+    key.name = (char *) name;
+    e = bsearch(&key, b->entries, b->len, sizeof(BaselineEntry),
+                compare_entries);
+    if (e == NULL) {
+        return NULL;
+    }
+    *len = e->len;
+    return e->samples;
+}
+
+/**
+ * Parse one line of baseline file and add it to the baseline.
+ *
+ * @return 1 on success, 0 if the line is malformed
+ */
+static int
+baseline_parse_line(Baseline *b, char *line, double **buf, size_t *size)
+{
+    char *tab, *str, *end;
+    size_t len = 0;
+    double value;
+
+    tab = strchr(line, '\t');
+    if (tab == NULL) {
+        return 0;
+    }
+    *tab = '\0';
+
+    for (str = tab + 1; ; str = end) {
+        value = strtod(str, &end);
+        if (end == str) break;
+        if (len == *size) {
+            *size = *size ? 2 * *size : 16;
+            *buf = realloc(*buf, *size * sizeof(double));
+        }
+        (*buf)[len++] = value;
+    }
+    while (*str == ' ' || *str == '\n') str++;
+    if (*str != '\0') {
+        return 0;
+    }
+    baseline_add(b, line, *buf, len);
+    return 1;
+}
+
+Baseline * baseline_load(const char *path)
+{
+    Baseline *b;
+    FILE *fh;
+    char *line = NULL;
+    size_t line_size = 0, buf_size = 0;
+    double *buf = NULL;
+    unsigned int line_num = 1;
+    ssize_t n;
+
+    fh = fopen(path, "r");
+    if (fh == NULL) {
+        fprintf(stderr, "Can not read baseline '%s': %s\n", path,
+                strerror(errno));
+        return NULL;
+    }
+
+    b = baseline_new();
+    n = getline(&line, &line_size, fh);
+    if (n < 0 || strncmp(line, BASELINE_HEADER, strlen(BASELINE_HEADER)) != 0) {
+        fprintf(stderr, "File '%s' is not a baseline\n", path);
+        goto fail;
+    }
+    while ((n = getline(&line, &line_size, fh)) >= 0) {
+        line_num++;
+        if (!baseline_parse_line(b, line, &buf, &buf_size)) {
+            fprintf(stderr, "Malformed baseline '%s' on line %u\n",
+                    path, line_num);
+            goto fail;
+        }
+    }
+
+    free(buf);
+    free(line);
+    fclose(fh);
+    return b;
+
+fail:
+    free(buf);
+    free(line);
+    fclose(fh);
+    baseline_free(b);
+    return NULL;
+}
+
+int baseline_save(Baseline *b, const char *path)
+{
+    char *data = NULL;
+    size_t i, j, len = 0;
+    FILE *fh;
+    int ok;
+
+    ok = (fh = open_memstream(&data, &len)) != NULL;
+    if (ok) {
+        fprintf(fh, "%s\n", BASELINE_HEADER);
+    }
+    for (i = 0; ok && i < b->len; i++) {
+        fprintf(fh, "%s\t", b->entries[i].name);
+        for (j = 0; j < b->entries[i].len; j++) {
+            fprintf(fh, "%s%.9g", j > 0 ? " " : "", b->entries[i].samples[j]);
+        }
+        fprintf(fh, "\n");
+    }
+    if (fh != NULL) {
+        ok = !ferror(fh) && fclose(fh) == 0 && ok;
+    }
+    ok = ok && write_file(path, data, len);
+    if (!ok) {
+        fprintf(stderr, "Can not write baseline '%s': %s\n", path,
+                strerror(errno));
+    }
+    free(data);
+    return ok;
+}
@@ -0,0 +1,67 @@
+#ifndef BASELINE_H
+#define BASELINE_H
+
+#include <config.h>
+
+#include <stddef.h>
+
+/**
+ * Baseline stores wall clock times measured in benchmark mode for each test.
+ * It is saved as a text file with one test per line: name of the test, tab
+ * and space separated samples in seconds.
+ */
+typedef struct baseline_t Baseline;
+
+/**
+ * Create new empty baseline.
+ *
+ * @return new baseline
+ */
+Baseline * baseline_new(void);
+
+/**
+ * Load baseline from a file. On failure, error message is printed.
+ *
+ * @param path  file to read
+ * @return loaded baseline or NULL on failure
+ */
+Baseline * baseline_load(const char *path);
+
+/**
+ * Write baseline to a file. On failure, error message is printed.
+ *
+ * @param b     baseline to save
+ * @param path  where to write
+ * @return 1 on success, 0 on failure
+ */
+int baseline_save(Baseline *b, const char *path);
+
+/**
+ * Free baseline and all its samples.
+ *
+ * @param b     baseline to be freed (allow-none)
+ */
+void baseline_free(Baseline *b);
+
+/**
+ * Add samples of a test. The samples are copied.
+ *
+ * @param b         baseline
+ * @param name      name of the test
+ * @param samples   measured times
+ * @param len       number of samples
+ */
+void baseline_add(Baseline *b, const char *name,
+                  const double *samples, size_t len);
+
+/**
+ * Find samples of a test.
+ *
+ * @param b     baseline
+ * @param name  name of the test
+ * @param len   where to store number of samples (out)
+ * @return samples (transfer none) or NULL if the test is not present
+ */
+const double * baseline_find(Baseline *b, const char *name, size_t *len);
+
+#endif /* end of include guard: BASELINE_H */
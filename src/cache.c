@@ -0,0 +1,193 @@
+#include <config.h>
+
+#include "cache.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FNV_PRIME UINT64_C(0x100000001b3)
+
+typedef struct {
+    char *name;
+    uint64_t key;
+    int passed;
+} CacheEntry;
+
+struct cache_t {
+    char *path;
+    CacheEntry *entries;
+    size_t len;
+    size_t size;
+    /** whether entries are sorted by name */
+    int sorted;
+};
+
+uint64_t cache_hash(uint64_t hash, const void *buf, size_t len)
+{
+    const unsigned char *p = buf;
+
+    while (len-- > 0) {
+        hash = (hash ^ *p++) * FNV_PRIME;
+    }
+    return hash;
+}
+
+uint64_t cache_hash_file(uint64_t hash, const char *path)
+{
+    struct stat info;
+    void *data;
+    uint64_t size;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &info) < 0) {
+        if (fd >= 0) close(fd);
+        return cache_hash(hash, "-", 1);
+    }
+    size = info.st_size;
+    hash = cache_hash(hash, &size, sizeof(size));
+    if (size > 0) {
+        data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            hash = cache_hash(hash, data, size);
+            munmap(data, size);
+        } else {
+            /* Make sure the key does not match anything. */
+            hash = cache_hash(hash, &info.st_mtime, sizeof(info.st_mtime));
+        }
+    }
+    close(fd);
+    return hash;
+}
+
+static int
+compare_entries(const void *a, const void *b)
+{
+    return strcmp(((const CacheEntry *) a)->name,
+                  ((const CacheEntry *) b)->name);
+}
+
+static CacheEntry *
+cache_find(Cache *c, const char *name)
+{
+    CacheEntry key;
+
+    if (!c->sorted) {
+        qsort(c->entries, c->len, sizeof(CacheEntry), compare_entries);
+        c->sorted = 1;
+    }
+    key.name = (char *) name;
+    return bsearch(&key, c->entries, c->len, sizeof(CacheEntry),
+                   compare_entries);
+}
+
+static void
+cache_add(Cache *c, const char *name, uint64_t key)
+{
+    CacheEntry *e;
+
+    if (c->len == c->size) {
+        c->size = c->size ? 2 * c->size : 64;
+        c->entries = realloc(c->entries, c->size * sizeof(CacheEntry));
+    }
+    e = &c->entries[c->len++];
+    e->name = strdup(name);
+    e->key = key;
+    e->passed = 1;
+    c->sorted = 0;
+}
+
+Cache * cache_load(const char *path)
+{
+    Cache *c;
+    FILE *fh;
+    char *line = NULL, *tab, *end;
+    size_t line_size = 0;
+    uint64_t key;
+
+    c = calloc(1, sizeof(Cache));
+    c->path = strdup(path);
+    c->sorted = 1;
+
+    fh = fopen(path, "r");
+    if (fh == NULL) {
+        return c;
+    }
+    while (getline(&line, &line_size, fh) >= 0) {
+        tab = strchr(line, '\t');
+        if (tab == NULL) continue;
+        *tab = '\0';
+        key = strtoull(tab + 1, &end, 16);
+        if (end == tab + 1 || (*end != '\n' && *end != '\0')) continue;
+        cache_add(c, line, key);
+    }
+    free(line);
+    fclose(fh);
+    return c;
+}
+
+int cache_save(Cache *c)
+{
+    char *data = NULL;
+    size_t i, len = 0;
+    FILE *fh;
+    int ok;
+
+    ok = (fh = open_memstream(&data, &len)) != NULL;
+    for (i = 0; ok && i < c->len; i++) {
+        if (c->entries[i].passed) {
+            fprintf(fh, "%s\t%016" PRIx64 "\n", c->entries[i].name,
+                    c->entries[i].key);
+        }
+    }
+    if (fh != NULL) {
+        ok = !ferror(fh) && fclose(fh) == 0 && ok;
+    }
+    ok = ok && write_file(c->path, data, len);
+    if (!ok) {
+        fprintf(stderr, "Can not write cache '%s': %s\n", c->path,
+                strerror(errno));
+    }
+    free(data);
+    return ok;
+}
+
+void cache_free(Cache *c)
+{
+    size_t i;
+
+    if (c) {
+        for (i = 0; i < c->len; i++) {
+            free(c->entries[i].name);
+        }
+        free(c->entries);
+        free(c->path);
+    }
+    free(c);
+}
+
+int cache_lookup(Cache *c, const char *name, uint64_t key)
+{
+    CacheEntry *e = cache_find(c, name);
+    return e != NULL && e->passed && e->key == key;
+}
+
+void cache_update(Cache *c, const char *name, uint64_t key, int passed)
+{
+    CacheEntry *e = cache_find(c, name);
+
+    if (e == NULL) {
+        if (passed) cache_add(c, name, key);
+        return;
+    }
+    e->key = key;
+    e->passed = passed;
+}
@@ -0,0 +1,93 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <config.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Cache of passed tests. For each test it stores a key computed from
+ * everything the result depends on. If the key of a test did not change
+ * since it last passed, there is no need to run it again.
+ *
+ * The cache is saved as a text file with one test per line: name of the
+ * test, tab and hexadecimal key.
+ */
+typedef struct cache_t Cache;
+
+/**
+ * Name of the cache file in STATE_DIR.
+ */
+#define CACHE_FILE "cache"
+
+/**
+ * Initial value of the hash.
+ */
+#define CACHE_HASH_INIT UINT64_C(0xcbf29ce484222325)
+
+/**
+ * Update hash with a buffer. The hash is 64-bit FNV-1a.
+ *
+ * @param hash  current value of the hash
+ * @param buf   data to add
+ * @param len   length of the data
+ * @return updated hash
+ */
+uint64_t cache_hash(uint64_t hash, const void *buf, size_t len);
+
+/**
+ * Update hash with content of a file. Missing file gives different hash
+ * than an empty one.
+ *
+ * @param hash  current value of the hash
+ * @param path  file to read
+ * @return updated hash
+ */
+uint64_t cache_hash_file(uint64_t hash, const char *path);
+
+/**
+ * Load cache from a file. Missing or malformed file gives an empty cache.
+ *
+ * @param path  file to read
+ * @return new cache
+ */
+Cache * cache_load(const char *path);
+
+/**
+ * Write cache to the file it was loaded from. The file is replaced
+ * atomically. On failure, error message is printed.
+ *
+ * @param c     cache to save
+ * @return 1 on success, 0 on failure
+ */
+int cache_save(Cache *c);
+
+/**
+ * Free cache.
+ *
+ * @param c     cache to be freed (allow-none)
+ */
+void cache_free(Cache *c);
+
+/**
+ * Check whether a test passed with given key.
+ *
+ * @param c     cache
+ * @param name  name of the test
+ * @param key   current key of the test
+ * @return 1 if the test passed with the same key, 0 otherwise
+ */
+int cache_lookup(Cache *c, const char *name, uint64_t key);
+
+/**
+ * Record that a test passed or failed.
+ *
+ * @param c         cache
+ * @param name      name of the test
+ * @param key       key the test was run with
+ * @param passed    whether the test passed
+ */
+void cache_update(Cache *c, const char *name, uint64_t key, int passed);
+
+#endif /* end of include guard: CACHE_H */
@@ -0,0 +1,272 @@
+#include <config.h>
+
+#include "capture.h"
+#include "scan.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/**
+ * How much data is read from the pipe at once.
+ */
+#define READ_CHUNK (64 * 1024)
+
+struct capture_t {
+    int read_fd;
+    int write_fd;
+    /** data kept in memory */
+    char *data;
+    size_t size;
+    /** total number of captured bytes */
+    size_t len;
+    size_t limit;
+    /** maximum number of bytes to capture */
+    size_t max;
+    /** number of bytes received once max was exceeded, 0 otherwise */
+    size_t exceeded;
+    /** temporary file used once the limit is exceeded, -1 otherwise */
+    int file_fd;
+    /** mapping of the temporary file */
+    char *map;
+    /** content the data are compared with as they come, NULL if none */
+    const char *expected;
+    size_t expected_len;
+    /** whether the data differ from the expected content */
+    int diverged;
+    /** offset of the first different byte */
+    size_t diverged_at;
+};
+
+static int
+set_cloexec(int fd)
+{
+    int flags = fcntl(fd, F_GETFD);
+    return flags >= 0 && fcntl(fd, F_SETFD, flags | FD_CLOEXEC) == 0;
+}
+
+static int
+write_all(int fd, const char *buf, size_t len)
+{
+    ssize_t n;
+
+    while (len > 0) {
+        n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 1;
+}
+
+Capture * capture_new(size_t limit)
+{
+    Capture *c;
+    int fds[2];
+
+    if (pipe(fds) < 0) {
+        return NULL;
+    }
+    set_cloexec(fds[PIPE_READ]);
+    set_cloexec(fds[PIPE_WRITE]);
+    fcntl(fds[PIPE_READ], F_SETFL, fcntl(fds[PIPE_READ], F_GETFL) | O_NONBLOCK);
+
+    c = calloc(1, sizeof(Capture));
+    c->read_fd = fds[PIPE_READ];
+    c->write_fd = fds[PIPE_WRITE];
+    c->limit = limit;
+    c->max = SIZE_MAX;
+    c->file_fd = -1;
+    return c;
+}
+
+void capture_free(Capture *c)
+{
+    if (c) {
+        if (c->read_fd >= 0) close(c->read_fd);
+        if (c->write_fd >= 0) close(c->write_fd);
+        if (c->map) munmap(c->map, c->len);
+        if (c->file_fd >= 0) close(c->file_fd);
+        free(c->data);
+    }
+    free(c);
+}
+
+int capture_take_write_fd(Capture *c)
+{
+    int fd = c->write_fd;
+    c->write_fd = -1;
+    return fd;
+}
+
+int capture_get_read_fd(Capture *c)
+{
+    return c->read_fd;
+}
+
+/**
+ * Move data captured so far to an unlinked temporary file. If the file can
+ * not be created, the data is kept in memory without any limit.
+ */
+static void
+capture_spill(Capture *c)
+{
+    char path[] = "/tmp/stest-output-XXXXXX";
+
+    c->file_fd = mkstemp(path);
+    if (c->file_fd >= 0) {
+        unlink(path);
+        set_cloexec(c->file_fd);
+        if (write_all(c->file_fd, c->data, c->len)) {
+            free(c->data);
+            c->data = NULL;
+            c->size = 0;
+            return;
+        }
+        close(c->file_fd);
+        c->file_fd = -1;
+    }
+    c->limit = SIZE_MAX;
+}
+
+/**
+ * Compare newly read data with the expected content at the same offset.
+ */
+static void
+capture_compare(Capture *c, const char *data, size_t len)
+{
+    const char *expected = c->expected + c->len;
+    size_t i, n = 0;
+
+    if (c->len < c->expected_len) {
+        n = c->expected_len - c->len;
+        if (n > len) n = len;
+    }
+    if ((i = scan_first_difference(expected, data, n)) < n) {
+        c->diverged = 1;
+        c->diverged_at = c->len + i;
+    } else if (len > n) {
+        c->diverged = 1;
+        c->diverged_at = c->len + n;
+    }
+}
+
+int capture_read(Capture *c)
+{
+    char buffer[READ_CHUNK];
+    char *dest = buffer;
+    size_t size;
+    ssize_t n;
+
+    return_val_if_fail(c->read_fd >= 0, 0);
+
+    if (c->file_fd < 0 && c->size - c->len < READ_CHUNK) {
+        if (c->len + READ_CHUNK > c->limit) {
+            capture_spill(c);
+        }
+        if (c->file_fd < 0) {
+            size = 2 * c->size;
+            if (size < c->len + READ_CHUNK) size = c->len + READ_CHUNK;
+            if (size > c->limit) size = c->limit;
+            c->data = realloc(c->data, size);
+            c->size = size;
+        }
+    }
+    if (c->file_fd < 0) {
+        dest = c->data + c->len;
+    }
+
+    n = read(c->read_fd, dest, READ_CHUNK);
+    if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+        return 1;
+    }
+    if (n > 0 && (size_t) n > c->max - c->len) {
+        c->exceeded = c->len + n;
+        n = c->max - c->len;
+    }
+    if (n < 0 || (n > 0 && c->file_fd >= 0
+                  && !write_all(c->file_fd, buffer, n))) {
+        capture_close(c);
+        return 0;
+    }
+    if (c->expected && !c->diverged) {
+        capture_compare(c, dest, n);
+    }
+    c->len += n;
+    if (n == 0 || c->exceeded) {
+        capture_close(c);
+        return 0;
+    }
+    return 1;
+}
+
+void capture_drain(Capture *c)
+{
+    size_t len;
+
+    /* Nothing is read once the pipe is empty. */
+    do {
+        len = c->len;
+    } while (c->read_fd >= 0 && capture_read(c) && c->len != len);
+    capture_close(c);
+}
+
+void capture_close(Capture *c)
+{
+    if (c->read_fd >= 0) {
+        close(c->read_fd);
+        c->read_fd = -1;
+    }
+}
+
+void capture_set_max(Capture *c, size_t max)
+{
+    c->max = max;
+}
+
+int capture_exceeded(Capture *c, size_t *received)
+{
+    if (c->exceeded) {
+        *received = c->exceeded;
+    }
+    return c->exceeded != 0;
+}
+
+void capture_set_expected(Capture *c, const char *expected, size_t len)
+{
+    c->expected = expected;
+    c->expected_len = len;
+}
+
+int capture_diverged(Capture *c, size_t *offset)
+{
+    if (c->diverged) {
+        *offset = c->diverged_at;
+    }
+    return c->diverged;
+}
+
+const char * capture_get_data(Capture *c, size_t *len)
+{
+    *len = c->len;
+    if (c->len == 0) {
+        return "";
+    }
+    if (c->file_fd >= 0 && c->map == NULL) {
+        c->map = mmap(NULL, c->len, PROT_READ, MAP_PRIVATE, c->file_fd, 0);
+        if (c->map == MAP_FAILED) {
+            c->map = NULL;
+            *len = 0;
+            return "";
+        }
+    }
+    return c->file_fd >= 0 ? c->map : c->data;
+}
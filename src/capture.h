@@ -0,0 +1,131 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <config.h>
+
+#include <stddef.h>
+
+/**
+ * Capture collects everything written to a pipe by a tested program. The
+ * data is kept in memory unless it grows over a threshold, in which case it
+ * is moved to an anonymous temporary file.
+ */
+typedef struct capture_t Capture;
+
+/**
+ * How many bytes are kept in memory before falling back to a file.
+ */
+#define CAPTURE_MEMORY_LIMIT (4 * 1024 * 1024)
+
+/**
+ * Create new capture. Both ends of the underlying pipe are closed on exec and
+ * the reading end is non-blocking.
+ *
+ * @param limit     how many bytes to keep in memory
+ * @return new capture or NULL if pipe can not be created
+ */
+Capture * capture_new(size_t limit);
+
+/**
+ * Free memory used by the capture and close all its descriptors.
+ *
+ * @param c     capture to be freed (allow-none)
+ */
+void capture_free(Capture *c);
+
+/**
+ * Get writing end of the pipe. The ownership of the descriptor is
+ * transferred to the caller, who is responsible for closing it. This should
+ * be called exactly once.
+ *
+ * @param c     capture
+ * @return file descriptor to write to
+ */
+int capture_take_write_fd(Capture *c);
+
+/**
+ * Get reading end of the pipe that should be polled for more data.
+ *
+ * @param c     capture
+ * @return file descriptor or -1 if all data was already read
+ */
+int capture_get_read_fd(Capture *c);
+
+/**
+ * Read data available on the pipe. This function never blocks, it should be
+ * called when poll(2) reports the descriptor as readable.
+ *
+ * @param c     capture
+ * @return 1 if more data can come, 0 on end of file or error
+ */
+int capture_read(Capture *c);
+
+/**
+ * Read all data already written to the pipe and stop capturing. Used when
+ * the program exited, so that processes it left running with the pipe open
+ * do not keep the capture going.
+ *
+ * @param c     capture
+ */
+void capture_drain(Capture *c);
+
+/**
+ * Stop capturing. Reading end of the pipe is closed, data captured so far
+ * is still available.
+ *
+ * @param c     capture
+ */
+void capture_close(Capture *c);
+
+/**
+ * Limit how many bytes are captured. When the program writes more, the data
+ * over the limit are dropped and the reading end of the pipe is closed.
+ *
+ * @param c     capture
+ * @param max   maximum number of bytes to capture
+ */
+void capture_set_max(Capture *c, size_t max);
+
+/**
+ * Check whether the program wrote more data than the capture may hold.
+ *
+ * @param c         capture
+ * @param received  where to store number of bytes received, including the
+ *                  dropped ones (out)
+ * @return 1 if the limit was exceeded, 0 otherwise
+ */
+int capture_exceeded(Capture *c, size_t *received);
+
+/**
+ * Compare data with expected content as it is read, so that a difference is
+ * known before the program finishes. The content is not copied, it must be
+ * valid until the capture is freed.
+ *
+ * @param c         capture
+ * @param expected  expected content
+ * @param len       length of the expected content
+ */
+void capture_set_expected(Capture *c, const char *expected, size_t len);
+
+/**
+ * Check whether the data read so far differ from the expected content. Data
+ * longer than the expected content differ at its end, shorter data are not
+ * considered different until they are complete.
+ *
+ * @param c         capture with expected content
+ * @param offset    where to store offset of the first different byte (out)
+ * @return 1 if the data differ, 0 otherwise
+ */
+int capture_diverged(Capture *c, size_t *offset);
+
+/**
+ * Get the captured data. The returned buffer is owned by the capture and is
+ * valid until the capture is freed.
+ *
+ * @param c     capture
+ * @param len   where to store length of the data (out)
+ * @return captured data (transfer none)
+ */
+const char * capture_get_data(Capture *c, size_t *len);
+
+#endif /* end of include guard: CAPTURE_H */
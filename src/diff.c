@@ -0,0 +1,713 @@
+#include <config.h>
+
+#include "diff.h"
+#include "scan.h"
+#include "utils.h"
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * How many leading bytes are checked for NUL characters when deciding
+ * whether a buffer is binary. This is what diff(1) does as well.
+ */
+#define BINARY_PROBE 32768
+
+/**
+ * Flags that cause trailing white space to be ignored.
+ */
+#define WHITESPACE_FLAGS (DIFF_IGNORE_SPACE_CHANGE | DIFF_IGNORE_ALL_SPACE \
+                          | DIFF_IGNORE_TRAILING_SPACE)
+
+typedef struct {
+    /** original text of the line */
+    const char *start;
+    /** length of original text without newline */
+    size_t len;
+    /** normalized text used for comparison */
+    const char *key;
+    size_t key_len;
+    /** whether the line is last line missing a newline */
+    int incomplete;
+} Line;
+
+typedef struct {
+    Line *lines;
+    long num;
+    /** last line of the file is not terminated by newline */
+    int incomplete;
+    /** storage for normalized lines, NULL if not needed */
+    char *norm;
+    /** equivalence class of each line */
+    long *equivs;
+    /** changed[i] is set if i-th line is not common; index -1 and num are
+     *  valid zero sentinels */
+    char *changed;
+} DiffFile;
+
+typedef struct {
+    long line0;
+    long line1;
+    long deleted;
+    long inserted;
+} Change;
+
+typedef struct {
+    const long *xv;
+    const long *yv;
+    char *xchanged;
+    char *ychanged;
+    long *fdiag;
+    long *bdiag;
+} Context;
+
+void diff_options_init(DiffOptions *opts)
+{
+    opts->flags = 0;
+    opts->context = 3;
+}
+
+/**
+ * Parse number of context lines. Same as diff(1) does when both -u and -U
+ * are given, the larger of the values wins.
+ *
+ * @return 1 on success, 0 if str is not a number
+ */
+static int
+parse_context(DiffOptions *opts, const char *str)
+{
+    char *end;
+    long val;
+
+    return_val_if_fail(str != NULL && isdigit(*str), 0);
+    val = strtol(str, &end, 10);
+    return_val_if_fail(*end == '\0' && val <= INT_MAX, 0);
+    if (val > opts->context) opts->context = val;
+    return 1;
+}
+
+/**
+ * Handle one long option (without leading dashes).
+ *
+ * @return 1 on success, 0 if the option is not supported
+ */
+static int
+parse_long_option(DiffOptions *opts, const char *opt)
+{
+    static const struct {
+        const char *name;
+        unsigned int flag;
+    } flags[] = {
+        { "ignore-case",            DIFF_IGNORE_CASE },
+        { "ignore-space-change",    DIFF_IGNORE_SPACE_CHANGE },
+        { "ignore-all-space",       DIFF_IGNORE_ALL_SPACE },
+        { "ignore-trailing-space",  DIFF_IGNORE_TRAILING_SPACE },
+        { "strip-trailing-cr",      DIFF_STRIP_TRAILING_CR },
+        { "minimal",                0 },
+        { "unified",                0 },
+        { NULL, 0 }
+    };
+    int i;
+
+    if (strncmp(opt, "unified=", 8) == 0) {
+        return parse_context(opts, opt + 8);
+    }
+    for (i = 0; flags[i].name != NULL; i++) {
+        if (strcmp(opt, flags[i].name) == 0) {
+            opts->flags |= flags[i].flag;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int diff_options_parse(DiffOptions *opts, const char *str)
+{
+    char **args, *arg;
+    size_t i;
+    int ok = 1;
+
+    args = parse_args(str, NULL);
+    if (args == NULL) {
+        fprintf(stderr, "Malformed diff options '%s'\n", str);
+        return 0;
+    }
+
+    for (i = 0; ok && args[i] != NULL; i++) {
+        arg = args[i];
+        if (strncmp(arg, "--", 2) == 0) {
+            ok = parse_long_option(opts, arg + 2);
+            continue;
+        }
+        ok = arg[0] == '-' && arg[1] != '\0';
+        for (arg++; ok && *arg; arg++) {
+            switch (*arg) {
+            case 'u':
+            case 'd':
+                break;
+            case 'i':
+                opts->flags |= DIFF_IGNORE_CASE;
+                break;
+            case 'b':
+                opts->flags |= DIFF_IGNORE_SPACE_CHANGE;
+                break;
+            case 'w':
+                opts->flags |= DIFF_IGNORE_ALL_SPACE;
+                break;
+            case 'Z':
+                opts->flags |= DIFF_IGNORE_TRAILING_SPACE;
+                break;
+            case 'U':
+                if (arg[1] == '\0') {
+                    ok = args[i + 1] != NULL && parse_context(opts, args[++i]);
+                } else {
+                    ok = parse_context(opts, arg + 1);
+                }
+                arg += strlen(arg) - 1;
+                break;
+            default:
+                ok = 0;
+            }
+        }
+    }
+    if (!ok) {
+        fprintf(stderr, "Unsupported diff option '%s'\n", args[i - 1]);
+    }
+
+    str_array_free(args);
+    return ok;
+}
+
+/**
+ * Write normalized version of a line into out, which must have room for at
+ * least len characters.
+ *
+ * @return length of the normalized line
+ */
+static size_t
+normalize_line(const char *s, size_t len, unsigned int flags, char *out)
+{
+    size_t i, n = 0;
+    int in_space = 0;
+    unsigned char c;
+
+    if (flags & WHITESPACE_FLAGS) {
+        while (len > 0 && isspace((unsigned char) s[len - 1])) len--;
+    }
+
+    for (i = 0; i < len; i++) {
+        c = s[i];
+        if (isspace(c) && (flags & (DIFF_IGNORE_ALL_SPACE | DIFF_IGNORE_SPACE_CHANGE))) {
+            if (!FLAG_SET(flags, DIFF_IGNORE_ALL_SPACE) && !in_space) {
+                out[n++] = ' ';
+            }
+            in_space = 1;
+            continue;
+        }
+        in_space = 0;
+        out[n++] = FLAG_SET(flags, DIFF_IGNORE_CASE) ? tolower(c) : c;
+    }
+    return n;
+}
+
+/**
+ * Split buffer into lines and compute their comparison keys.
+ */
+static void
+split_lines(DiffFile *f, const char *buf, size_t len, unsigned int flags)
+{
+    const char *end = buf + len, *nl;
+    char *norm;
+    long i;
+
+    f->num = scan_count_newlines(buf, len);
+    f->incomplete = len > 0 && buf[len - 1] != '\n';
+    f->num += f->incomplete;
+
+    f->lines = malloc((f->num + 1) * sizeof(Line));
+    f->norm = flags != 0 ? malloc(len + 1) : NULL;
+    f->equivs = NULL;
+    f->changed = NULL;
+
+    norm = f->norm;
+    for (i = 0; i < f->num; i++) {
+        Line *line = &f->lines[i];
+        nl = memchr(buf, '\n', end - buf);
+        line->start = buf;
+        line->len = (nl ? nl : end) - buf;
+        line->incomplete = nl == NULL && !(flags & WHITESPACE_FLAGS);
+        buf += line->len + 1;
+        /* Stripped carriage return is not displayed either. Same as in
+         * diff(1), it is only stripped if followed by a newline. */
+        if (FLAG_SET(flags, DIFF_STRIP_TRAILING_CR) && nl != NULL
+                && line->len > 0 && line->start[line->len - 1] == '\r') {
+            line->len--;
+        }
+        if (norm) {
+            line->key = norm;
+            line->key_len = normalize_line(line->start, line->len, flags, norm);
+            norm += line->key_len;
+        } else {
+            line->key = line->start;
+            line->key_len = line->len;
+        }
+    }
+}
+
+static void
+diff_file_free(DiffFile *f)
+{
+    free(f->lines);
+    free(f->norm);
+    free(f->equivs);
+    if (f->changed) free(f->changed - 1);
+}
+
+static int
+line_equal(const Line *a, const Line *b)
+{
+    return a->key_len == b->key_len && a->incomplete == b->incomplete
+        && memcmp(a->key, b->key, a->key_len) == 0;
+}
+
+static uint32_t
+line_hash(const Line *line)
+{
+    uint32_t h = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < line->key_len; i++) {
+        h = (h ^ (unsigned char) line->key[i]) * 16777619u;
+    }
+    return h ^ line->incomplete;
+}
+
+/**
+ * Give each line a number so that lines are equal if and only if they have
+ * the same number.
+ */
+static void
+assign_equivs(DiffFile *files)
+{
+    struct {
+        const Line *line;
+        uint32_t hash;
+        long cls;
+    } *table;
+    size_t size = 1, mask, h;
+    long i, next = 0;
+    uint32_t hv;
+    int f;
+
+    while (size < 2 * (size_t) (files[0].num + files[1].num) + 1) size <<= 1;
+    table = calloc(size, sizeof(*table));
+    mask = size - 1;
+
+    for (f = 0; f < 2; f++) {
+        files[f].equivs = malloc((files[f].num + 1) * sizeof(long));
+        for (i = 0; i < files[f].num; i++) {
+            const Line *line = &files[f].lines[i];
+            hv = line_hash(line);
+            for (h = hv & mask; table[h].line != NULL; h = (h + 1) & mask) {
+                if (table[h].hash == hv && line_equal(table[h].line, line)) {
+                    break;
+                }
+            }
+            if (table[h].line == NULL) {
+                table[h].line = line;
+                table[h].hash = hv;
+                table[h].cls = next++;
+            }
+            files[f].equivs[i] = table[h].cls;
+        }
+    }
+    free(table);
+}
+
+/**
+ * Find the midpoint of the shortest edit script for a specified portion of
+ * the two files. This is the linear space variant of Myers' algorithm
+ * searching simultaneously from both ends, as used by GNU diff with the
+ * --minimal option.
+ */
+static void
+diag(long xoff, long xlim, long yoff, long ylim, Context *ctx,
+     long *xmid, long *ymid)
+{
+    long *const fd = ctx->fdiag;
+    long *const bd = ctx->bdiag;
+    const long *const xv = ctx->xv;
+    const long *const yv = ctx->yv;
+    const long dmin = xoff - ylim;
+    const long dmax = xlim - yoff;
+    const long fmid = xoff - yoff;
+    const long bmid = xlim - ylim;
+    long fmin = fmid, fmax = fmid;
+    long bmin = bmid, bmax = bmid;
+    long d, x, y, tlo, thi, x0;
+    int odd = (fmid - bmid) & 1;
+
+    fd[fmid] = xoff;
+    bd[bmid] = xlim;
+
+    while (1) {
+        /* Extend the top-down search by an edit step in each diagonal. */
+        if (fmin > dmin) fd[--fmin - 1] = -1;
+        else ++fmin;
+        if (fmax < dmax) fd[++fmax + 1] = -1;
+        else --fmax;
+        for (d = fmax; d >= fmin; d -= 2) {
+            tlo = fd[d - 1];
+            thi = fd[d + 1];
+            x0 = tlo < thi ? thi : tlo + 1;
+            for (x = x0, y = x0 - d;
+                 x < xlim && y < ylim && xv[x] == yv[y];
+                 x++, y++)
+                ;
+            fd[d] = x;
+            if (odd && bmin <= d && d <= bmax && bd[d] <= x) {
+                *xmid = x;
+                *ymid = y;
+                return;
+            }
+        }
+
+        /* Similarly extend the bottom-up search. */
+        if (bmin > dmin) bd[--bmin - 1] = LONG_MAX;
+        else ++bmin;
+        if (bmax < dmax) bd[++bmax + 1] = LONG_MAX;
+        else --bmax;
+        for (d = bmax; d >= bmin; d -= 2) {
+            tlo = bd[d - 1];
+            thi = bd[d + 1];
+            x0 = tlo < thi ? tlo : thi - 1;
+            for (x = x0, y = x0 - d;
+                 xoff < x && yoff < y && xv[x - 1] == yv[y - 1];
+                 x--, y--)
+                ;
+            bd[d] = x;
+            if (!odd && fmin <= d && d <= fmax && x <= fd[d]) {
+                *xmid = x;
+                *ymid = y;
+                return;
+            }
+        }
+    }
+}
+
+/**
+ * Compare contiguous subsequences of the two files and mark lines that are
+ * not part of the longest common subsequence as changed.
+ */
+static void
+compareseq(long xoff, long xlim, long yoff, long ylim, Context *ctx)
+{
+    long xmid, ymid;
+
+    while (xoff < xlim && yoff < ylim && ctx->xv[xoff] == ctx->yv[yoff]) {
+        xoff++;
+        yoff++;
+    }
+    while (xoff < xlim && yoff < ylim && ctx->xv[xlim - 1] == ctx->yv[ylim - 1]) {
+        xlim--;
+        ylim--;
+    }
+
+    if (xoff == xlim) {
+        while (yoff < ylim) ctx->ychanged[yoff++] = 1;
+    } else if (yoff == ylim) {
+        while (xoff < xlim) ctx->xchanged[xoff++] = 1;
+    } else {
+        diag(xoff, xlim, yoff, ylim, ctx, &xmid, &ymid);
+        compareseq(xoff, xmid, yoff, ymid, ctx);
+        compareseq(xmid, xlim, ymid, ylim, ctx);
+    }
+}
+
+/**
+ * Slide runs of changed lines so that they merge with adjacent runs where
+ * possible and are otherwise moved as far down as possible. This makes the
+ * output identical to what GNU diff prints.
+ */
+static void
+shift_boundaries(DiffFile *files)
+{
+    int f;
+
+    for (f = 0; f < 2; f++) {
+        char *changed = files[f].changed;
+        char *other_changed = files[1 - f].changed;
+        const long *equivs = files[f].equivs;
+        long i = 0, j = 0, i_end = files[f].num;
+        long runlength, start, corresponding;
+
+        while (1) {
+            /* Find beginning of another run of changes and keep track of
+             * corresponding point in the other file. */
+            while (i < i_end && !changed[i]) {
+                while (other_changed[j++])
+                    ;
+                i++;
+            }
+            if (i == i_end) break;
+
+            start = i;
+            while (changed[++i])
+                ;
+            while (other_changed[j]) j++;
+
+            do {
+                runlength = i - start;
+
+                /* Move the run back while the previous unchanged line
+                 * matches the last changed one. */
+                while (start && equivs[start - 1] == equivs[i - 1]) {
+                    changed[--start] = 1;
+                    changed[--i] = 0;
+                    while (changed[start - 1]) start--;
+                    while (other_changed[--j])
+                        ;
+                }
+
+                corresponding = other_changed[j - 1] ? i : i_end;
+
+                /* Move the run forward while the first changed line
+                 * matches the following unchanged one. */
+                while (i != i_end && equivs[start] == equivs[i]) {
+                    changed[start++] = 0;
+                    changed[i++] = 1;
+                    while (changed[i]) i++;
+                    while (other_changed[++j]) corresponding = i;
+                }
+            } while (runlength != i - start);
+
+            /* Move the merged run back to a corresponding run in the other
+             * file if possible. */
+            while (corresponding < i) {
+                changed[--start] = 1;
+                changed[--i] = 0;
+                while (other_changed[--j])
+                    ;
+            }
+        }
+    }
+}
+
+/**
+ * Compute list of changes between two split files.
+ *
+ * @param files     two files to compare
+ * @param nchanges  where to store length of the returned array
+ * @return array of changes
+ */
+static Change *
+build_script(DiffFile *files, size_t *nchanges)
+{
+    Context ctx;
+    Change *changes;
+    long *diags, i0 = 0, i1 = 0, n0 = files[0].num, n1 = files[1].num;
+    size_t num = 0;
+    int f;
+
+    assign_equivs(files);
+    for (f = 0; f < 2; f++) {
+        files[f].changed = (char *) calloc(files[f].num + 2, sizeof(char)) + 1;
+    }
+
+    diags = malloc(2 * (n0 + n1 + 3) * sizeof(long));
+    ctx.xv = files[0].equivs;
+    ctx.yv = files[1].equivs;
+    ctx.xchanged = files[0].changed;
+    ctx.ychanged = files[1].changed;
+    ctx.fdiag = diags + n1 + 1;
+    ctx.bdiag = diags + (n0 + n1 + 3) + n1 + 1;
+    compareseq(0, n0, 0, n1, &ctx);
+    free(diags);
+
+    shift_boundaries(files);
+
+    changes = malloc((n0 + n1 + 1) * sizeof(Change));
+    while (i0 < n0 || i1 < n1) {
+        if (files[0].changed[i0] || files[1].changed[i1]) {
+            changes[num].line0 = i0;
+            changes[num].line1 = i1;
+            while (files[0].changed[i0]) i0++;
+            while (files[1].changed[i1]) i1++;
+            changes[num].deleted = i0 - changes[num].line0;
+            changes[num].inserted = i1 - changes[num].line1;
+            num++;
+        } else {
+            i0++;
+            i1++;
+        }
+    }
+
+    *nchanges = num;
+    return changes;
+}
+
+/**
+ * Compare buffers line by line ignoring all white space. The lines are
+ * compared in place instead of being normalized first.
+ */
+static int
+equal_ignoring_all_space(const char *a, size_t alen,
+                         const char *b, size_t blen)
+{
+    const char *aend = a + alen, *bend = b + blen, *anl, *bnl;
+
+    while (a < aend && b < bend) {
+        if ((anl = memchr(a, '\n', aend - a)) == NULL) anl = aend;
+        if ((bnl = memchr(b, '\n', bend - b)) == NULL) bnl = bend;
+        if (!scan_equal_ignoring_space(a, anl - a, b, bnl - b)) {
+            return 0;
+        }
+        /* Missing newline at the end does not matter with white space
+         * ignored. */
+        a = anl < aend ? anl + 1 : aend;
+        b = bnl < bend ? bnl + 1 : bend;
+    }
+    return a == aend && b == bend;
+}
+
+static int
+is_binary(const char *buf, size_t len)
+{
+    return memchr(buf, '\0', len < BINARY_PROBE ? len : BINARY_PROBE) != NULL;
+}
+
+int diff_equal(const char *a, size_t alen, const char *b, size_t blen,
+               const DiffOptions *opts)
+{
+    DiffFile files[2];
+    long i;
+    int equal;
+
+    if (opts->flags == 0 || is_binary(a, alen) || is_binary(b, blen)) {
+        return alen == blen && memcmp(a, b, alen) == 0;
+    }
+    if (opts->flags == DIFF_IGNORE_ALL_SPACE) {
+        return equal_ignoring_all_space(a, alen, b, blen);
+    }
+
+    split_lines(&files[0], a, alen, opts->flags);
+    split_lines(&files[1], b, blen, opts->flags);
+    equal = files[0].num == files[1].num;
+    for (i = 0; equal && i < files[0].num; i++) {
+        equal = line_equal(&files[0].lines[i], &files[1].lines[i]);
+    }
+    diff_file_free(&files[0]);
+    diff_file_free(&files[1]);
+    return equal;
+}
+
+/**
+ * Format line range in unified diff hunk header.
+ */
+static void
+format_range(char *buf, size_t size, long first, long last)
+{
+    long a = first + 1, b = last + 1;
+
+    if (b < a) {
+        snprintf(buf, size, "%ld,0", b);
+    } else if (b == a) {
+        snprintf(buf, size, "%ld", b);
+    } else {
+        snprintf(buf, size, "%ld,%ld", a, b - a + 1);
+    }
+}
+
+/**
+ * Print one line of the diff.
+ *
+ * @return number of printed lines
+ */
+static size_t
+print_line(OQueue *out, char prefix, const DiffFile *f, long idx)
+{
+    const Line *line = &f->lines[idx];
+    int incomplete = f->incomplete && idx == f->num - 1;
+
+    if (out) {
+        oqueue_pushf(out, "%c%.*s\n", prefix, (int) line->len, line->start);
+        if (incomplete) {
+            oqueue_push(out, "\\ No newline at end of file\n");
+        }
+    }
+    return incomplete ? 2 : 1;
+}
+
+size_t diff_unified(const char *a, size_t alen, const char *b, size_t blen,
+                    const DiffOptions *opts, OQueue *out)
+{
+    DiffFile files[2];
+    Change *changes;
+    size_t nchanges, c, end, k, lines = 0;
+    long ctx = opts->context, first0, first1, last0, last1, i, j, n;
+    char range0[64], range1[64];
+
+    if (is_binary(a, alen) || is_binary(b, blen)) {
+        if (diff_equal(a, alen, b, blen, opts)) return 0;
+        if (out) oqueue_push(out, "Binary files expected and actual differ\n");
+        return 1;
+    }
+
+    split_lines(&files[0], a, alen, opts->flags);
+    split_lines(&files[1], b, blen, opts->flags);
+    changes = build_script(files, &nchanges);
+
+    if (nchanges > 0 && out) {
+        oqueue_push(out, "--- expected\n+++ actual\n");
+    }
+
+    for (c = 0; c < nchanges; c = end + 1) {
+        /* Merge changes closer than twice the context into one hunk. */
+        for (end = c; end + 1 < nchanges; end++) {
+            if (changes[end + 1].line0 - changes[end].line0
+                    - changes[end].deleted >= 2 * ctx + 1) {
+                break;
+            }
+        }
+
+        first0 = changes[c].line0 - ctx;
+        first1 = changes[c].line1 - ctx;
+        if (first0 < 0) first0 = 0;
+        if (first1 < 0) first1 = 0;
+        last0 = changes[end].line0 + changes[end].deleted - 1;
+        last1 = changes[end].line1 + changes[end].inserted - 1;
+        last0 = last0 < files[0].num - ctx ? last0 + ctx : files[0].num - 1;
+        last1 = last1 < files[1].num - ctx ? last1 + ctx : files[1].num - 1;
+
+        if (out) {
+            format_range(range0, sizeof(range0), first0, last0);
+            format_range(range1, sizeof(range1), first1, last1);
+            oqueue_pushf(out, "@@ -%s +%s @@\n", range0, range1);
+        }
+        lines++;
+
+        for (i = first0, j = first1, k = c; i <= last0 || j <= last1; ) {
+            if (k > end || i < changes[k].line0) {
+                lines += print_line(out, ' ', &files[0], i);
+                i++;
+                j++;
+                continue;
+            }
+            for (n = 0; n < changes[k].deleted; n++) {
+                lines += print_line(out, '-', &files[0], i++);
+            }
+            for (n = 0; n < changes[k].inserted; n++) {
+                lines += print_line(out, '+', &files[1], j++);
+            }
+            k++;
+        }
+    }
+
+    free(changes);
+    diff_file_free(&files[0]);
+    diff_file_free(&files[1]);
+    return lines;
+}
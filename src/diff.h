@@ -0,0 +1,86 @@
+#ifndef DIFF_H
+#define DIFF_H
+
+#include <config.h>
+
+#include <stddef.h>
+
+#include "outputqueue.h"
+
+/**
+ * Flags changing how lines are compared. They mirror the diff(1) options
+ * with the same meaning.
+ */
+typedef enum {
+    /** -i, --ignore-case */
+    DIFF_IGNORE_CASE            = 1 << 0,
+    /** -b, --ignore-space-change */
+    DIFF_IGNORE_SPACE_CHANGE    = 1 << 1,
+    /** -w, --ignore-all-space */
+    DIFF_IGNORE_ALL_SPACE       = 1 << 2,
+    /** -Z, --ignore-trailing-space */
+    DIFF_IGNORE_TRAILING_SPACE  = 1 << 3,
+    /** --strip-trailing-cr */
+    DIFF_STRIP_TRAILING_CR      = 1 << 4
+} DiffFlags;
+
+typedef struct diff_options_t DiffOptions;
+struct diff_options_t {
+    /** bit mask of DiffFlags */
+    unsigned int flags;
+    /** number of context lines in unified diff */
+    unsigned int context;
+};
+
+/**
+ * Set options to default values, which corresponds to `diff -u -d`.
+ *
+ * @param opts  options to initialize
+ */
+void diff_options_init(DiffOptions *opts);
+
+/**
+ * Parse string with diff(1) command line options and update opts
+ * accordingly. Only options affecting comparison of lines and the amount of
+ * context are understood. As the options are combined with -u, the context
+ * can only grow beyond three lines. On unsupported option an error message
+ * is printed and zero is returned.
+ *
+ * @param opts  options to update
+ * @param str   command line options
+ * @return 1 on success, 0 if some option is not supported
+ */
+int diff_options_parse(DiffOptions *opts, const char *str);
+
+/**
+ * Check whether two buffers have the same content with respect to options.
+ *
+ * @param a     first buffer (expected)
+ * @param alen  length of the first buffer
+ * @param b     second buffer (actual)
+ * @param blen  length of the second buffer
+ * @param opts  comparison options
+ * @return 1 if the buffers are equal, 0 otherwise
+ */
+int diff_equal(const char *a, size_t alen, const char *b, size_t blen,
+               const DiffOptions *opts);
+
+/**
+ * Compute minimal difference between two buffers and format it as unified
+ * diff. The first buffer is labeled 'expected', the second 'actual'. The
+ * output is the same as of `diff -u -d --label=expected --label=actual`.
+ *
+ * If the queue is NULL, nothing is printed and only the lines are counted.
+ *
+ * @param a     first buffer (expected)
+ * @param alen  length of the first buffer
+ * @param b     second buffer (actual)
+ * @param blen  length of the second buffer
+ * @param opts  comparison options
+ * @param out   where to store the diff (allow-none)
+ * @return number of lines of the diff not counting the two header lines
+ */
+size_t diff_unified(const char *a, size_t alen, const char *b, size_t blen,
+                    const DiffOptions *opts, OQueue *out);
+
+#endif /* end of include guard: DIFF_H */
@@ -1,10 +1,17 @@
 #include <config.h>
 
 #include "genutils.h"
+#include "import.h"
+#include "pack.h"
+#include "record.h"
 #include "utils.h"
 #include "test.h"
 
+#include <errno.h>
 #include <getopt.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #if defined(__GNUC__)
 #  define UNUSED(x) x __attribute__((unused))
@@ -29,19 +36,156 @@ print_test(void *t, void * UNUSED(data))
             FLAG_SET(test->parts, TEST_RETVAL)  ? 'R' : ' ');
 }
 
+/**
+ * Load tests from a directory or a pack.
+ *
+ * @param dir   directory or pack
+ * @return list of tests or NULL
+ */
+static List *
+load_tests(const char *dir)
+{
+    struct stat info;
+
+    if (stat(dir, &info) == 0 && S_ISREG(info.st_mode)) {
+        return test_load_from_pack(dir);
+    }
+    return test_load_from_dir(dir);
+}
+
 /**
  * List all tests in a directory.
  *
- * @param dir   directory to list
+ * @param dir   directory or pack to list
  */
 static void
 list_tests(const char *dir)
 {
-    List *tests = test_load_from_dir(dir);
+    List *tests = load_tests(dir);
     list_foreach(tests, print_test, NULL);
     list_destroy(tests, DESTROYFUNC(test_free));
 }
 
+/**
+ * Store all tests from a directory in a pack.
+ *
+ * @param dir   directory with tests
+ * @param path  pack to create
+ * @return 1 on success, 0 on failure
+ */
+static int
+pack_tests(const char *dir, const char *path)
+{
+    List *tests = test_load_from_dir(dir), *tmp;
+    PackWriter *w;
+    Test *test;
+    const char *data;
+    size_t len;
+    unsigned int i;
+
+    if (tests == NULL) {
+        fprintf(stderr, "No tests loaded from directory '%s'\n", dir);
+        return 0;
+    }
+    if ((w = pack_writer_new(path)) == NULL) {
+        list_destroy(tests, DESTROYFUNC(test_free));
+        return 0;
+    }
+    for (tmp = tests; tmp != NULL; tmp = tmp->next) {
+        test = tmp->data;
+        pack_writer_add_test(w, test->name);
+        for (i = 0; i < PACK_PARTS; i++) {
+            if (!FLAG_SET(test->parts, 2 << i)) continue;
+            data = test_get_data(test, test_get_part_ext(i), &len);
+            if (data == NULL) {
+                fprintf(stderr, "Can not read %s.%s: %s\n", test->name,
+                        test_get_part_ext(i), strerror(errno));
+                pack_writer_free(w);
+                list_destroy(tests, DESTROYFUNC(test_free));
+                return 0;
+            }
+            pack_writer_add_part(w, i, data, len);
+            test_release_data(test, data, len);
+        }
+    }
+    len = list_length(tests);
+    list_destroy(tests, DESTROYFUNC(test_free));
+    if (!pack_writer_finish(w)) {
+        return 0;
+    }
+    printf("Packed %zu tests to %s\n", len, path);
+    return 1;
+}
+
+/**
+ * Create directory and all its parents.
+ */
+static int
+make_dirs(const char *dir)
+{
+    char *path = strdup(dir), *slash = path;
+    int ok = 1;
+
+    while (ok && slash != NULL) {
+        slash = strchr(slash + 1, '/');
+        if (slash) *slash = '\0';
+        ok = mkdir(path, 0777) == 0 || errno == EEXIST;
+        if (slash) *slash = '/';
+    }
+    free(path);
+    return ok;
+}
+
+/**
+ * Write all tests from a pack to a directory. Existing files are
+ * overwritten.
+ *
+ * @param path  pack to read
+ * @param dir   directory for the tests
+ * @return 1 on success, 0 on failure
+ */
+static int
+unpack_tests(const char *path, const char *dir)
+{
+    List *tests = test_load_from_pack(path), *tmp;
+    Test *test;
+    const char *data;
+    char *file, *slash;
+    size_t len;
+    unsigned int i;
+    FILE *fh;
+    int ok = tests != NULL;
+
+    for (tmp = tests; ok && tmp != NULL; tmp = tmp->next) {
+        test = tmp->data;
+        for (i = 0; ok && i < PACK_PARTS; i++) {
+            if (!FLAG_SET(test->parts, 2 << i)) continue;
+            data = test_get_data(test, test_get_part_ext(i), &len);
+            file = get_filepath(dir, test->name, test_get_part_ext(i));
+            /* Tests in groups need their subdirectories. */
+            slash = strrchr(file, '/');
+            *slash = '\0';
+            ok = make_dirs(file);
+            *slash = '/';
+            ok = ok && (fh = fopen(file, "w")) != NULL;
+            if (ok) {
+                fwrite(data, 1, len, fh);
+                ok = !ferror(fh) && fclose(fh) == 0;
+            }
+            if (!ok) {
+                fprintf(stderr, "Can not write '%s': %s\n", file,
+                        strerror(errno));
+            }
+            free(file);
+        }
+    }
+    if (ok) {
+        printf("Unpacked %zu tests to %s\n", list_length(tests), dir);
+    }
+    list_destroy(tests, DESTROYFUNC(test_free));
+    return ok;
+}
+
 static void
 copy_from_to(FILE *from, FILE *to)
 {
@@ -140,16 +284,33 @@ create_file(const char *dir, const char *name, const char *ext,
     free(path);
 }
 
-#define OPTSTRING "ioer:a:lhV"
+#define OPTSTRING "ioer:a:j:t:lhV"
 
 static void help(void)
 {
     puts("SYNOPSIS");
     puts("\tgen-test [ioeralhV] [TESTDIR]");
+    puts("\tgen-test --record=COMMAND --inputs=DIR|GLOB [-a ARGS] [-j N]"
+         " [-t SECONDS]\n\t\t[TESTDIR]");
+    puts("\tgen-test --import=FILE [TESTDIR]");
 
     puts("\nOPTIONS");
     puts("\t-h, --help\n\t\tdisplay this help\n");
     puts("\t-l, --list\n\t\tlist all existing tests and their parts\n");
+    puts("\t--pack=FILE\n\t\tstore all tests from TESTDIR in pack FILE\n");
+    puts("\t--unpack=FILE\n\t\twrite all tests from pack FILE to"
+         " TESTDIR\n");
+    puts("\t--import=FILE\n\t\tcreate all tests described in JSONL or"
+         " CSV FILE\n");
+    puts("\t--record=COMMAND\n\t\trun COMMAND on each file given by"
+         " --inputs and\n\t\tcreate a test from what it does\n");
+    puts("\t--inputs=DIR|GLOB\n\t\twith --record, use all files in DIR"
+         " or all files\n\t\tmatching GLOB as inputs\n");
+    puts("\t-j, --jobs=N\n\t\twith --record, run N commands at the same"
+         " time,\n\t\tdefault is number of processors\n");
+    puts("\t-t, --timeout=SECONDS\n\t\twith --record, kill commands"
+         " running longer than\n\t\tSECONDS and skip their inputs,"
+         " default is 10\n");
     puts("\t-i\n\t\tload standard input from console\n");
     puts("\t--input=FILE\n\t\tcopy standard input from FILE\n");
     puts("\t-o\n\t\tload standard output from console\n");
@@ -159,7 +320,8 @@ static void help(void)
     puts("\t-a, --args=ARGS\n\t\tpass ARGS as command line options\n");
     puts("\t-r, --retval=CODE\n\t\texpected program to exit with CODE\n");
     puts("\t-V, --version\n\t\tdisplay version info\n");
-    puts("\tIf TESTDIR is not specified, use ./tests directory.");
+    puts("\tIf TESTDIR is not specified, use ./tests directory. With --list,"
+         " TESTDIR\n\tcan be a pack.");
 
     puts("\nRETURN VALUE");
     puts("\t0 is returned on success, 1 otherwise");
@@ -170,6 +332,14 @@ static void usage(const char *progname)
     fprintf(stderr, "Usage: %s [OPTIONS] [TESTDIR]\n", progname);
 }
 
+enum {
+    OPT_PACK = 256,
+    OPT_UNPACK,
+    OPT_RECORD,
+    OPT_INPUTS,
+    OPT_IMPORT
+};
+
 static const struct option long_options[] = {
     { "input",      required_argument,  NULL, 0   },
     { "output",     required_argument,  NULL, 0   },
@@ -177,6 +347,13 @@ static const struct option long_options[] = {
     { "retval",     required_argument,  NULL, 'r' },
     { "args",       required_argument,  NULL, 'a' },
     { "list",       no_argument,        NULL, 'l' },
+    { "pack",       required_argument,  NULL, OPT_PACK },
+    { "unpack",     required_argument,  NULL, OPT_UNPACK },
+    { "record",     required_argument,  NULL, OPT_RECORD },
+    { "inputs",     required_argument,  NULL, OPT_INPUTS },
+    { "jobs",       required_argument,  NULL, 'j' },
+    { "timeout",    required_argument,  NULL, 't' },
+    { "import",     required_argument,  NULL, OPT_IMPORT },
     { "help",       no_argument,        NULL, 'h' },
     { "version",    no_argument,        NULL, 'V' },
     { NULL, 0, NULL, 0 }
@@ -184,8 +361,15 @@ static const struct option long_options[] = {
 
 int main(int argc, char *argv[])
 {
-    char c;
+    int c;
     int i, opt_list_tests = 0, test_no = 0;
+    char *pack = NULL, *unpack = NULL;
+    char *record = NULL, *inputs_spec = NULL, **inputs, *end;
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    double timeout = RECORD_TIMEOUT;
+    size_t input_num;
+    char *import = NULL, *base, *slash;
+    ImportRecord *records;
     char *dir = "tests";
     char buffer[128], test_name[128];
     char *files[] = { NULL, NULL, NULL };
@@ -220,6 +404,37 @@ int main(int argc, char *argv[])
         case 'l':
             opt_list_tests = 1;
             break;
+        case OPT_PACK:
+            pack = optarg;
+            break;
+        case OPT_UNPACK:
+            unpack = optarg;
+            break;
+        case OPT_RECORD:
+            record = optarg;
+            break;
+        case OPT_INPUTS:
+            inputs_spec = optarg;
+            break;
+        case OPT_IMPORT:
+            import = optarg;
+            break;
+        case 'j':
+            jobs = strtol(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0' || jobs < 1) {
+                fprintf(stderr, "Bad number of jobs '%s'\n", optarg);
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 't':
+            timeout = strtod(optarg, &end);
+            if (*optarg == '\0' || *end != '\0' || !(timeout > 0)) {
+                fprintf(stderr, "Bad timeout '%s'\n", optarg);
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
         case 'h':
             help();
             return EXIT_SUCCESS;
@@ -239,6 +454,51 @@ int main(int argc, char *argv[])
         list_tests(dir);
         return EXIT_SUCCESS;
     }
+    if (pack) {
+        return pack_tests(dir, pack) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (unpack) {
+        return unpack_tests(unpack, dir) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (import) {
+        if (record || inputs_spec || args || retval || files[0] || files[1]
+                || files[2] || from_user[0] || from_user[1] || from_user[2]) {
+            fprintf(stderr, "--import can not be combined with other"
+                    " options\n");
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        if ((records = import_load(import, &input_num)) == NULL) {
+            return EXIT_FAILURE;
+        }
+        /* Files in the records are next to the imported file. */
+        slash = strrchr(import, '/');
+        base = slash ? strndup(import, slash - import) : strdup(".");
+        i = import_write(records, input_num, base, dir);
+        free(base);
+        import_free(records, input_num);
+        return i ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (record || inputs_spec) {
+        if (!record || !inputs_spec || retval || files[0] || files[1]
+                || files[2] || from_user[0] || from_user[1] || from_user[2]) {
+            fprintf(stderr, "--record needs --inputs and takes only"
+                    " --args, --jobs and --timeout\n");
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        inputs = record_list_inputs(inputs_spec, &input_num);
+        if (inputs == NULL) {
+            fprintf(stderr, "No inputs found in '%s'\n", inputs_spec);
+            return EXIT_FAILURE;
+        }
+        i = record_tests(record, args, inputs, input_num, dir,
+                         jobs > 0 ? jobs : 1, timeout);
+        str_array_free(inputs);
+        return i ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
     if (check_consistency(from_user, files) > 0) {
         usage(argv[0]);
@@ -1,11 +1,14 @@
 #include <config.h>
 
 #include "genutils.h"
+#include "utils.h"
 
 #include <ctype.h>
 #include <dirent.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 char * sanitize_test_name(char *name)
 {
@@ -43,3 +46,23 @@ int get_test_num(const char *dirpath)
     closedir(dir);
     return max;
 }
+
+int write_test_file(const char *dir, const char *name, const char *ext,
+                    const char *data, size_t len)
+{
+    char *path = get_filepath(dir, name, ext);
+    FILE *fh;
+    int ok;
+
+    ok = (fh = fopen(path, "w")) != NULL;
+    if (ok) {
+        fwrite(data, 1, len, fh);
+        ok = !ferror(fh);
+        ok = fclose(fh) == 0 && ok;
+    }
+    if (!ok) {
+        fprintf(stderr, "Can not write '%s': %s\n", path, strerror(errno));
+    }
+    free(path);
+    return ok;
+}
@@ -3,6 +3,8 @@
 
 #include <config.h>
 
+#include <stddef.h>
+
 /**
  * Strip leading and trailing whitespace. All other white space in the middle
  * is replaced by underscores. At most one successive underscore will be found
@@ -18,4 +20,18 @@ char * sanitize_test_name(char *name);
  */
 int get_test_num(const char *dirpath);
 
+/**
+ * Create a file of a test. Existing file is overwritten. On failure, error
+ * message is printed.
+ *
+ * @param dir   directory with tests
+ * @param name  name of the test
+ * @param ext   extension of the file
+ * @param data  content of the file
+ * @param len   length of the content
+ * @return 1 on success, 0 on failure
+ */
+int write_test_file(const char *dir, const char *name, const char *ext,
+                    const char *data, size_t len);
+
 #endif /* end of include guard: GENUTILS_H */
@@ -0,0 +1,412 @@
+#include <config.h>
+
+#include "cache.h"
+#include "history.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct history_t {
+    char *path;
+    HistoryEntry *entries;
+    size_t len;
+    size_t size;
+    /** whether entries are sorted by name */
+    int sorted;
+};
+
+/**
+ * Test being ordered with its rank. Tests are sorted by group, then by key
+ * and then by original position.
+ */
+typedef struct {
+    Test *test;
+    size_t index;
+    int group;
+    double key;
+} RankedTest;
+
+static int
+compare_entries(const void *a, const void *b)
+{
+    return strcmp(((const HistoryEntry *) a)->name,
+                  ((const HistoryEntry *) b)->name);
+}
+
+static HistoryEntry *
+history_lookup(History *h, const char *name)
+{
+    HistoryEntry key;
+
+    if (!h->sorted) {
+        qsort(h->entries, h->len, sizeof(HistoryEntry), compare_entries);
+        h->sorted = 1;
+    }
+    key.name = (char *) name;
+    return bsearch(&key, h->entries, h->len, sizeof(HistoryEntry),
+                   compare_entries);
+}
+
+static HistoryEntry *
+history_add(History *h, const char *name)
+{
+    HistoryEntry *e;
+
+    if (h->len == h->size) {
+        h->size = h->size ? 2 * h->size : 64;
+        h->entries = realloc(h->entries, h->size * sizeof(HistoryEntry));
+    }
+    e = &h->entries[h->len++];
+    e->name = strdup(name);
+    e->failures = 0;
+    e->files = 0;
+    e->wall = -1;
+    h->sorted = 0;
+    return e;
+}
+
+History * history_load(const char *path)
+{
+    History *h;
+    HistoryEntry *e;
+    FILE *fh;
+    char *line = NULL, *fields[4], *end;
+    size_t line_size = 0;
+    unsigned long failures;
+    uint64_t files;
+    double wall;
+    int i;
+
+    h = calloc(1, sizeof(History));
+    h->path = strdup(path);
+    h->sorted = 1;
+
+    fh = fopen(path, "r");
+    if (fh == NULL) {
+        return h;
+    }
+    while (getline(&line, &line_size, fh) >= 0) {
+        line[strcspn(line, "\n")] = '\0';
+        fields[0] = line;
+        for (i = 1; i < 4 && fields[i - 1] != NULL; i++) {
+            fields[i] = strchr(fields[i - 1], '\t');
+            if (fields[i] != NULL) *fields[i]++ = '\0';
+        }
+        if (fields[3] == NULL) continue;
+
+        failures = strtoul(fields[1], &end, 16);
+        if (end == fields[1] || *end != '\0') continue;
+        files = strtoull(fields[2], &end, 16);
+        if (end == fields[2] || *end != '\0') continue;
+        if (strcmp(fields[3], "-") == 0) {
+            wall = -1;
+        } else {
+            wall = strtod(fields[3], &end);
+            if (end == fields[3] || *end != '\0' || wall < 0) continue;
+        }
+
+        e = history_add(h, fields[0]);
+        e->failures = failures;
+        e->files = files;
+        e->wall = wall;
+    }
+    free(line);
+    fclose(fh);
+    return h;
+}
+
+int history_save(History *h)
+{
+    HistoryEntry *e;
+    char *data = NULL;
+    size_t i, len = 0;
+    FILE *fh;
+    int ok;
+
+    ok = (fh = open_memstream(&data, &len)) != NULL;
+    for (i = 0; ok && i < h->len; i++) {
+        e = &h->entries[i];
+        fprintf(fh, "%s\t%" PRIx32 "\t%016" PRIx64 "\t", e->name,
+                e->failures, e->files);
+        if (e->wall < 0) {
+            fputs("-\n", fh);
+        } else {
+            fprintf(fh, "%.6f\n", e->wall);
+        }
+    }
+    if (fh != NULL) {
+        ok = !ferror(fh) && fclose(fh) == 0 && ok;
+    }
+    ok = ok && write_file(h->path, data, len);
+    if (!ok) {
+        fprintf(stderr, "Can not write history '%s': %s\n", h->path,
+                strerror(errno));
+    }
+    free(data);
+    return ok;
+}
+
+void history_free(History *h)
+{
+    size_t i;
+
+    if (h) {
+        for (i = 0; i < h->len; i++) {
+            free(h->entries[i].name);
+        }
+        free(h->entries);
+        free(h->path);
+    }
+    free(h);
+}
+
+const HistoryEntry * history_find(History *h, const char *name)
+{
+    return history_lookup(h, name);
+}
+
+int history_has_durations(History *h)
+{
+    size_t i;
+
+    for (i = 0; i < h->len; i++) {
+        if (h->entries[i].wall >= 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void history_record(History *h, const char *name, uint64_t files,
+                    int failed, double wall)
+{
+    HistoryEntry *e = history_lookup(h, name);
+
+    if (e == NULL) {
+        e = history_add(h, name);
+    }
+    e->failures = (e->failures << 1) | (failed ? 1 : 0);
+    e->files = files;
+    if (wall >= 0) {
+        /* Smooth out noise, but follow lasting changes quickly. */
+        e->wall = e->wall < 0 ? wall : (e->wall + wall) / 2;
+    }
+}
+
+/**
+ * Get how many runs ago the test failed for the last time.
+ */
+static int
+last_failure(uint32_t failures)
+{
+    int i;
+
+    for (i = 0; i < 32 && !(failures & (UINT32_C(1) << i)); i++)
+        ;
+    return i;
+}
+
+static int
+compare_ranked(const void *a, const void *b)
+{
+    const RankedTest *x = a, *y = b;
+
+    if (x->group != y->group) {
+        return x->group - y->group;
+    }
+    if (x->key != y->key) {
+        return x->key < y->key ? -1 : 1;
+    }
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+/**
+ * Convert list of tests to an array for sorting. The list is freed.
+ */
+static RankedTest *
+rank_tests(List *tests, size_t *len)
+{
+    RankedTest *ranked;
+    List *tmp;
+    size_t n = list_length(tests);
+
+    ranked = calloc(n ? n : 1, sizeof(RankedTest));
+    n = 0;
+    for (tmp = tests; tmp != NULL; tmp = tmp->next) {
+        ranked[n].test = tmp->data;
+        ranked[n].index = n;
+        n++;
+    }
+    list_destroy(tests, NULL);
+    *len = n;
+    return ranked;
+}
+
+List * history_order(History *h, List *tests, HistoryOrder order)
+{
+    const HistoryEntry *e;
+    RankedTest *ranked;
+    size_t i, len;
+
+    if (order == ORDER_DEFAULT) {
+        return tests;
+    }
+
+    ranked = rank_tests(tests, &len);
+    for (i = 0; i < len; i++) {
+        e = history_lookup(h, ranked[i].test->name);
+        if (order == ORDER_FAILED_FIRST) {
+            ranked[i].group = e ? last_failure(e->failures) : 32;
+        } else if (e == NULL || e->wall < 0) {
+            ranked[i].group = 1;
+        } else {
+            ranked[i].key = order == ORDER_SLOWEST_FIRST ? -e->wall : e->wall;
+        }
+    }
+    qsort(ranked, len, sizeof(RankedTest), compare_ranked);
+
+    tests = NULL;
+    for (i = len; i > 0; i--) {
+        tests = list_prepend(tests, ranked[i - 1].test);
+    }
+    free(ranked);
+    return tests;
+}
+
+/**
+ * Get expected wall clock times of ranked tests, indexed by their original
+ * position. Duration of a test without history is estimated as the average
+ * of known durations, if there are any.
+ */
+static double *
+estimate_durations(History *h, RankedTest *ranked, size_t len)
+{
+    const HistoryEntry *e;
+    double *walls, known = 0, estimate;
+    size_t i, measured = 0;
+
+    walls = calloc(len ? len : 1, sizeof(double));
+    for (i = 0; i < len; i++) {
+        e = h ? history_lookup(h, ranked[i].test->name) : NULL;
+        walls[ranked[i].index] = e ? e->wall : -1;
+        if (e && e->wall >= 0) {
+            known += e->wall;
+            measured++;
+        }
+    }
+    estimate = measured > 0 ? known / measured : HISTORY_DEFAULT_WALL;
+    for (i = 0; i < len; i++) {
+        if (walls[i] < 0) walls[i] = estimate;
+    }
+    return walls;
+}
+
+/**
+ * Groups of tests for selection, from the most valuable.
+ */
+enum {
+    GROUP_FAILED,
+    GROUP_CHANGED,
+    GROUP_OTHER
+};
+
+List * history_select(History *h, List *tests, double budget, List **rest)
+{
+    const HistoryEntry *e;
+    RankedTest *ranked;
+    double *walls, used = 0;
+    size_t i, len;
+    List *selected = NULL;
+
+    ranked = rank_tests(tests, &len);
+    walls = estimate_durations(h, ranked, len);
+    for (i = 0; i < len; i++) {
+        e = history_lookup(h, ranked[i].test->name);
+        if (e && e->failures != 0) {
+            ranked[i].group = GROUP_FAILED;
+            ranked[i].key = last_failure(e->failures);
+        } else if (e == NULL || e->files != test_hash_files(ranked[i].test)) {
+            ranked[i].group = GROUP_CHANGED;
+        } else {
+            ranked[i].group = GROUP_OTHER;
+            ranked[i].key = walls[i];
+        }
+    }
+    qsort(ranked, len, sizeof(RankedTest), compare_ranked);
+
+    *rest = NULL;
+    for (i = 0; i < len; i++) {
+        if (used + walls[ranked[i].index] <= budget) {
+            used += walls[ranked[i].index];
+            selected = list_prepend(selected, ranked[i].test);
+        } else {
+            *rest = list_prepend(*rest, ranked[i].test);
+        }
+    }
+    *rest = list_reverse(*rest);
+    free(walls);
+    free(ranked);
+    return list_reverse(selected);
+}
+
+List * history_shard(History *h, List *tests, unsigned int index,
+                     unsigned int count, ShardMode mode, List **rest)
+{
+    RankedTest *ranked;
+    double *walls, *loads;
+    unsigned int *shards, j, best;
+    size_t i, len;
+    List *selected = NULL;
+
+    ranked = rank_tests(tests, &len);
+    shards = calloc(len ? len : 1, sizeof(unsigned int));
+    if (mode == SHARD_ROUND_ROBIN) {
+        for (i = 0; i < len; i++) {
+            shards[i] = i % count;
+        }
+    } else if (mode == SHARD_BY_NAME) {
+        for (i = 0; i < len; i++) {
+            shards[i] = cache_hash(CACHE_HASH_INIT, ranked[i].test->name,
+                    strlen(ranked[i].test->name)) % count;
+        }
+    } else {
+        /* Longest tests first, each to the shard with the least work. */
+        walls = estimate_durations(h, ranked, len);
+        for (i = 0; i < len; i++) {
+            ranked[i].key = -walls[i];
+        }
+        qsort(ranked, len, sizeof(RankedTest), compare_ranked);
+        loads = calloc(count, sizeof(double));
+        for (i = 0; i < len; i++) {
+            for (best = 0, j = 1; j < count; j++) {
+                if (loads[j] < loads[best]) best = j;
+            }
+            loads[best] += walls[ranked[i].index];
+            shards[ranked[i].index] = best;
+        }
+        free(loads);
+        free(walls);
+        /* Return tests to their original order. */
+        for (i = 0; i < len; i++) {
+            ranked[i].key = 0;
+        }
+        qsort(ranked, len, sizeof(RankedTest), compare_ranked);
+    }
+
+    *rest = NULL;
+    for (i = 0; i < len; i++) {
+        if (shards[i] == index) {
+            selected = list_prepend(selected, ranked[i].test);
+        } else {
+            *rest = list_prepend(*rest, ranked[i].test);
+        }
+    }
+    *rest = list_reverse(*rest);
+    free(shards);
+    free(ranked);
+    return list_reverse(selected);
+}
@@ -0,0 +1,171 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <config.h>
+
+#include <stdint.h>
+
+#include "list.h"
+#include "test.h"
+
+/**
+ * History of previous runs. For each test it remembers outcomes of the last
+ * runs, how long the test took and hash of its files at the time of the last
+ * run. It is used to run the most useful tests first.
+ *
+ * The history is saved as a text file with one test per line: name,
+ * outcomes, hash of files and duration separated by tabs.
+ */
+typedef struct history_t History;
+
+/**
+ * Name of the history file in STATE_DIR.
+ */
+#define HISTORY_FILE "history"
+
+/**
+ * Duration in seconds expected of each test while the history does not
+ * know duration of any test.
+ */
+#define HISTORY_DEFAULT_WALL 1.0
+
+typedef struct history_entry_t HistoryEntry;
+struct history_entry_t {
+    char *name;
+    /** bit mask of failed runs, the lowest bit is the last run */
+    uint32_t failures;
+    /** hash of test files as computed by test_hash_files() */
+    uint64_t files;
+    /** average wall clock time in seconds, negative if unknown */
+    double wall;
+};
+
+/**
+ * How to order tests.
+ */
+typedef enum {
+    /** keep the order of test numbers */
+    ORDER_DEFAULT,
+    /** tests that failed recently go first, the most recent failures first */
+    ORDER_FAILED_FIRST,
+    /** tests taking the longest time go first */
+    ORDER_SLOWEST_FIRST,
+    /** tests taking the shortest time go first */
+    ORDER_FASTEST_FIRST
+} HistoryOrder;
+
+/**
+ * How to split tests among shards.
+ */
+typedef enum {
+    /** n-th test goes to shard n modulo number of shards */
+    SHARD_ROUND_ROBIN,
+    /** shard is given by hash of test name, so it does not depend on
+     * other tests */
+    SHARD_BY_NAME,
+    /** shards get about the same total duration */
+    SHARD_BY_DURATION
+} ShardMode;
+
+/**
+ * Load history from a file. Missing or malformed file gives an empty
+ * history.
+ *
+ * @param path  file to read
+ * @return new history
+ */
+History * history_load(const char *path);
+
+/**
+ * Write history to the file it was loaded from. The file is replaced
+ * atomically. On failure, error message is printed.
+ *
+ * @param h     history to save
+ * @return 1 on success, 0 on failure
+ */
+int history_save(History *h);
+
+/**
+ * Free history.
+ *
+ * @param h     history to be freed (allow-none)
+ */
+void history_free(History *h);
+
+/**
+ * Find what is known about a test.
+ *
+ * @param h     history
+ * @param name  name of the test
+ * @return the entry or NULL if the test was never run (transfer none)
+ */
+const HistoryEntry * history_find(History *h, const char *name);
+
+/**
+ * Check whether duration of at least one test is known.
+ *
+ * @param h     history
+ * @return 1 if some duration is known, 0 otherwise
+ */
+int history_has_durations(History *h);
+
+/**
+ * Record outcome of a test.
+ *
+ * @param h         history
+ * @param name      name of the test
+ * @param files     hash of test files
+ * @param failed    whether the test failed
+ * @param wall      wall clock time of the test, negative if not measured
+ */
+void history_record(History *h, const char *name, uint64_t files,
+                    int failed, double wall);
+
+/**
+ * Reorder tests. Tests without history are placed after the others in
+ * ORDER_SLOWEST_FIRST and ORDER_FASTEST_FIRST. Tests with equal rank keep
+ * their relative order.
+ *
+ * @param h     history
+ * @param tests list of tests, it is consumed
+ * @param order requested order
+ * @return the reordered list
+ */
+List * history_order(History *h, List *tests, HistoryOrder order);
+
+/**
+ * Select tests that are expected to finish within the budget. Tests that
+ * failed recently are preferred, then tests that are new or whose files
+ * changed since the last run, then the remaining tests, fastest first.
+ * Duration of a test without history is estimated as the average of known
+ * durations, or HISTORY_DEFAULT_WALL if no duration is known. The selected
+ * tests are returned in the order of preference.
+ *
+ * @param h         history
+ * @param tests     list of tests, it is consumed
+ * @param budget    available time in seconds
+ * @param rest      where to store list of tests that were not selected
+ *                  (out) (transfer full)
+ * @return list of selected tests
+ */
+List * history_select(History *h, List *tests, double budget, List **rest);
+
+/**
+ * Select tests belonging to one shard. Every test belongs to exactly one
+ * shard and the result only depends on the list of tests and, for
+ * SHARD_BY_DURATION, on durations in the history. Durations are estimated
+ * the same way as in history_select(). Tests keep their relative order.
+ *
+ * @param h         history used with SHARD_BY_DURATION (allow-none)
+ * @param tests     list of tests, it is consumed
+ * @param index     index of the shard, starting from 0
+ * @param count     number of shards
+ * @param mode      how to split the tests
+ * @param rest      where to store list of tests from other shards
+ *                  (out) (transfer full)
+ * @return list of tests of the shard
+ */
+List * history_shard(History *h, List *tests, unsigned int index,
+                     unsigned int count, ShardMode mode, List **rest);
+
+#endif /* end of include guard: HISTORY_H */
@@ -0,0 +1,635 @@
+#include <config.h>
+
+#include "genutils.h"
+#include "import.h"
+#include "test.h"
+#include "utils.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *field_names[IMPORT_FIELDS] = {
+    "name", "args", "stdin", "stdin_file", "stdout", "stdout_file",
+    "stderr", "stderr_file", "exit_code"
+};
+
+const char * import_field_name(ImportField field)
+{
+    return field_names[field];
+}
+
+/**
+ * Find field by its name.
+ *
+ * @return the field or -1 if the name is not known
+ */
+static int
+find_field(const char *name)
+{
+    int i;
+
+    for (i = 0; i < IMPORT_FIELDS; i++) {
+        if (strcmp(field_names[i], name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Store value of a field in a record.
+ *
+ * @param r     the record
+ * @param field field to set
+ * @param value the value (transfer full)
+ * @param len   length of the value
+ * @return NULL on success, error message (transfer full) otherwise
+ */
+static char *
+import_set(ImportRecord *r, int field, char *value, size_t len)
+{
+    if (r->values[field]) {
+        free(value);
+        return str_printf("duplicate %s", field_names[field]);
+    }
+    r->values[field] = value;
+    r->lengths[field] = len;
+    return NULL;
+}
+
+static const char *
+skip_space(const char *s, const char *end)
+{
+    while (s < end && (*s == ' ' || *s == '\t' || *s == '\r' || *s == '\n')) {
+        s++;
+    }
+    return s;
+}
+
+/**
+ * Parse four hexadecimal digits of \u escape.
+ */
+static int
+parse_hex4(const char *s, const char *end, unsigned int *code)
+{
+    int i;
+
+    if (end - s < 4) {
+        return 0;
+    }
+    *code = 0;
+    for (i = 0; i < 4; i++) {
+        if (!isxdigit((unsigned char) s[i])) {
+            return 0;
+        }
+        *code = *code * 16 + (isdigit((unsigned char) s[i])
+                              ? s[i] - '0' : tolower(s[i]) - 'a' + 10);
+    }
+    return 1;
+}
+
+/**
+ * Encode a code point as UTF-8.
+ */
+static void
+put_utf8(char *out, size_t *n, unsigned int code)
+{
+    if (code < 0x80) {
+        out[(*n)++] = code;
+    } else if (code < 0x800) {
+        out[(*n)++] = 0xc0 | (code >> 6);
+        out[(*n)++] = 0x80 | (code & 0x3f);
+    } else if (code < 0x10000) {
+        out[(*n)++] = 0xe0 | (code >> 12);
+        out[(*n)++] = 0x80 | ((code >> 6) & 0x3f);
+        out[(*n)++] = 0x80 | (code & 0x3f);
+    } else {
+        out[(*n)++] = 0xf0 | (code >> 18);
+        out[(*n)++] = 0x80 | ((code >> 12) & 0x3f);
+        out[(*n)++] = 0x80 | ((code >> 6) & 0x3f);
+        out[(*n)++] = 0x80 | (code & 0x3f);
+    }
+}
+
+/**
+ * Parse JSON string. Escapes never get longer when decoded, so the result
+ * fits into the length of the rest of the line.
+ *
+ * @param pos   position of the opening quote, moved after the string
+ * @param end   end of the line
+ * @param len   where to store length of the string (out)
+ * @return the string (transfer full) or NULL if it is malformed
+ */
+static char *
+json_string(const char **pos, const char *end, size_t *len)
+{
+    const char *s = *pos + 1;
+    char *out = malloc(end - s + 1);
+    unsigned int code, low;
+    size_t n = 0;
+
+    while (s < end && *s != '"') {
+        if ((unsigned char) *s < 0x20) {
+            goto fail;
+        }
+        if (*s != '\\') {
+            out[n++] = *s++;
+            continue;
+        }
+        if (++s >= end) {
+            goto fail;
+        }
+        switch (*s++) {
+        case '"':   out[n++] = '"'; break;
+        case '\\':  out[n++] = '\\'; break;
+        case '/':   out[n++] = '/'; break;
+        case 'b':   out[n++] = '\b'; break;
+        case 'f':   out[n++] = '\f'; break;
+        case 'n':   out[n++] = '\n'; break;
+        case 'r':   out[n++] = '\r'; break;
+        case 't':   out[n++] = '\t'; break;
+        case 'u':
+            if (!parse_hex4(s, end, &code)) {
+                goto fail;
+            }
+            s += 4;
+            /* Characters outside of the basic plane are surrogate pairs. */
+            if (code >= 0xd800 && code < 0xdc00 && end - s >= 6
+                    && s[0] == '\\' && s[1] == 'u'
+                    && parse_hex4(s + 2, end, &low)
+                    && low >= 0xdc00 && low < 0xe000) {
+                code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                s += 6;
+            }
+            put_utf8(out, &n, code);
+            break;
+        default:
+            goto fail;
+        }
+    }
+    if (s >= end) {
+        goto fail;
+    }
+    *pos = s + 1;
+    out[n] = '\0';
+    *len = n;
+    return out;
+
+fail:
+    free(out);
+    return NULL;
+}
+
+/**
+ * Parse a line of JSONL file into a record.
+ *
+ * @param line  start of the line
+ * @param end   end of the line
+ * @param r     record to fill
+ * @return NULL on success, error message (transfer full) otherwise
+ */
+static char *
+import_parse_json(const char *line, const char *end, ImportRecord *r)
+{
+    const char *s = skip_space(line, end), *start;
+    char *key, *value, *error;
+    size_t len;
+    int field;
+
+    if (s >= end || *s != '{') {
+        return strdup("expected an object");
+    }
+    s = skip_space(s + 1, end);
+    if (s < end && *s == '}') {
+        s++;
+        goto out;
+    }
+    while (1) {
+        if (s >= end || *s != '"'
+                || (key = json_string(&s, end, &len)) == NULL) {
+            return strdup("expected a key");
+        }
+        field = find_field(key);
+        if (field < 0) {
+            error = str_printf("unknown key '%s'", key);
+            free(key);
+            return error;
+        }
+        free(key);
+        s = skip_space(s, end);
+        if (s >= end || *s != ':') {
+            return strdup("expected a colon");
+        }
+        s = skip_space(s + 1, end);
+
+        value = NULL;
+        if (s < end && *s == '"') {
+            if ((value = json_string(&s, end, &len)) == NULL) {
+                return str_printf("malformed %s", field_names[field]);
+            }
+        } else if (end - s >= 4 && strncmp(s, "null", 4) == 0) {
+            s += 4;
+        } else {
+            /* Numbers are kept as written, they are checked later. */
+            for (start = s; s < end && *s != '\0'
+                    && strchr("+-.0123456789eE", *s); s++)
+                ;
+            if (s == start) {
+                return str_printf("unsupported value of %s",
+                        field_names[field]);
+            }
+            len = s - start;
+            value = malloc(len + 1);
+            memcpy(value, start, len);
+            value[len] = '\0';
+        }
+        if (value && (error = import_set(r, field, value, len)) != NULL) {
+            return error;
+        }
+
+        s = skip_space(s, end);
+        if (s < end && *s == ',') {
+            s = skip_space(s + 1, end);
+        } else if (s < end && *s == '}') {
+            s++;
+            break;
+        } else {
+            return strdup("expected a comma or end of the object");
+        }
+    }
+out:
+    if (skip_space(s, end) != end) {
+        return strdup("unexpected characters after the object");
+    }
+    return NULL;
+}
+
+/**
+ * Parse one field of CSV file. Quoted fields can contain commas, newlines
+ * and quotes written twice.
+ *
+ * @param pos       start of the field, moved to the start of the next one
+ * @param end       end of the file
+ * @param len       where to store length of the field (out)
+ * @param row_end   where to store whether the field is the last one in its
+ *                  row (out)
+ * @param line      number of the current line, incremented for each newline
+ * @return the field (transfer full) or NULL if it is malformed
+ */
+static char *
+csv_field(const char **pos, const char *end, size_t *len, int *row_end,
+          size_t *line)
+{
+    const char *s = *pos;
+    char *out = malloc(end - s + 1);
+    size_t n = 0;
+
+    if (s < end && *s == '"') {
+        for (s++; ; s++) {
+            if (s >= end) {
+                goto fail;
+            }
+            if (*s == '"') {
+                if (s + 1 < end && s[1] == '"') {
+                    s++;
+                } else {
+                    break;
+                }
+            } else if (*s == '\n') {
+                (*line)++;
+            }
+            out[n++] = *s;
+        }
+        s++;
+        if (end - s >= 2 && s[0] == '\r' && s[1] == '\n') {
+            s++;
+        }
+    } else {
+        while (s < end && *s != ',' && *s != '\n') {
+            out[n++] = *s++;
+        }
+        if (n > 0 && out[n - 1] == '\r') {
+            n--;
+        }
+    }
+
+    *row_end = 1;
+    if (s < end && *s == ',') {
+        *row_end = 0;
+        s++;
+    } else if (s < end && *s == '\n') {
+        (*line)++;
+        s++;
+    } else if (s < end) {
+        goto fail;
+    }
+    *pos = s;
+    out[n] = '\0';
+    *len = n;
+    return out;
+
+fail:
+    free(out);
+    return NULL;
+}
+
+/**
+ * Add an empty record to an array of records.
+ */
+static ImportRecord *
+add_record(ImportRecord **records, size_t *len, size_t *size, size_t line)
+{
+    ImportRecord *r;
+
+    if (*len == *size) {
+        *size = *size ? 2 * *size : 64;
+        *records = realloc(*records, *size * sizeof(ImportRecord));
+    }
+    r = &(*records)[(*len)++];
+    memset(r, 0, sizeof(ImportRecord));
+    r->line = line;
+    return r;
+}
+
+/**
+ * Parse all lines of a JSONL file.
+ *
+ * @return NULL on success, error message (transfer full) otherwise
+ */
+static char *
+import_parse_jsonl(const char *data, const char *end, ImportRecord **records,
+                   size_t *len, size_t *size, size_t *line)
+{
+    const char *eol;
+    char *error;
+
+    for (*line = 1; data < end; data = eol + 1, (*line)++) {
+        eol = memchr(data, '\n', end - data);
+        if (eol == NULL) {
+            eol = end;
+        }
+        if (skip_space(data, eol) == eol) {
+            continue;
+        }
+        error = import_parse_json(data, eol,
+                add_record(records, len, size, *line));
+        if (error) {
+            return error;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Parse CSV file with a header.
+ *
+ * @return NULL on success, error message (transfer full) otherwise
+ */
+static char *
+import_parse_csv(const char *data, const char *end, ImportRecord **records,
+                 size_t *len, size_t *size, size_t *line)
+{
+    int columns[IMPORT_FIELDS];
+    size_t num = 0, col, flen, start;
+    ImportRecord *r = NULL;
+    char *field, *error;
+    int row_end = 0, f;
+
+    *line = 1;
+    while (!row_end) {
+        if ((field = csv_field(&data, end, &flen, &row_end, line)) == NULL) {
+            *line = 1;
+            return strdup("malformed header");
+        }
+        f = find_field(field);
+        for (col = 0; f >= 0 && col < num; col++) {
+            if (columns[col] == f) f = -1;
+        }
+        if (f < 0 || num == IMPORT_FIELDS) {
+            error = str_printf("unknown or duplicate column '%s'", field);
+            free(field);
+            *line = 1;
+            return error;
+        }
+        free(field);
+        columns[num++] = f;
+    }
+
+    while (data < end) {
+        start = *line;
+        r = NULL;
+        row_end = 0;
+        for (col = 0; !row_end; col++) {
+            field = csv_field(&data, end, &flen, &row_end, line);
+            if (field == NULL) {
+                *line = start;
+                return strdup("malformed field");
+            }
+            if (col == 0 && row_end && flen == 0) {
+                /* Empty line. */
+                free(field);
+                break;
+            }
+            if (col >= num) {
+                free(field);
+                *line = start;
+                return str_printf("more than %zu fields", num);
+            }
+            if (r == NULL) {
+                r = add_record(records, len, size, start);
+            }
+            f = columns[col];
+            if (flen == 0 && f != IMPORT_STDIN && f != IMPORT_STDOUT
+                    && f != IMPORT_STDERR) {
+                free(field);
+                continue;
+            }
+            import_set(r, f, field, flen);
+        }
+        if (r && col < num) {
+            *line = start;
+            return str_printf("expected %zu fields, got %zu", num, col);
+        }
+        /* Empty content only stands for a missing file column. */
+        for (f = IMPORT_STDIN; r && f <= IMPORT_STDERR_FILE; f += 2) {
+            if (r->values[f + 1] && r->lengths[f] == 0) {
+                free(r->values[f]);
+                r->values[f] = NULL;
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Check that a record describes a valid test.
+ *
+ * @return NULL if the record is fine, error message (transfer full)
+ *         otherwise
+ */
+static char *
+import_check(const ImportRecord *r)
+{
+    const char *name = r->values[IMPORT_NAME];
+    char *end;
+    long code;
+    int f;
+
+    /* Only contents of files may contain zero bytes. */
+    for (f = 0; f < IMPORT_FIELDS; f++) {
+        if (r->values[f] && f != IMPORT_STDIN && f != IMPORT_STDOUT
+                && f != IMPORT_STDERR
+                && strlen(r->values[f]) != r->lengths[f]) {
+            return str_printf("bad %s", field_names[f]);
+        }
+    }
+    while (name && isspace((unsigned char) *name)) {
+        name++;
+    }
+    if (name == NULL || *name == '\0') {
+        return strdup("missing name");
+    }
+    for (f = IMPORT_STDIN; f <= IMPORT_STDERR_FILE; f += 2) {
+        if (r->values[f] && r->values[f + 1]) {
+            return str_printf("both %s and %s given", field_names[f],
+                    field_names[f + 1]);
+        }
+    }
+    if (r->values[IMPORT_EXIT_CODE]) {
+        code = strtol(r->values[IMPORT_EXIT_CODE], &end, 10);
+        if (*r->values[IMPORT_EXIT_CODE] == '\0' || *end != '\0'
+                || code < 0 || code > 255) {
+            return str_printf("bad exit code '%s'",
+                    r->values[IMPORT_EXIT_CODE]);
+        }
+    }
+    return NULL;
+}
+
+ImportRecord * import_load(const char *path, size_t *len)
+{
+    ImportRecord *records = NULL;
+    size_t size = 0, line = 0, i, n;
+    const char *ext = strrchr(path, '.');
+    char *data, *error;
+
+    *len = 0;
+    data = read_file(path, &n);
+    if (data == NULL) {
+        fprintf(stderr, "Can not read '%s': %s\n", path, strerror(errno));
+        return NULL;
+    }
+    if (ext && strcmp(ext, ".csv") == 0) {
+        error = import_parse_csv(data, data + n, &records, len, &size, &line);
+    } else {
+        error = import_parse_jsonl(data, data + n, &records, len, &size,
+                &line);
+    }
+    free(data);
+    for (i = 0; error == NULL && i < *len; i++) {
+        line = records[i].line;
+        error = import_check(&records[i]);
+    }
+    if (error) {
+        fprintf(stderr, "Malformed import file '%s' on line %zu: %s\n", path,
+                line, error);
+        free(error);
+        import_free(records, *len);
+        return NULL;
+    }
+    return records ? records : calloc(1, sizeof(ImportRecord));
+}
+
+/**
+ * Write a part of a test given either inline or by a file.
+ *
+ * @return 1 on success, 0 on failure
+ */
+static int
+import_write_part(const ImportRecord *r, ImportField inline_field,
+                  const char *base, const char *dir, const char *name,
+                  const char *ext)
+{
+    const char *file = r->values[inline_field + 1];
+    char *path, *data;
+    size_t len;
+    int ok;
+
+    if (r->values[inline_field]) {
+        return write_test_file(dir, name, ext, r->values[inline_field],
+                r->lengths[inline_field]);
+    }
+    if (file == NULL) {
+        return 1;
+    }
+    path = file[0] == '/' ? strdup(file) : str_printf("%s/%s", base, file);
+    data = read_file(path, &len);
+    if (data == NULL) {
+        fprintf(stderr, "Can not read '%s': %s\n", path, strerror(errno));
+        free(path);
+        return 0;
+    }
+    ok = write_test_file(dir, name, ext, data, len);
+    free(data);
+    free(path);
+    return ok;
+}
+
+int import_write(const ImportRecord *records, size_t len, const char *base,
+                 const char *dir)
+{
+    const ImportRecord *r;
+    char *copy, *name, *str, *s;
+    size_t i;
+    int num, ok = 1;
+
+    /* Numbers are allocated once, the directory is not listed again. */
+    num = get_test_num(dir);
+    for (i = 0; ok && i < len; i++) {
+        r = &records[i];
+        copy = strdup(r->values[IMPORT_NAME]);
+        /* These would be taken for a group or an extension. */
+        for (s = copy; *s; s++) {
+            if (*s == '/' || *s == '.') *s = '_';
+        }
+        name = str_printf("%03d_%s", ++num, sanitize_test_name(copy));
+        free(copy);
+
+        ok = import_write_part(r, IMPORT_STDIN, base, dir, name, EXT_INPUT)
+             && import_write_part(r, IMPORT_STDOUT, base, dir, name,
+                                  EXT_OUTPUT)
+             && import_write_part(r, IMPORT_STDERR, base, dir, name,
+                                  EXT_ERRORS);
+        if (ok && r->values[IMPORT_ARGS]) {
+            str = str_printf("%s\n", r->values[IMPORT_ARGS]);
+            ok = write_test_file(dir, name, EXT_ARGS, str, strlen(str));
+            free(str);
+        }
+        if (ok && r->values[IMPORT_EXIT_CODE]) {
+            str = str_printf("%s\n", r->values[IMPORT_EXIT_CODE]);
+            ok = write_test_file(dir, name, EXT_RETVAL, str, strlen(str));
+            free(str);
+        }
+        free(name);
+    }
+    if (ok) {
+        printf("Imported %zu tests to %s\n", len, dir);
+    }
+    return ok;
+}
+
+void import_free(ImportRecord *records, size_t len)
+{
+    size_t i;
+    int f;
+
+    for (i = 0; records && i < len; i++) {
+        for (f = 0; f < IMPORT_FIELDS; f++) {
+            free(records[i].values[f]);
+        }
+    }
+    free(records);
+}
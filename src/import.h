@@ -0,0 +1,90 @@
+#ifndef IMPORT_H
+#define IMPORT_H
+
+#include <config.h>
+
+#include <stddef.h>
+
+/**
+ * Import creates many tests at once from a file describing them. The file
+ * is either JSONL, with one flat object per line, or CSV with a header
+ * naming the columns; files ending with .csv are read as CSV. Each record
+ * uses the keys listed in ImportField, missing or null values mean the test
+ * does not have that part. Inline content and a file can not be given for
+ * the same stream.
+ *
+ * In CSV, an empty field is a missing value, except for stdin, stdout and
+ * stderr columns, where it is an empty content unless the corresponding
+ * file column is filled.
+ */
+
+/**
+ * Keys of a record, in the order of their names in import_field_name().
+ */
+typedef enum {
+    IMPORT_NAME,
+    IMPORT_ARGS,
+    IMPORT_STDIN,
+    IMPORT_STDIN_FILE,
+    IMPORT_STDOUT,
+    IMPORT_STDOUT_FILE,
+    IMPORT_STDERR,
+    IMPORT_STDERR_FILE,
+    IMPORT_EXIT_CODE,
+    IMPORT_FIELDS
+} ImportField;
+
+/**
+ * Description of one test.
+ */
+typedef struct import_record_t ImportRecord;
+struct import_record_t {
+    /** values of the fields, NULL if missing */
+    char *values[IMPORT_FIELDS];
+    size_t lengths[IMPORT_FIELDS];
+    /** line of the file where the record starts */
+    size_t line;
+};
+
+/**
+ * Get name of a field as used in the file.
+ *
+ * @param field the field
+ * @return the name
+ */
+const char * import_field_name(ImportField field);
+
+/**
+ * Read all records from a file and check them. On failure, error message
+ * with the offending line is printed.
+ *
+ * @param path  file to read
+ * @param len   where to store number of records (out)
+ * @return records to be freed by import_free() or NULL on failure
+ */
+ImportRecord * import_load(const char *path, size_t *len);
+
+/**
+ * Create tests described by records in a directory. The tests are numbered
+ * in the order of records after the tests already in the directory. Paths
+ * in the records are relative to base. On failure, error message is
+ * printed.
+ *
+ * @param records   the records
+ * @param len       number of records
+ * @param base      directory relative paths start from
+ * @param dir       directory for the tests
+ * @return 1 on success, 0 on failure
+ */
+int import_write(const ImportRecord *records, size_t len, const char *base,
+                 const char *dir);
+
+/**
+ * Free records.
+ *
+ * @param records   records to be freed (allow-none)
+ * @param len       number of records
+ */
+void import_free(ImportRecord *records, size_t len);
+
+#endif /* end of include guard: IMPORT_H */
@@ -45,6 +45,16 @@ List * list_reverse(List *list)
     return new;
 }
 
+size_t list_length(List *list)
+{
+    size_t len = 0;
+
+    for (; list != NULL; list = list->next) {
+        len++;
+    }
+    return len;
+}
+
 void list_foreach(List *list, CbFunc cb, void *data)
 {
     while (list != NULL) {
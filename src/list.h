@@ -57,6 +57,14 @@ List * list_append(List *list, void *data);
  */
 List * list_reverse(List *list);
 
+/**
+ * Count items in the list. This function runs in O(n).
+ *
+ * @param list  list to count (allow-none)
+ * @return      number of items
+ */
+size_t list_length(List *list);
+
 /**
  * Call function for each stored piece of data. Callback function should
  * accept two parameters - the first is the data from the list, the second
@@ -0,0 +1,416 @@
+#include <config.h>
+
+#include "manifest.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MANIFEST_HEADER "stest-manifest\t2"
+
+typedef struct {
+    char *path;
+    ManifestStamp stamp;
+    ManifestEntry *entries;
+    size_t len;
+    /** whether the directory was used since the manifest was loaded */
+    int visited;
+} ManifestDir;
+
+struct manifest_t {
+    char *path;
+    ManifestDir *dirs;
+    size_t len;
+    size_t size;
+    /** whether dirs are sorted by path */
+    int sorted;
+    /** whether anything needs to be saved */
+    int changed;
+    /** when the manifest was loaded */
+    time_t now;
+};
+
+static int
+compare_dirs(const void *a, const void *b)
+{
+    return strcmp(((const ManifestDir *) a)->path,
+                  ((const ManifestDir *) b)->path);
+}
+
+static ManifestDir *
+manifest_lookup(Manifest *m, const char *path)
+{
+    ManifestDir key;
+
+    if (!m->sorted) {
+        qsort(m->dirs, m->len, sizeof(ManifestDir), compare_dirs);
+        m->sorted = 1;
+    }
+    key.path = (char *) path;
+    return bsearch(&key, m->dirs, m->len, sizeof(ManifestDir), compare_dirs);
+}
+
+static ManifestDir *
+manifest_add(Manifest *m, const char *path)
+{
+    ManifestDir *d;
+
+    if (m->len == m->size) {
+        m->size = m->size ? 2 * m->size : 16;
+        m->dirs = realloc(m->dirs, m->size * sizeof(ManifestDir));
+    }
+    d = &m->dirs[m->len++];
+    memset(d, 0, sizeof(ManifestDir));
+    d->path = strdup(path);
+    d->stamp.size = -1;
+    m->sorted = 0;
+    return d;
+}
+
+static void
+free_entries(ManifestEntry *entries, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        free(entries[i].name);
+        str_array_free(entries[i].args);
+    }
+    free(entries);
+}
+
+static void
+clear_dirs(Manifest *m)
+{
+    size_t i;
+
+    for (i = 0; i < m->len; i++) {
+        free(m->dirs[i].path);
+        free_entries(m->dirs[i].entries, m->dirs[i].len);
+    }
+    m->len = 0;
+}
+
+/**
+ * Split a line to fields separated by tabs and remove escaping from them.
+ *
+ * @return number of fields
+ */
+static size_t
+split_fields(char *line, char ***fields, size_t *size)
+{
+    size_t n = 0;
+    char *src, *dst, *next;
+
+    while (line != NULL) {
+        if (n == *size) {
+            *size = *size ? 2 * *size : 16;
+            *fields = realloc(*fields, *size * sizeof(char *));
+        }
+        (*fields)[n++] = line;
+        next = strchr(line, '\t');
+        if (next != NULL) *next++ = '\0';
+        for (src = dst = line; *src; src++) {
+            if (*src == '\\' && src[1] != '\0') {
+                src++;
+                *dst++ = *src == 't' ? '\t' : *src == 'n' ? '\n' : *src;
+            } else {
+                *dst++ = *src;
+            }
+        }
+        *dst = '\0';
+        line = next;
+    }
+    return n;
+}
+
+static int
+parse_stamp(char **fields, ManifestStamp *s)
+{
+    char *end1, *end2, *end3;
+
+    errno = 0;
+    s->mtime = strtoll(fields[0], &end1, 10);
+    s->size = strtoll(fields[1], &end2, 10);
+    s->ino = strtoull(fields[2], &end3, 10);
+    return errno == 0 && *fields[0] && !*end1 && *fields[1] && !*end2
+        && *fields[2] && !*end3;
+}
+
+/**
+ * Parse one line of the manifest.
+ *
+ * @return 1 on success, 0 if the line is malformed
+ */
+static int
+parse_line(Manifest *m, char **fields, size_t n)
+{
+    ManifestDir *d = m->len > 0 ? &m->dirs[m->len - 1] : NULL;
+    ManifestEntry *e = d && d->len > 0 ? &d->entries[d->len - 1] : NULL;
+    char *end;
+    size_t i;
+
+    if (strcmp(fields[0], "D") == 0 && n == 5) {
+        d = manifest_add(m, fields[1]);
+        return parse_stamp(fields + 2, &d->stamp);
+    } else if (strcmp(fields[0], "E") == 0 && n == 4 && d != NULL) {
+        /* Entries are only appended while loading, the size is not kept. */
+        if ((d->len & (d->len - 1)) == 0) {
+            d->entries = realloc(d->entries,
+                    (d->len ? 2 * d->len : 1) * sizeof(ManifestEntry));
+        }
+        e = &d->entries[d->len++];
+        memset(e, 0, sizeof(ManifestEntry));
+        e->name = strdup(fields[1]);
+        e->parts = strtoul(fields[2], &end, 16);
+        e->is_dir = fields[3][0] == '1';
+        e->args_stamp.size = -1;
+        e->ret_stamp.size = -1;
+        return *end == '\0';
+    } else if (strcmp(fields[0], "A") == 0 && n >= 4 && e != NULL
+            && e->args == NULL) {
+        e->arg_count = n - 3;
+        e->args = malloc(e->arg_count * sizeof(char *));
+        for (i = 4; i < n; i++) {
+            e->args[i - 4] = strdup(fields[i]);
+        }
+        e->args[n - 4] = NULL;
+        return parse_stamp(fields + 1, &e->args_stamp);
+    } else if (strcmp(fields[0], "R") == 0 && n == 5 && e != NULL) {
+        e->exit_code = strtol(fields[4], &end, 10);
+        return *fields[4] && *end == '\0'
+            && parse_stamp(fields + 1, &e->ret_stamp);
+    }
+    return 0;
+}
+
+Manifest * manifest_load(const char *path)
+{
+    Manifest *m;
+    FILE *fh;
+    char *line = NULL, **fields = NULL;
+    size_t line_size = 0, fields_size = 0, n;
+    int ok = 1;
+
+    m = calloc(1, sizeof(Manifest));
+    m->path = strdup(path);
+    m->sorted = 1;
+    m->now = time(NULL);
+
+    fh = fopen(path, "r");
+    if (fh == NULL) {
+        return m;
+    }
+    if (getline(&line, &line_size, fh) < 0
+            || strcmp(line, MANIFEST_HEADER "\n") != 0) {
+        ok = 0;
+    }
+    while (ok && getline(&line, &line_size, fh) >= 0) {
+        line[strcspn(line, "\n")] = '\0';
+        n = split_fields(line, &fields, &fields_size);
+        ok = parse_line(m, fields, n);
+    }
+    if (!ok) {
+        /* Malformed manifest is rebuilt from scratch. */
+        clear_dirs(m);
+        m->changed = 1;
+    }
+    free(fields);
+    free(line);
+    fclose(fh);
+    return m;
+}
+
+ManifestEntry * manifest_get_dir(Manifest *m, const char *dir,
+                                 const struct stat *info, size_t *len)
+{
+    static ManifestEntry none;
+    ManifestDir *d = manifest_lookup(m, dir);
+
+    if (d == NULL || !manifest_stamp_matches(&d->stamp, info)) {
+        return NULL;
+    }
+    d->visited = 1;
+    *len = d->len;
+    return d->entries ? d->entries : &none;
+}
+
+static int
+compare_entry_names(const void *a, const void *b)
+{
+    return strcmp((*(ManifestEntry * const *) a)->name,
+                  (*(ManifestEntry * const *) b)->name);
+}
+
+void manifest_set_dir(Manifest *m, const char *dir, const struct stat *info,
+                      ManifestEntry *entries, size_t len)
+{
+    ManifestDir *d = manifest_lookup(m, dir);
+    ManifestEntry **old = NULL, *e, key, *keyp = &key, **found;
+    size_t i;
+
+    if (d == NULL) {
+        d = manifest_add(m, dir);
+    } else if (d->len > 0) {
+        old = malloc(d->len * sizeof(ManifestEntry *));
+        for (i = 0; i < d->len; i++) {
+            old[i] = &d->entries[i];
+        }
+        qsort(old, d->len, sizeof(ManifestEntry *), compare_entry_names);
+    }
+
+    for (i = 0; i < len; i++) {
+        e = &entries[i];
+        e->args_stamp.size = -1;
+        e->args = NULL;
+        e->ret_stamp.size = -1;
+        if (old == NULL || e->is_dir) continue;
+        key.name = e->name;
+        found = bsearch(&keyp, old, d->len, sizeof(ManifestEntry *),
+                        compare_entry_names);
+        if (found != NULL && !(*found)->is_dir) {
+            e->args_stamp = (*found)->args_stamp;
+            e->args = (*found)->args;
+            e->arg_count = (*found)->arg_count;
+            e->ret_stamp = (*found)->ret_stamp;
+            e->exit_code = (*found)->exit_code;
+            (*found)->args = NULL;
+        }
+    }
+    free(old);
+
+    free_entries(d->entries, d->len);
+    d->entries = entries;
+    d->len = len;
+    d->visited = 1;
+    manifest_stamp_set(m, &d->stamp, info);
+}
+
+int manifest_stamp_matches(const ManifestStamp *s, const struct stat *info)
+{
+    return s->size >= 0
+        && s->mtime == (int64_t) info->st_mtim.tv_sec * 1000000000
+                       + info->st_mtim.tv_nsec
+        && s->size == (int64_t) info->st_size
+        && s->ino == (uint64_t) info->st_ino;
+}
+
+void manifest_stamp_set(Manifest *m, ManifestStamp *s,
+                        const struct stat *info)
+{
+    /* A change in the same second could keep the modification time on
+     * file systems with coarse timestamps. */
+    if (info->st_mtim.tv_sec >= m->now - 1) {
+        s->size = -1;
+    } else {
+        s->mtime = (int64_t) info->st_mtim.tv_sec * 1000000000
+                   + info->st_mtim.tv_nsec;
+        s->size = info->st_size;
+        s->ino = info->st_ino;
+    }
+    m->changed = 1;
+}
+
+static void
+write_escaped(FILE *fh, const char *str)
+{
+    for (; *str; str++) {
+        switch (*str) {
+        case '\t': fputs("\\t", fh);    break;
+        case '\n': fputs("\\n", fh);    break;
+        case '\\': fputs("\\\\", fh);   break;
+        default:   fputc(*str, fh);     break;
+        }
+    }
+}
+
+static void
+write_stamp(FILE *fh, const ManifestStamp *s)
+{
+    fprintf(fh, "\t%" PRId64 "\t%" PRId64 "\t%" PRIu64, s->mtime, s->size,
+            s->ino);
+}
+
+static void
+write_dir(FILE *fh, const ManifestDir *d)
+{
+    const ManifestEntry *e;
+    size_t i, j;
+
+    fputs("D\t", fh);
+    write_escaped(fh, d->path);
+    write_stamp(fh, &d->stamp);
+    fputc('\n', fh);
+    for (i = 0; i < d->len; i++) {
+        e = &d->entries[i];
+        fputs("E\t", fh);
+        write_escaped(fh, e->name);
+        fprintf(fh, "\t%" PRIx16 "\t%d\n", e->parts, e->is_dir);
+        if (e->args_stamp.size >= 0 && e->args != NULL) {
+            fputc('A', fh);
+            write_stamp(fh, &e->args_stamp);
+            for (j = 0; e->args[j] != NULL; j++) {
+                fputc('\t', fh);
+                write_escaped(fh, e->args[j]);
+            }
+            fputc('\n', fh);
+        }
+        if (e->ret_stamp.size >= 0) {
+            fputc('R', fh);
+            write_stamp(fh, &e->ret_stamp);
+            fprintf(fh, "\t%d\n", e->exit_code);
+        }
+    }
+}
+
+int manifest_save(Manifest *m)
+{
+    char *data = NULL;
+    size_t i, len = 0;
+    FILE *fh;
+    int ok;
+
+    for (i = 0; i < m->len && !m->changed; i++) {
+        /* Directories that were removed are dropped. */
+        m->changed = !m->dirs[i].visited;
+    }
+    if (!m->changed) {
+        return 1;
+    }
+
+    ok = (fh = open_memstream(&data, &len)) != NULL;
+    if (ok) {
+        fputs(MANIFEST_HEADER "\n", fh);
+    }
+    for (i = 0; ok && i < m->len; i++) {
+        if (m->dirs[i].visited) {
+            write_dir(fh, &m->dirs[i]);
+        }
+    }
+    if (fh != NULL) {
+        ok = !ferror(fh) && fclose(fh) == 0 && ok;
+    }
+    ok = ok && write_file(m->path, data, len);
+    if (!ok) {
+        fprintf(stderr, "Can not write manifest '%s': %s\n", m->path,
+                strerror(errno));
+    } else {
+        m->changed = 0;
+    }
+    free(data);
+    return ok;
+}
+
+void manifest_free(Manifest *m)
+{
+    if (m) {
+        clear_dirs(m);
+        free(m->dirs);
+        free(m->path);
+    }
+    free(m);
+}
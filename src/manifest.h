@@ -0,0 +1,150 @@
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include <config.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+/**
+ * Manifest remembers what was found in a directory with tests, so that the
+ * next run does not need to list it again. For each directory it stores
+ * names of tests and subdirectories with the files the tests have, and for
+ * each test the parsed arguments and the expected exit code.
+ *
+ * Everything is validated by stamps of the files it comes from: listing of
+ * a directory is used while the directory was not modified and arguments
+ * are used while the args file was not modified. Files modified just before
+ * they were recorded are not trusted, as a later change could keep the same
+ * modification time.
+ *
+ * The manifest is saved as a text file. The first line is a header, then
+ * each directory is stored as a D line followed by one E line for each of
+ * its entries, which can be followed by A line with arguments and R line
+ * with exit code. Fields are separated by tabs, tabs, newlines and
+ * backslashes in names and arguments are escaped by a backslash.
+ */
+typedef struct manifest_t Manifest;
+
+/**
+ * Directory in the directory with tests where state files of stest are
+ * kept. Writing them to the directory with tests would change its
+ * modification time, so its listing would never be used.
+ */
+#define STATE_DIR ".stest"
+
+/**
+ * Name of the manifest file in STATE_DIR.
+ */
+#define MANIFEST_FILE "manifest"
+
+/**
+ * What a file looked like when its content was recorded.
+ */
+typedef struct manifest_stamp_t ManifestStamp;
+struct manifest_stamp_t {
+    /** modification time in nanoseconds */
+    int64_t mtime;
+    /** size of the file, negative if the stamp is not valid */
+    int64_t size;
+    uint64_t ino;
+};
+
+/**
+ * Test or subdirectory stored in the manifest.
+ */
+typedef struct manifest_entry_t ManifestEntry;
+struct manifest_entry_t {
+    char *name;
+    /** mask of TestPart values */
+    uint16_t parts;
+    int is_dir;
+    ManifestStamp args_stamp;
+    /** parsed arguments with the terminating NULL counted in arg_count,
+     * valid if args_stamp is */
+    char **args;
+    size_t arg_count;
+    ManifestStamp ret_stamp;
+    /** expected exit code, valid if ret_stamp is */
+    int exit_code;
+};
+
+/**
+ * Load manifest from a file. Missing or malformed file gives an empty
+ * manifest.
+ *
+ * @param path  file to read
+ * @return new manifest
+ */
+Manifest * manifest_load(const char *path);
+
+/**
+ * Get entries of a directory if it was not modified since they were
+ * recorded. Entries are in the order they were stored in.
+ *
+ * @param m     the manifest
+ * @param dir   path of the directory relative to the top directory, "." for
+ *              the top directory itself
+ * @param info  current status of the directory
+ * @param len   where to store number of entries (out)
+ * @return entries (transfer none) or NULL if the directory is not known or
+ *         was modified
+ */
+ManifestEntry * manifest_get_dir(Manifest *m, const char *dir,
+                                 const struct stat *info, size_t *len);
+
+/**
+ * Store entries of a directory. Arguments and exit codes recorded for tests
+ * of the same name are kept. Entries of a directory must not be replaced
+ * while they are used, that is a directory can be stored only once while
+ * tests are loaded.
+ *
+ * @param m         the manifest
+ * @param dir       path of the directory as for manifest_get_dir()
+ * @param info      status of the directory before it was listed
+ * @param entries   entries of the directory, only names, parts and is_dir
+ *                  are used (transfer full)
+ * @param len       number of entries
+ */
+void manifest_set_dir(Manifest *m, const char *dir, const struct stat *info,
+                      ManifestEntry *entries, size_t len);
+
+/**
+ * Check whether a file still looks the way it did when it was recorded.
+ *
+ * @param s     stamp of the file
+ * @param info  current status of the file
+ * @return 1 if the file is unchanged, 0 otherwise
+ */
+int manifest_stamp_matches(const ManifestStamp *s, const struct stat *info);
+
+/**
+ * Record stamp of a file whose content was stored in the manifest. If the
+ * file was modified too recently, the stamp is not valid.
+ *
+ * @param m     the manifest
+ * @param s     stamp to set
+ * @param info  status of the file before it was read
+ */
+void manifest_stamp_set(Manifest *m, ManifestStamp *s,
+                        const struct stat *info);
+
+/**
+ * Write manifest to the file it was loaded from, if anything changed. Only
+ * directories used since the manifest was loaded are written. The file is
+ * replaced atomically. On failure, error message is printed.
+ *
+ * @param m     manifest to save
+ * @return 1 on success, 0 on failure
+ */
+int manifest_save(Manifest *m);
+
+/**
+ * Free a manifest.
+ *
+ * @param m     manifest to be freed (allow-none)
+ */
+void manifest_free(Manifest *m);
+
+#endif /* end of include guard: MANIFEST_H */
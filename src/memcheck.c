@@ -0,0 +1,456 @@
+#include <config.h>
+
+#include "memcheck.h"
+#include "utils.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * How deep elements are tracked. Valgrind output never nests deeper.
+ */
+#define MAX_DEPTH 16
+#define MAX_NAME 32
+
+/**
+ * State of the streaming parser.
+ */
+typedef struct {
+    FILE *fh;
+    MemcheckReport *report;
+    /** names of open elements */
+    char names[MAX_DEPTH][MAX_NAME];
+    int depth;
+    /** character data of the current element */
+    char *text;
+    size_t text_len;
+    size_t text_size;
+    int seen_root;
+    /** error being read or NULL */
+    MemcheckError *error;
+    /** number of stacks seen in the current error */
+    int stacks;
+    /** parts of the current frame */
+    char *fn;
+    char *file;
+    char *obj;
+    char *line;
+} Parser;
+
+static void
+parser_append(Parser *p, char c)
+{
+    if (p->text_len + 1 >= p->text_size) {
+        p->text_size = p->text_size ? 2 * p->text_size : 256;
+        p->text = realloc(p->text, p->text_size);
+    }
+    p->text[p->text_len++] = c;
+    p->text[p->text_len] = '\0';
+}
+
+static void
+parser_clear_text(Parser *p)
+{
+    p->text_len = 0;
+    if (p->text) p->text[0] = '\0';
+}
+
+/**
+ * Get name of an open element, 0 is the innermost one.
+ */
+static const char *
+parser_open(Parser *p, int n)
+{
+    int i = p->depth - 1 - n;
+    return i >= 0 && i < MAX_DEPTH ? p->names[i] : "";
+}
+
+static void
+parser_clear_frame(Parser *p)
+{
+    free(p->fn);
+    free(p->file);
+    free(p->obj);
+    free(p->line);
+    p->fn = p->file = p->obj = p->line = NULL;
+}
+
+/**
+ * Replace string with a copy of the current text.
+ */
+static void
+parser_take_text(Parser *p, char **dest)
+{
+    free(*dest);
+    *dest = strdup(p->text ? p->text : "");
+}
+
+static void
+parser_start(Parser *p, const char *name)
+{
+    MemcheckReport *r = p->report;
+
+    if (p->depth < MAX_DEPTH) {
+        snprintf(p->names[p->depth], MAX_NAME, "%s", name);
+    }
+    p->depth++;
+    parser_clear_text(p);
+
+    if (strcmp(name, "valgrindoutput") == 0) {
+        p->seen_root = 1;
+    } else if (strcmp(name, "error") == 0
+            && strcmp(parser_open(p, 1), "valgrindoutput") == 0) {
+        if (r->len == r->size) {
+            r->size = r->size ? 2 * r->size : 8;
+            r->errors = realloc(r->errors, r->size * sizeof(MemcheckError));
+        }
+        p->error = &r->errors[r->len++];
+        memset(p->error, 0, sizeof(MemcheckError));
+        p->stacks = 0;
+    } else if (strcmp(name, "stack") == 0 && p->error) {
+        p->stacks++;
+    } else if (strcmp(name, "frame") == 0) {
+        parser_clear_frame(p);
+    }
+}
+
+static void
+parser_end(Parser *p)
+{
+    MemcheckReport *r = p->report;
+    MemcheckError *e = p->error;
+    const char *name = parser_open(p, 0);
+    const char *parent = parser_open(p, 1);
+    /* Only the stack where the error happened is kept. */
+    int in_stack = e != NULL && p->stacks == 1
+                   && strcmp(parser_open(p, 2), "stack") == 0;
+
+    if (e && strcmp(parent, "error") == 0 && strcmp(name, "kind") == 0) {
+        parser_take_text(p, &e->kind);
+    } else if (e && ((strcmp(parent, "error") == 0
+                      && strcmp(name, "what") == 0)
+                     || (strcmp(parent, "xwhat") == 0
+                         && strcmp(name, "text") == 0))) {
+        parser_take_text(p, &e->what);
+    } else if (e && strcmp(parent, "xwhat") == 0
+            && strcmp(name, "leakedbytes") == 0) {
+        e->leaked_bytes = atol(p->text);
+    } else if (in_stack && strcmp(parent, "frame") == 0) {
+        if (strcmp(name, "fn") == 0) parser_take_text(p, &p->fn);
+        else if (strcmp(name, "file") == 0) parser_take_text(p, &p->file);
+        else if (strcmp(name, "obj") == 0) parser_take_text(p, &p->obj);
+        else if (strcmp(name, "line") == 0) parser_take_text(p, &p->line);
+    } else if (e && p->stacks == 1 && strcmp(name, "frame") == 0
+            && strcmp(parent, "stack") == 0
+            && e->frame_num < MEMCHECK_FRAMES) {
+        if (p->file) {
+            e->frames[e->frame_num++] = str_printf("%s (%s:%s)",
+                    p->fn ? p->fn : "???", p->file, p->line ? p->line : "?");
+        } else {
+            e->frames[e->frame_num++] = str_printf("%s (in %s)",
+                    p->fn ? p->fn : "???", p->obj ? p->obj : "???");
+        }
+    } else if (e && strcmp(name, "error") == 0) {
+        /* Leaks are not listed among error counts. */
+        if (e->kind && strncmp(e->kind, "Leak_", 5) == 0) {
+            r->total++;
+            r->leaked_bytes += e->leaked_bytes;
+        }
+        p->error = NULL;
+    } else if (strcmp(name, "count") == 0 && strcmp(parent, "pair") == 0
+            && strcmp(parser_open(p, 2), "errorcounts") == 0) {
+        r->total += atol(p->text);
+    } else if (strcmp(name, "valgrindoutput") == 0) {
+        r->complete = 1;
+    }
+
+    p->depth--;
+    parser_clear_text(p);
+}
+
+/**
+ * Read characters until the sequence is found.
+ */
+static void
+parser_skip_past(Parser *p, const char *seq)
+{
+    size_t matched = 0, len = strlen(seq);
+    int c;
+
+    while (matched < len && (c = getc(p->fh)) != EOF) {
+        if (c == seq[matched]) {
+            matched++;
+        } else {
+            matched = c == seq[0] ? 1 : 0;
+        }
+    }
+}
+
+/**
+ * Read a tag after its opening angle bracket.
+ */
+static void
+parser_tag(Parser *p)
+{
+    char name[MAX_NAME];
+    size_t len = 0;
+    int c, closing = 0, empty, prev = 0;
+
+    c = getc(p->fh);
+    if (c == '?') {
+        parser_skip_past(p, "?>");
+        return;
+    }
+    if (c == '!') {
+        parser_skip_past(p, (c = getc(p->fh)) == '-' ? "-->" : ">");
+        return;
+    }
+    if (c == '/') {
+        closing = 1;
+        c = getc(p->fh);
+    }
+    while (c != EOF && c != '>' && c != '/' && c != ' ' && c != '\t'
+            && c != '\n' && c != '\r') {
+        if (len + 1 < MAX_NAME) name[len++] = c;
+        c = getc(p->fh);
+    }
+    name[len] = '\0';
+    /* Attributes are not used by Valgrind except in the declaration. */
+    while (c != EOF && c != '>') {
+        prev = c;
+        c = getc(p->fh);
+    }
+    empty = prev == '/';
+    if (closing) {
+        if (p->depth > 0) parser_end(p);
+        return;
+    }
+    parser_start(p, name);
+    if (empty) {
+        parser_end(p);
+    }
+}
+
+/**
+ * Read an entity reference after its ampersand.
+ */
+static void
+parser_entity(Parser *p)
+{
+    static const struct {
+        const char *name;
+        char c;
+    } entities[] = {
+        { "lt", '<' }, { "gt", '>' }, { "amp", '&' }, { "quot", '"' },
+        { "apos", '\'' }, { NULL, 0 }
+    };
+    char name[8];
+    size_t len = 0, i;
+    int c;
+
+    while ((c = getc(p->fh)) != EOF && c != ';' && len + 1 < sizeof(name)) {
+        name[len++] = c;
+    }
+    name[len] = '\0';
+    for (i = 0; entities[i].name; i++) {
+        if (strcmp(name, entities[i].name) == 0) {
+            parser_append(p, entities[i].c);
+            return;
+        }
+    }
+    if (name[0] == '#') {
+        c = name[1] == 'x' ? strtol(name + 2, NULL, 16) : atoi(name + 1);
+        parser_append(p, c > 0 && c < 128 ? c : '?');
+    }
+}
+
+int memcheck_parse(FILE *fh, MemcheckReport *report)
+{
+    Parser p;
+    int c;
+
+    memset(&p, 0, sizeof(Parser));
+    p.fh = fh;
+    p.report = report;
+
+    while ((c = getc(fh)) != EOF) {
+        if (c == '<') {
+            parser_tag(&p);
+        } else if (c == '&') {
+            parser_entity(&p);
+        } else if (p.depth > 0) {
+            parser_append(&p, c);
+        }
+    }
+
+    parser_clear_frame(&p);
+    free(p.text);
+    return p.seen_root;
+}
+
+static MemcheckError *
+report_add_error(MemcheckReport *r, const char *kind, const char *what)
+{
+    MemcheckError *e;
+
+    if (r->len == r->size) {
+        r->size = r->size ? 2 * r->size : 8;
+        r->errors = realloc(r->errors, r->size * sizeof(MemcheckError));
+    }
+    e = &r->errors[r->len++];
+    memset(e, 0, sizeof(MemcheckError));
+    e->kind = strdup(kind);
+    e->what = strdup(what);
+    r->total++;
+    return e;
+}
+
+/**
+ * Find message of UndefinedBehaviorSanitizer in a line such as
+ * "/src/a.c:4:7: runtime error: signed integer overflow". Only lines that
+ * start with a location have the message, programs can print the words
+ * elsewhere.
+ *
+ * @return start of ": runtime error: " or NULL if the line is not a report
+ */
+static char *
+find_runtime_error(char *line)
+{
+    char *pos = strstr(line, ": runtime error: "), *p = pos;
+    int i;
+
+    if (pos == NULL) {
+        return NULL;
+    }
+    /* Column and line numbers, each preceded by a colon. */
+    for (i = 0; i < 2; i++) {
+        if (p == line || !isdigit((unsigned char) p[-1])) {
+            return NULL;
+        }
+        while (p > line && isdigit((unsigned char) p[-1])) p--;
+        if (p == line || *--p != ':') {
+            return NULL;
+        }
+    }
+    /* The file name starts the line, without any text before it. */
+    return p > line && strcspn(line, " \t") >= (size_t) (p - line)
+        ? pos : NULL;
+}
+
+/**
+ * Parse stack frame line such as "    #1 0x4c3b1a in main /src/a.c:5:12"
+ * or "    #2 0x7f00 (/lib/libc.so.6+0x21b96)".
+ *
+ * @return formatted frame or NULL if the line is not a frame
+ */
+static char *
+parse_sanitizer_frame(const char *line)
+{
+    const char *pos = line + strspn(line, " \t"), *fn, *loc;
+    size_t fn_len;
+
+    if (*pos != '#') {
+        return NULL;
+    }
+    pos = strchr(pos, ' ');
+    if (pos == NULL) {
+        return NULL;
+    }
+    pos += strspn(pos, " ");
+    /* Skip the address. */
+    pos += strcspn(pos, " ");
+    pos += strspn(pos, " ");
+    if (strncmp(pos, "in ", 3) != 0) {
+        /* Only the object is known, e.g. "(/lib/libc.so.6+0x21b96)". */
+        if (*pos == '(') pos++;
+        return str_printf("??? (in %.*s)", (int) strcspn(pos, ")"), pos);
+    }
+    fn = pos + 3;
+    fn_len = strcspn(fn, " ");
+    loc = fn + fn_len;
+    loc += strspn(loc, " ");
+    if (*loc == '(') {
+        return str_printf("%.*s (in %.*s)", (int) fn_len, fn,
+                (int) strcspn(loc + 1, ")"), loc + 1);
+    }
+    return str_printf("%.*s (%s)", (int) fn_len, fn, *loc ? loc : "?");
+}
+
+size_t memcheck_parse_sanitizer(FILE *fh, MemcheckReport *report)
+{
+    MemcheckError *e = NULL;
+    char *line = NULL, *pos, *frame, kind[64];
+    size_t line_size = 0, found = 0;
+    ssize_t len;
+    long bytes;
+    /* frames are only kept from the first stack of each error */
+    int in_stack = 0, stack_done = 0;
+
+    while ((len = getline(&line, &line_size, fh)) >= 0) {
+        if (len > 0 && line[len - 1] == '\n') {
+            line[--len] = '\0';
+        }
+
+        if ((frame = parse_sanitizer_frame(line)) != NULL) {
+            if (e && !stack_done && e->frame_num < MEMCHECK_FRAMES) {
+                e->frames[e->frame_num++] = frame;
+            } else {
+                free(frame);
+            }
+            in_stack = 1;
+            continue;
+        }
+        if (in_stack) {
+            stack_done = 1;
+            in_stack = 0;
+        }
+
+        if ((pos = strstr(line, "Sanitizer: ")) != NULL
+                && strstr(line, "ERROR: ") != NULL) {
+            pos += strlen("Sanitizer: ");
+            if (strncmp(pos, "detected memory leaks", 21) == 0) {
+                /* Each leak follows as a separate error. */
+                e = NULL;
+                continue;
+            }
+            snprintf(kind, sizeof(kind), "%.*s", (int) strcspn(pos, " "),
+                    pos);
+            e = report_add_error(report, kind, pos);
+        } else if (sscanf(line, "Direct leak of %ld", &bytes) == 1
+                || sscanf(line, "Indirect leak of %ld", &bytes) == 1) {
+            e = report_add_error(report, line[0] == 'D'
+                    ? "direct-leak" : "indirect-leak", line);
+            e->leaked_bytes = bytes;
+            report->leaked_bytes += bytes;
+        } else if ((pos = find_runtime_error(line)) != NULL) {
+            *pos = '\0';
+            e = report_add_error(report, "undefined-behavior",
+                    pos + strlen(": runtime error: "));
+            /* The location is known even without stack trace. */
+            e->frames[e->frame_num++] = str_printf("??? (%s)", line);
+        } else {
+            continue;
+        }
+        found++;
+        in_stack = stack_done = 0;
+    }
+    free(line);
+    report->complete = 1;
+    return found;
+}
+
+void memcheck_report_clear(MemcheckReport *report)
+{
+    size_t i, j;
+
+    for (i = 0; i < report->len; i++) {
+        free(report->errors[i].kind);
+        free(report->errors[i].what);
+        for (j = 0; j < report->errors[i].frame_num; j++) {
+            free(report->errors[i].frames[j]);
+        }
+    }
+    free(report->errors);
+    memset(report, 0, sizeof(MemcheckReport));
+}
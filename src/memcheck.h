@@ -0,0 +1,79 @@
+#ifndef MEMCHECK_H
+#define MEMCHECK_H
+
+#include <config.h>
+
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * Errors reported by a Valgrind tool in its XML output (--xml=yes) or by
+ * sanitizers (AddressSanitizer, LeakSanitizer and UndefinedBehaviorSanitizer)
+ * in their logs. The output is parsed as a stream, so that even very long
+ * reports are read in one pass without loading them into memory.
+ */
+
+/**
+ * How many stack frames are kept for each error.
+ */
+#define MEMCHECK_FRAMES 4
+
+typedef struct memcheck_error_t MemcheckError;
+struct memcheck_error_t {
+    /** kind of the error, e.g. InvalidRead or Leak_DefinitelyLost from
+     * Valgrind, heap-buffer-overflow or direct-leak from sanitizers */
+    char *kind;
+    /** human readable description */
+    char *what;
+    /** number of bytes lost for leaks, 0 for other errors */
+    long leaked_bytes;
+    /** top frames of the stack where the error happened, formatted as
+     * function followed by file and line if known */
+    char *frames[MEMCHECK_FRAMES];
+    size_t frame_num;
+};
+
+typedef struct memcheck_report_t MemcheckReport;
+struct memcheck_report_t {
+    /** errors in the order of the output, each of them is one context */
+    MemcheckError *errors;
+    size_t len;
+    size_t size;
+    /** number of errors including repeated occurrences */
+    long total;
+    /** number of bytes in all leaks */
+    long leaked_bytes;
+    /** whether the whole output was read, it is not if the tool was
+     * killed */
+    int complete;
+};
+
+/**
+ * Parse XML output of Valgrind.
+ *
+ * @param fh        file with the output
+ * @param report    where to store the errors, it should be zeroed
+ * @return 1 if the file is Valgrind XML output, 0 otherwise
+ */
+int memcheck_parse(FILE *fh, MemcheckReport *report);
+
+/**
+ * Parse log of sanitizers, as written to log_path set in ASAN_OPTIONS,
+ * LSAN_OPTIONS or UBSAN_OPTIONS. Errors are added to the report, so logs of
+ * several processes can be parsed into one report. Each error, including
+ * each leak, counts once.
+ *
+ * @param fh        file with the log
+ * @param report    where to store the errors
+ * @return number of errors found in the log
+ */
+size_t memcheck_parse_sanitizer(FILE *fh, MemcheckReport *report);
+
+/**
+ * Free all data held by a report, but not the report itself.
+ *
+ * @param report    report to clear
+ */
+void memcheck_report_clear(MemcheckReport *report);
+
+#endif /* end of include guard: MEMCHECK_H */
@@ -3,39 +3,186 @@
 #include "outputqueue.h"
 #include "utils.h"
 
+#include <errno.h>
 #include <string.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+/**
+ * Minimal size of a chunk. Larger strings get a chunk of their own size.
+ */
+#define CHUNK_SIZE (16 * 1024)
+
+/**
+ * Number of chunks written by one writev(2) call, _XOPEN_IOV_MAX is the
+ * least limit guaranteed.
+ */
+#define FLUSH_IOV 16
+
+/**
+ * Block of memory the strings are appended to.
+ */
+typedef struct oqueue_chunk_t OQueueChunk;
+struct oqueue_chunk_t {
+    OQueueChunk *next;
+    size_t size;
+    size_t len;
+    char data[];
+};
+
+/**
+ * The queue is an append-only list of chunks. Strings are stored without
+ * terminating zeros and the chunks are written out as they are. After a
+ * flush, the first chunk is kept for reuse.
+ */
 struct oqueue_t {
-    List *data;
+    OQueueChunk *head;
+    OQueueChunk *tail;
 };
 
 OQueue * oqueue_new(void)
 {
     OQueue *q = malloc(sizeof(OQueue));
-    q->data = NULL;
+    q->head = q->tail = NULL;
     return q;
 }
 
+/**
+ * Free a chain of chunks.
+ */
+static void
+free_chunks(OQueueChunk *chunk)
+{
+    OQueueChunk *next;
+
+    for (; chunk; chunk = next) {
+        next = chunk->next;
+        free(chunk);
+    }
+}
+
 void oqueue_free(OQueue *q)
 {
-    if (q && q->data) {
-        list_destroy(q->data, DESTROYFUNC(free));
+    if (q) {
+        free_chunks(q->head);
     }
     free(q);
 }
 
+/**
+ * Append a new chunk with room for at least size bytes to the queue.
+ *
+ * @return the new chunk
+ */
+static OQueueChunk *
+add_chunk(OQueue *q, size_t size)
+{
+    OQueueChunk *chunk;
+
+    if (size < CHUNK_SIZE) size = CHUNK_SIZE;
+    chunk = malloc(sizeof(OQueueChunk) + size);
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->len = 0;
+    if (q->tail) {
+        q->tail->next = chunk;
+    } else {
+        q->head = chunk;
+    }
+    q->tail = chunk;
+    return chunk;
+}
+
+/**
+ * Copy data at the end of the queue. The free space of the last chunk is
+ * filled first, the rest goes to a new chunk.
+ */
+static void
+oqueue_append(OQueue *q, const char *data, size_t len)
+{
+    OQueueChunk *chunk = q->tail;
+    size_t n;
+
+    if (chunk && chunk->len < chunk->size) {
+        n = chunk->size - chunk->len;
+        if (n > len) n = len;
+        memcpy(chunk->data + chunk->len, data, n);
+        chunk->len += n;
+        data += n;
+        len -= n;
+    }
+    if (len > 0) {
+        chunk = add_chunk(q, len);
+        memcpy(chunk->data, data, len);
+        chunk->len = len;
+    }
+}
+
 void oqueue_push(OQueue *q, const char *str)
 {
-    q->data = list_prepend(q->data, strdup(str));
+    oqueue_append(q, str, strlen(str));
+}
+
+/**
+ * Write all chunks to a file descriptor, FLUSH_IOV of them at a time.
+ *
+ * @return 1 on success, 0 on failure with errno set
+ */
+static int
+write_chunks(const OQueueChunk *chunk, int fd)
+{
+    struct iovec iov[FLUSH_IOV];
+    int i, n;
+    ssize_t res;
+
+    while (chunk) {
+        for (n = 0; chunk && n < FLUSH_IOV; chunk = chunk->next) {
+            if (chunk->len == 0) continue;
+            iov[n].iov_base = (void *) chunk->data;
+            iov[n++].iov_len = chunk->len;
+        }
+        i = 0;
+        while (i < n) {
+            res = writev(fd, iov + i, n - i);
+            if (res < 0) {
+                if (errno == EINTR) continue;
+                return 0;
+            }
+            /* Skip what was written, partial write resumes mid chunk. */
+            while (i < n && (size_t) res >= iov[i].iov_len) {
+                res -= iov[i++].iov_len;
+            }
+            if (i < n) {
+                iov[i].iov_base = (char *) iov[i].iov_base + res;
+                iov[i].iov_len -= res;
+            }
+        }
+    }
+    return 1;
 }
 
 void oqueue_flush(OQueue *q, FILE *fh)
 {
-    q->data = list_reverse(q->data);
-    list_foreach(q->data, CBFUNC(fputs), fh);
-    list_destroy(q->data, DESTROYFUNC(free));
-    q->data = NULL;
+    const OQueueChunk *chunk;
+    int fd;
+
+    /* Text already buffered in the stream goes first. Streams without a
+     * file descriptor are written through stdio. */
+    fflush(fh);
+    if ((fd = fileno(fh)) >= 0) {
+        write_chunks(q->head, fd);
+    } else {
+        for (chunk = q->head; chunk; chunk = chunk->next) {
+            fwrite(chunk->data, 1, chunk->len, fh);
+        }
+    }
+
+    if (q->head) {
+        free_chunks(q->head->next);
+        q->head->next = NULL;
+        q->head->len = 0;
+        q->tail = q->head;
+    }
 }
 
 void oqueue_pushf(OQueue *q, const char *fmt, ...)
@@ -48,60 +195,43 @@ void oqueue_pushf(OQueue *q, const char *fmt, ...)
 
 void oqueue_pushvf(OQueue *q, const char *fmt, va_list ap)
 {
-    char *str;
-    ssize_t len = 100;
-    int n;
+    OQueueChunk *chunk = q->tail;
+    size_t room = chunk ? chunk->size - chunk->len : 0;
     va_list ap_copy;
+    int n;
 
-    str = calloc(len, sizeof(char));
-
-    while (1) {
+    /* Formatted right into the last chunk, only if there is not enough room
+     * for the result, it is formatted again into a new one. */
+    va_copy(ap_copy, ap);
+    n = vsnprintf(room > 0 ? chunk->data + chunk->len : NULL, room, fmt,
+            ap_copy);
+    va_end(ap_copy);
+    if (n < 0) {
+        return;
+    }
+    if ((size_t) n >= room) {
+        /* The terminating zero needs room too, but is not kept. */
+        chunk = add_chunk(q, n + 1);
         va_copy(ap_copy, ap);
-        n = vsnprintf(str, len, fmt, ap_copy);
-
-        if (n > -1 && n < len) {
-            break;
-        }
-
-        len *= 2;
-        str = realloc(str, len * sizeof(char));
+        vsnprintf(chunk->data, n + 1, fmt, ap_copy);
+        va_end(ap_copy);
     }
-
-    oqueue_push(q, str);
-    free(str);
+    chunk->len += n;
 }
 
 void oqueue_copy_from_fd(OQueue *dest, int source)
 {
-    char buffer[1024];
+    OQueueChunk *chunk = dest->tail;
     ssize_t len;
 
-    while ((len = read(source, buffer, 1024)) > 0) {
-        buffer[len] = '\0';
-        oqueue_push(dest, buffer);
-    }
-}
-
-void oqueue_copy_from_valgrind(OQueue *queue, FILE *fh, int contexts)
-{
-    char *line = NULL;
-    ssize_t size, strip;
-    size_t len = 0;
-    int i;
-
-    fseek(fh, 0, SEEK_SET);
-    for (i = 0; i < 5; i++) {   /* Strip leading header (5 lines) */
-        getline(&line, &len, fh);
-    }
-    strip = getline(&line, &len, fh);
-    for (i = 0; i < contexts; i++) {
-        do {
-            size = getline(&line, &len, fh);
-            if (size <= strip) break;
-            oqueue_push(queue, line + strip - 1);
-        } while (1);
-        oqueue_push(queue, "\n");
+    /* Data are read directly into the chunks. */
+    while (1) {
+        if (chunk == NULL || chunk->len == chunk->size) {
+            chunk = add_chunk(dest, CHUNK_SIZE);
+        }
+        len = read(source, chunk->data + chunk->len, chunk->size - chunk->len);
+        if (len < 0 && errno == EINTR) continue;
+        if (len <= 0) break;
+        chunk->len += len;
     }
-
-    free(line);
 }
@@ -9,8 +9,8 @@
 #include "list.h"
 
 /**
- * Output queue is basically a wrapper around a list of strings. However, there
- * is no direct access to the list.
+ * Output queue collects text to be printed later at once. The text is
+ * appended to large chunks of memory, there is no direct access to them.
  */
 typedef struct oqueue_t OQueue;
 
@@ -29,7 +29,7 @@ OQueue * oqueue_new(void);
 void oqueue_free(OQueue *q);
 
 /**
- * Add another string to queue. This string will be duplicated.
+ * Add another string to queue. This string will be copied.
  *
  * @param q     the output queue
  * @param str   string to be added
@@ -73,14 +73,5 @@ void oqueue_flush(OQueue *q, FILE *fh);
  */
 void oqueue_copy_from_fd(OQueue *queue, int source);
 
-/**
- * Copy error messages from valgrind output stored in file to output queue.
- *
- * @param queue where to store the messages
- * @param fh    file handle to read from
- * @param ctxs  how many error messages are there
- */
-void oqueue_copy_from_valgrind(OQueue *queue, FILE *fh, int ctxs);
-
 
 #endif /* end of include guard: OUTPUTQUEUE_H */
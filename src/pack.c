@@ -0,0 +1,338 @@
+#include <config.h>
+
+#include "pack.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define PACK_MAGIC "STESTPK"
+#define PACK_VERSION 2
+/**
+ * Written as a number, tells whether the pack comes from a machine with the
+ * same byte order.
+ */
+#define PACK_BYTE_ORDER 0x01020304
+
+typedef struct pack_header_t PackHeader;
+struct pack_header_t {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t test_num;
+    uint64_t index_offset;
+    uint64_t names_offset;
+    uint64_t names_len;
+};
+
+typedef struct pack_entry_t PackEntry;
+struct pack_entry_t {
+    /** offset of the name in names, names end with zero byte */
+    uint64_t name;
+    /** offsets of the contents from the start of the pack */
+    uint64_t offsets[PACK_PARTS];
+    uint64_t lengths[PACK_PARTS];
+    uint32_t parts;
+    uint32_t reserved;
+};
+
+struct pack_t {
+    unsigned int refs;
+    char *map;
+    size_t size;
+    const PackHeader *header;
+    const PackEntry *entries;
+    const char *names;
+};
+
+/**
+ * Check that a test name is a relative path without empty, "." and ".."
+ * components, so that unpacking the test can not write outside of the
+ * target directory.
+ */
+static int
+is_safe_name(const char *name)
+{
+    size_t len;
+
+    if (*name == '/') {
+        return 0;
+    }
+    do {
+        len = strcspn(name, "/");
+        if (len == 0 || (name[0] == '.' && (len == 1
+                        || (len == 2 && name[1] == '.')))) {
+            return 0;
+        }
+        name += len;
+    } while (*name++ == '/');
+    return 1;
+}
+
+/**
+ * Check that all offsets in the pack point inside of it, so that a damaged
+ * pack can not make stest read outside of the mapping, and that names of
+ * tests are safe to be used as paths.
+ */
+static int
+pack_check(Pack *p)
+{
+    const PackHeader *h = p->header;
+    const PackEntry *e;
+    uint64_t i, j;
+
+    if (memcmp(h->magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0
+            || h->version != PACK_VERSION
+            || h->byte_order != PACK_BYTE_ORDER
+            || h->index_offset > p->size
+            || h->test_num > (p->size - h->index_offset) / sizeof(PackEntry)
+            || h->index_offset % sizeof(uint64_t) != 0
+            || h->names_offset > p->size
+            || h->names_len > p->size - h->names_offset
+            || (h->names_len > 0
+                && p->map[h->names_offset + h->names_len - 1] != '\0')) {
+        return 0;
+    }
+    for (i = 0; i < h->test_num; i++) {
+        e = &p->entries[i];
+        if (e->name >= h->names_len || !is_safe_name(p->names + e->name)) {
+            return 0;
+        }
+        for (j = 0; j < PACK_PARTS; j++) {
+            if (e->offsets[j] > p->size
+                    || e->lengths[j] > p->size - e->offsets[j]) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+Pack * pack_open(const char *path)
+{
+    struct stat info;
+    Pack *p;
+    void *map;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &info) < 0) {
+        fprintf(stderr, "Can not open pack '%s': %s\n", path,
+                strerror(errno));
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+    if ((size_t) info.st_size < sizeof(PackHeader)) {
+        fprintf(stderr, "File '%s' is not a pack\n", path);
+        close(fd);
+        return NULL;
+    }
+    map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Can not map pack '%s': %s\n", path,
+                strerror(errno));
+        return NULL;
+    }
+
+    p = calloc(1, sizeof(Pack));
+    p->refs = 1;
+    p->map = map;
+    p->size = info.st_size;
+    p->header = map;
+    p->entries = (const PackEntry *) (p->map + p->header->index_offset);
+    p->names = p->map + p->header->names_offset;
+    if (!pack_check(p)) {
+        fprintf(stderr, "File '%s' is not a valid pack\n", path);
+        munmap(p->map, p->size);
+        free(p);
+        return NULL;
+    }
+    /* Tests are mostly read in order. */
+    madvise(p->map, p->size, MADV_SEQUENTIAL);
+    return p;
+}
+
+Pack * pack_ref(Pack *p)
+{
+    p->refs++;
+    return p;
+}
+
+void pack_unref(Pack *p)
+{
+    if (p && --p->refs == 0) {
+        munmap(p->map, p->size);
+        free(p);
+    }
+}
+
+size_t pack_get_test_num(Pack *p)
+{
+    return p->header->test_num;
+}
+
+const char * pack_get_name(Pack *p, size_t i)
+{
+    return p->names + p->entries[i].name;
+}
+
+uint16_t pack_get_parts(Pack *p, size_t i)
+{
+    return p->entries[i].parts;
+}
+
+const char * pack_get_data(Pack *p, size_t i, unsigned int part, size_t *len)
+{
+    const PackEntry *e = &p->entries[i];
+
+    if (part >= PACK_PARTS || !(e->parts & (2 << part))) {
+        *len = 0;
+        return NULL;
+    }
+    *len = e->lengths[part];
+    return p->map + e->offsets[part];
+}
+
+struct pack_writer_t {
+    char *path;
+    char *tmp;
+    FILE *fh;
+    /** current offset in the file */
+    uint64_t offset;
+    PackEntry *entries;
+    size_t len;
+    size_t size;
+    char *names;
+    size_t names_len;
+    size_t names_size;
+};
+
+PackWriter * pack_writer_new(const char *path)
+{
+    PackHeader header;
+    PackWriter *w = calloc(1, sizeof(PackWriter));
+    int fd;
+
+    w->path = strdup(path);
+    w->tmp = malloc(strlen(path) + 8);
+    sprintf(w->tmp, "%s.XXXXXX", path);
+    if ((fd = mkstemp(w->tmp)) < 0 || (w->fh = fdopen(fd, "w")) == NULL) {
+        fprintf(stderr, "Can not create pack '%s': %s\n", path,
+                strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+            unlink(w->tmp);
+        }
+        free(w->tmp);
+        free(w->path);
+        free(w);
+        return NULL;
+    }
+    /* The header is written again when the index is known. */
+    memset(&header, 0, sizeof(PackHeader));
+    fwrite(&header, sizeof(PackHeader), 1, w->fh);
+    w->offset = sizeof(PackHeader);
+    return w;
+}
+
+void pack_writer_add_test(PackWriter *w, const char *name)
+{
+    size_t len = strlen(name) + 1;
+    PackEntry *e;
+
+    if (w->len == w->size) {
+        w->size = w->size ? 2 * w->size : 64;
+        w->entries = realloc(w->entries, w->size * sizeof(PackEntry));
+    }
+    e = &w->entries[w->len++];
+    memset(e, 0, sizeof(PackEntry));
+    e->name = w->names_len;
+
+    if (w->names_len + len > w->names_size) {
+        w->names_size = 2 * (w->names_len + len);
+        w->names = realloc(w->names, w->names_size);
+    }
+    memcpy(w->names + w->names_len, name, len);
+    w->names_len += len;
+}
+
+void pack_writer_add_part(PackWriter *w, unsigned int part,
+                          const char *data, size_t len)
+{
+    PackEntry *e = &w->entries[w->len - 1];
+
+    e->parts |= 2 << part;
+    e->offsets[part] = w->offset;
+    e->lengths[part] = len;
+    fwrite(data, 1, len, w->fh);
+    w->offset += len;
+}
+
+int pack_writer_finish(PackWriter *w)
+{
+    static const char padding[sizeof(uint64_t)];
+    PackHeader header;
+    struct stat info;
+    mode_t mask;
+    int ok;
+
+    memset(&header, 0, sizeof(PackHeader));
+    memcpy(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+    header.version = PACK_VERSION;
+    header.byte_order = PACK_BYTE_ORDER;
+    header.test_num = w->len;
+    /* The index is aligned, so that it can be used in the mapping. */
+    fwrite(padding, 1, -w->offset % sizeof(uint64_t), w->fh);
+    header.index_offset = w->offset + (-w->offset % sizeof(uint64_t));
+    header.names_offset = header.index_offset + w->len * sizeof(PackEntry);
+    header.names_len = w->names_len;
+
+    fwrite(w->entries, sizeof(PackEntry), w->len, w->fh);
+    fwrite(w->names, 1, w->names_len, w->fh);
+    ok = fseek(w->fh, 0, SEEK_SET) == 0
+         && fwrite(&header, sizeof(PackHeader), 1, w->fh) == 1
+         && fflush(w->fh) == 0;
+    /* The same mode and durability as with write_file(). */
+    if (ok && stat(w->path, &info) == 0) {
+        ok = fchmod(fileno(w->fh), info.st_mode & 07777) == 0;
+    } else if (ok) {
+        mask = umask(0);
+        umask(mask);
+        ok = fchmod(fileno(w->fh), 0666 & ~mask) == 0;
+    }
+    ok = ok && fsync(fileno(w->fh)) == 0;
+    ok = fclose(w->fh) == 0 && ok;
+    w->fh = NULL;
+    if (ok && rename(w->tmp, w->path) < 0) {
+        ok = 0;
+    }
+    if (!ok) {
+        fprintf(stderr, "Can not write pack '%s': %s\n", w->path,
+                strerror(errno));
+    } else {
+        /* Nothing is left to be removed. */
+        free(w->tmp);
+        w->tmp = NULL;
+    }
+    pack_writer_free(w);
+    return ok;
+}
+
+void pack_writer_free(PackWriter *w)
+{
+    if (w) {
+        if (w->fh) fclose(w->fh);
+        if (w->tmp) unlink(w->tmp);
+        free(w->tmp);
+        free(w->path);
+        free(w->entries);
+        free(w->names);
+    }
+    free(w);
+}
@@ -0,0 +1,143 @@
+#ifndef PACK_H
+#define PACK_H
+
+#include <config.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Packed suite stores all files of many tests in a single file, so that
+ * running them does not need to open thousands of small files. The file
+ * starts with a header, followed by contents of all test files, an index
+ * with one fixed size entry per test and names of the tests. The pack is
+ * mapped to memory and the contents are used in place.
+ *
+ * Numbers are stored in byte order of the machine that wrote the pack,
+ * packs are meant to be created where they are used, e.g. by gen-test
+ * --pack on checkout.
+ */
+typedef struct pack_t Pack;
+
+/**
+ * Number of file types a test in a pack can have, one for each extension.
+ * Part with index i corresponds to TestPart 2 << i.
+ */
+#define PACK_PARTS 9
+
+/**
+ * Map a pack to memory and check its index. On failure, error message is
+ * printed.
+ *
+ * @param path  file with the pack
+ * @return new pack with one reference or NULL on failure
+ */
+Pack * pack_open(const char *path);
+
+/**
+ * Add a reference to a pack.
+ *
+ * @param p     the pack
+ * @return the pack
+ */
+Pack * pack_ref(Pack *p);
+
+/**
+ * Drop a reference to a pack. The pack is unmapped when the last reference
+ * is dropped.
+ *
+ * @param p     the pack (allow-none)
+ */
+void pack_unref(Pack *p);
+
+/**
+ * Get number of tests in a pack.
+ *
+ * @param p     the pack
+ * @return number of tests
+ */
+size_t pack_get_test_num(Pack *p);
+
+/**
+ * Get name of a test.
+ *
+ * @param p     the pack
+ * @param i     index of the test
+ * @return name of the test (transfer none)
+ */
+const char * pack_get_name(Pack *p, size_t i);
+
+/**
+ * Get parts of a test as a mask of TestPart values.
+ *
+ * @param p     the pack
+ * @param i     index of the test
+ * @return mask of parts present
+ */
+uint16_t pack_get_parts(Pack *p, size_t i);
+
+/**
+ * Get content of a file of a test.
+ *
+ * @param p     the pack
+ * @param i     index of the test
+ * @param part  index of the part, from 0 to PACK_PARTS - 1
+ * @param len   where to store length of the content (out)
+ * @return content in the mapped pack (transfer none) or NULL if the test
+ *         does not have the part
+ */
+const char * pack_get_data(Pack *p, size_t i, unsigned int part, size_t *len);
+
+/**
+ * Writer of a new pack. Contents of files are written as they are added,
+ * only the index is kept in memory.
+ */
+typedef struct pack_writer_t PackWriter;
+
+/**
+ * Start writing a pack. The pack is written to a temporary file that
+ * replaces the target when pack_writer_finish() is called. On failure,
+ * error message is printed.
+ *
+ * @param path  where to create the pack
+ * @return new writer or NULL on failure
+ */
+PackWriter * pack_writer_new(const char *path);
+
+/**
+ * Start a new test in the pack. All its parts must be added before the next
+ * test is started.
+ *
+ * @param w     the writer
+ * @param name  name of the test
+ */
+void pack_writer_add_test(PackWriter *w, const char *name);
+
+/**
+ * Add file of the current test.
+ *
+ * @param w     the writer
+ * @param part  index of the part, from 0 to PACK_PARTS - 1
+ * @param data  content of the file
+ * @param len   length of the content
+ */
+void pack_writer_add_part(PackWriter *w, unsigned int part,
+                          const char *data, size_t len);
+
+/**
+ * Write the index and move the pack to its place. On failure, error message
+ * is printed. The writer is freed in any case.
+ *
+ * @param w     the writer
+ * @return 1 on success, 0 on failure
+ */
+int pack_writer_finish(PackWriter *w);
+
+/**
+ * Abandon the pack and remove the temporary file.
+ *
+ * @param w     the writer (allow-none)
+ */
+void pack_writer_free(PackWriter *w);
+
+#endif /* end of include guard: PACK_H */
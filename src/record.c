@@ -0,0 +1,388 @@
+#include <config.h>
+
+#include "capture.h"
+#include "genutils.h"
+#include "record.h"
+#include "test.h"
+#include "utils.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/**
+ * State of the program running on one input. Runs are finished in the order
+ * of inputs, so that the numbers of tests do not depend on which program
+ * exits first.
+ */
+typedef struct {
+    const char *input;
+    pid_t pid;
+    int status;
+    Capture *out;
+    Capture *err;
+    /** value of monotonic_time() when the program is killed, 0 if never */
+    double deadline;
+    /** the program could not be started */
+    int failed;
+    int timed_out;
+    int finished;
+} RecordRun;
+
+/**
+ * How often to check whether a program that closed its outputs exited, in
+ * milliseconds.
+ */
+#define WAIT_INTERVAL 10
+
+/**
+ * How many runs per job can be started after the first run that was not
+ * stored yet. Finished runs keep their output until they are stored, so a
+ * slow input must not let them pile up.
+ */
+#define RUNS_AHEAD 4
+
+static int
+compare_paths(const void *a, const void *b)
+{
+    return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+/**
+ * Check that a path leads to a regular file.
+ */
+static int
+is_regular(const char *path)
+{
+    struct stat info;
+
+    return stat(path, &info) == 0 && S_ISREG(info.st_mode);
+}
+
+char ** record_list_inputs(const char *spec, size_t *len)
+{
+    struct dirent *entry;
+    char **paths = NULL, *path;
+    size_t size = 0, i;
+    glob_t g;
+    DIR *dir;
+
+    *len = 0;
+    if ((dir = opendir(spec)) != NULL) {
+        while ((entry = readdir(dir)) != NULL) {
+            if (entry->d_name[0] == '.') continue;
+            path = str_printf("%s/%s", spec, entry->d_name);
+            if (!is_regular(path)) {
+                free(path);
+                continue;
+            }
+            if (*len + 1 >= size) {
+                size = size ? 2 * size : 64;
+                paths = realloc(paths, size * sizeof(char *));
+            }
+            paths[(*len)++] = path;
+        }
+        closedir(dir);
+        if (paths) {
+            qsort(paths, *len, sizeof(char *), compare_paths);
+            paths[*len] = NULL;
+        }
+        return paths;
+    }
+
+    if (glob(spec, 0, NULL, &g) != 0) {
+        return NULL;
+    }
+    paths = calloc(g.gl_pathc + 1, sizeof(char *));
+    for (i = 0; i < g.gl_pathc; i++) {
+        if (is_regular(g.gl_pathv[i])) {
+            paths[(*len)++] = strdup(g.gl_pathv[i]);
+        }
+    }
+    globfree(&g);
+    if (*len == 0) {
+        free(paths);
+        return NULL;
+    }
+    return paths;
+}
+
+char * record_test_name(int num, const char *input)
+{
+    const char *base = strrchr(input, '/');
+    char *name, *dot, *res, *s;
+
+    name = strdup(base ? base + 1 : input);
+    dot = strrchr(name, '.');
+    if (dot && dot != name) {
+        *dot = '\0';
+    }
+    /* Dots would be taken for an extension of the test file. */
+    for (s = name; *s; s++) {
+        if (*s == '.') *s = '_';
+    }
+    for (s = name; isspace((unsigned char) *s); s++)
+        ;
+    res = str_printf("%03d_%s", num,
+            *s ? sanitize_test_name(name) : "input");
+    free(name);
+    return res;
+}
+
+/**
+ * Launch the program on the input of a run. The program is looked up in PATH
+ * unless it contains a slash. If it can not be launched, the run is marked as
+ * failed and finished. With a time limit, the program gets its own process
+ * group, so that it can be killed with its children.
+ *
+ * @param run       run to be started
+ * @param argv      program and its arguments
+ * @param timeout   time limit in seconds, 0 for none
+ * @return 1 if the program is running, 0 otherwise
+ */
+static int
+record_start(RecordRun *run, char **argv, double timeout)
+{
+    /* The same environment stest runs programs in. */
+    static char * const env[] = { "MALLOC_CHECK_=2", NULL };
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    int in_fd, out_fd = -1, err_fd = -1, res;
+
+    in_fd = open(run->input, O_RDONLY | O_CLOEXEC);
+    if (in_fd < 0) {
+        res = errno;
+        goto fail;
+    }
+    run->out = capture_new(CAPTURE_MEMORY_LIMIT);
+    run->err = capture_new(CAPTURE_MEMORY_LIMIT);
+    if (run->out == NULL || run->err == NULL) {
+        res = errno;
+        close(in_fd);
+        goto fail;
+    }
+    out_fd = capture_take_write_fd(run->out);
+    err_fd = capture_take_write_fd(run->err);
+
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, in_fd, STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, out_fd, STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, err_fd, STDERR_FILENO);
+    posix_spawnattr_init(&attr);
+    if (timeout > 0) {
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+        posix_spawnattr_setpgroup(&attr, 0);
+    }
+    res = posix_spawnp(&run->pid, argv[0], &actions, &attr, argv, env);
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    close(in_fd);
+    close(out_fd);
+    close(err_fd);
+    if (res == 0) {
+        run->deadline = timeout > 0 ? monotonic_time() + timeout : 0;
+        return 1;
+    }
+
+fail:
+    fprintf(stderr, "Can not run '%s' on '%s': %s\n", argv[0], run->input,
+            strerror(res));
+    run->failed = 1;
+    run->finished = 1;
+    return 0;
+}
+
+/**
+ * Wait until some of the running programs finish or run out of time and
+ * collect their output. A program is waited for once both its outputs are
+ * closed. A program running past its deadline is killed with its process
+ * group without waiting for the outputs.
+ *
+ * @param runs  runs that are not reported yet
+ * @param len   number of the runs
+ * @return how many programs finished
+ */
+static size_t
+record_supervise(RecordRun *runs, size_t len)
+{
+    struct pollfd *fds;
+    size_t i, num = 0, finished = 0;
+    double left, now = monotonic_time();
+    int fd, wait_ms = -1, ms;
+    RecordRun *run;
+    pid_t pid;
+
+    fds = calloc(2 * len, sizeof(struct pollfd));
+    for (i = 0; i < len; i++) {
+        if (runs[i].finished) continue;
+        if ((fd = capture_get_read_fd(runs[i].out)) >= 0) {
+            fds[num].fd = fd;
+            fds[num++].events = POLLIN;
+        }
+        if ((fd = capture_get_read_fd(runs[i].err)) >= 0) {
+            fds[num].fd = fd;
+            fds[num++].events = POLLIN;
+        }
+        if (runs[i].deadline > 0) {
+            left = runs[i].deadline - now;
+            ms = left <= 0 ? 0 : left > INT_MAX / 1000 ? INT_MAX
+                                                       : left * 1000 + 1;
+            if (capture_get_read_fd(runs[i].out) < 0
+                    && capture_get_read_fd(runs[i].err) < 0
+                    && ms > WAIT_INTERVAL) {
+                ms = WAIT_INTERVAL;
+            }
+            if (wait_ms < 0 || ms < wait_ms) wait_ms = ms;
+        }
+    }
+    if ((num > 0 || wait_ms >= 0) && poll(fds, num, wait_ms) < 0
+            && errno != EINTR) {
+        perror("poll");
+        exit(EXIT_FAILURE);
+    }
+    free(fds);
+
+    now = monotonic_time();
+    for (i = 0; i < len; i++) {
+        run = &runs[i];
+        if (run->finished) continue;
+        if (capture_get_read_fd(run->out) >= 0) capture_read(run->out);
+        if (capture_get_read_fd(run->err) >= 0) capture_read(run->err);
+        if (run->deadline > 0 && now >= run->deadline && !run->timed_out) {
+            kill(-run->pid, SIGKILL);
+            run->timed_out = 1;
+            capture_close(run->out);
+            capture_close(run->err);
+        }
+        if (capture_get_read_fd(run->out) < 0
+                && capture_get_read_fd(run->err) < 0) {
+            /* A program with a deadline can keep running after closing
+             * its outputs, it is only polled for. */
+            while ((pid = waitpid(run->pid, &run->status,
+                                  run->timed_out || run->deadline == 0
+                                  ? 0 : WNOHANG)) < 0 && errno == EINTR)
+                ;
+            if (pid != 0) {
+                run->finished = 1;
+                finished++;
+            }
+        }
+    }
+    return finished;
+}
+
+/**
+ * Store a finished run as a new test.
+ *
+ * @param run   finished run that did not crash
+ * @param args  command line options of the program or NULL
+ * @param dir   directory for the test
+ * @param num   number of the test
+ * @return 1 on success, 0 on failure
+ */
+static int
+record_store(RecordRun *run, const char *args, const char *dir, int num)
+{
+    char *name = record_test_name(num, run->input), *input, *str;
+    const char *data;
+    size_t len;
+    int ok;
+
+    input = read_file(run->input, &len);
+    if (input == NULL) {
+        fprintf(stderr, "Can not read '%s': %s\n", run->input,
+                strerror(errno));
+        free(name);
+        return 0;
+    }
+    ok = write_test_file(dir, name, EXT_INPUT, input, len);
+    free(input);
+    data = capture_get_data(run->out, &len);
+    ok = ok && write_test_file(dir, name, EXT_OUTPUT, data, len);
+    data = capture_get_data(run->err, &len);
+    ok = ok && write_test_file(dir, name, EXT_ERRORS, data, len);
+    str = str_printf("%d\n", WEXITSTATUS(run->status));
+    ok = ok && write_test_file(dir, name, EXT_RETVAL, str, strlen(str));
+    free(str);
+    if (ok && args) {
+        str = str_printf("%s\n", args);
+        ok = write_test_file(dir, name, EXT_ARGS, str, strlen(str));
+        free(str);
+    }
+    free(name);
+    return ok;
+}
+
+int record_tests(const char *cmd, const char *args, char **inputs,
+                 size_t len, const char *dir, unsigned int jobs,
+                 double timeout)
+{
+    RecordRun *runs, *run;
+    char **argv, **parsed = NULL;
+    size_t count = 1, i, started = 0, reported = 0, running = 0;
+    int num, recorded = 0, ok = 1;
+
+    if (args && (parsed = parse_args(args, &count)) == NULL) {
+        fprintf(stderr, "Bad arguments '%s'\n", args);
+        return 0;
+    }
+    /* Arguments are counted with the terminating NULL. */
+    argv = calloc(count + 1, sizeof(char *));
+    argv[0] = (char *) cmd;
+    for (i = 0; parsed && parsed[i]; i++) {
+        argv[i + 1] = parsed[i];
+    }
+
+    /* Numbers are allocated once, the directory is not listed again. */
+    num = get_test_num(dir);
+    runs = calloc(len, sizeof(RecordRun));
+    for (i = 0; i < len; i++) {
+        runs[i].input = inputs[i];
+    }
+    while (reported < len) {
+        while (running < jobs && started < len
+                && started - reported < RUNS_AHEAD * jobs) {
+            running += record_start(&runs[started++], argv, timeout);
+        }
+        /* Tests are stored strictly in the order of inputs. */
+        while (reported < started && runs[reported].finished) {
+            run = &runs[reported++];
+            if (run->failed) {
+                ok = 0;
+            } else if (run->timed_out) {
+                fprintf(stderr, "Program killed on '%s' after time limit"
+                        " of %g seconds\n", run->input, timeout);
+                ok = 0;
+            } else if (!WIFEXITED(run->status)) {
+                fprintf(stderr, "Program crashed on '%s': %s\n", run->input,
+                        strsignal(WTERMSIG(run->status)));
+                ok = 0;
+            } else if (record_store(run, args, dir, ++num)) {
+                recorded++;
+            } else {
+                ok = 0;
+            }
+            capture_free(run->out);
+            capture_free(run->err);
+        }
+        if (running > 0) {
+            running -= record_supervise(runs + reported, started - reported);
+        }
+    }
+    free(runs);
+    free(argv);
+    str_array_free(parsed);
+
+    printf("Recorded %d tests in %s\n", recorded, dir);
+    return ok;
+}
@@ -0,0 +1,63 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <config.h>
+
+#include <stddef.h>
+
+/**
+ * Recording turns a collection of inputs into tests by running the program
+ * on each of them and storing what it did as the expected behaviour.
+ */
+
+/**
+ * Default time limit of a recorded program in seconds.
+ */
+#define RECORD_TIMEOUT 10
+
+/**
+ * Collect input files. A directory gives all regular files in it whose
+ * names do not start with a dot, anything else is expanded as a glob(7)
+ * pattern. Paths are sorted by name.
+ *
+ * @param spec  directory or pattern
+ * @param len   where to store number of paths (out)
+ * @return NULL-terminated array of paths (transfer full) or NULL if there
+ *         are no inputs
+ */
+char ** record_list_inputs(const char *spec, size_t *len);
+
+/**
+ * Make name of a test recorded from an input file. The name consists of
+ * the number and base name of the file without extension, sanitized the
+ * same way as names entered by user.
+ *
+ * @param num   number of the test
+ * @param input path to the input file
+ * @return name of the test (transfer full)
+ */
+char * record_test_name(int num, const char *input);
+
+/**
+ * Run a program on each input and store the results as new tests in a
+ * directory. Up to jobs programs run in parallel. The tests are numbered in
+ * the order of inputs after the tests already in the directory, each gets
+ * the input as .in file and stdout, stderr and exit code of the program as
+ * .out, .err and .ret files. Inputs on which the program crashes or runs
+ * out of time are skipped. On failure, error message is printed.
+ *
+ * @param cmd       program to run, looked up in PATH without a slash
+ * @param args      command line options passed to the program and stored in
+ *                  .args files (allow-none)
+ * @param inputs    paths to input files
+ * @param len       number of inputs
+ * @param dir       directory for the tests
+ * @param jobs      maximum number of programs running at the same time
+ * @param timeout   time limit of each program in seconds, 0 for none
+ * @return 1 if a test was recorded for each input, 0 otherwise
+ */
+int record_tests(const char *cmd, const char *args, char **inputs,
+                 size_t len, const char *dir, unsigned int jobs,
+                 double timeout);
+
+#endif /* end of include guard: RECORD_H */
@@ -0,0 +1,476 @@
+#include <config.h>
+
+#include "reporter.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void test_result_reset(TestResult *res, Test *test)
+{
+    test_result_clear(res);
+    res->test = test;
+    res->status = RESULT_PASSED;
+}
+
+CheckResult * test_result_add_check(TestResult *res, const char *name,
+                                    int passed, const char *message)
+{
+    CheckResult *check;
+    size_t len;
+
+    if (res->check_num == res->check_size) {
+        res->check_size = res->check_size ? 2 * res->check_size : 8;
+        res->checks = realloc(res->checks,
+                res->check_size * sizeof(CheckResult));
+    }
+    check = &res->checks[res->check_num++];
+    check->name = name;
+    check->passed = passed;
+    check->message = NULL;
+    check->diff_lines = -1;
+    if (message) {
+        /* Messages are formatted for terminal, drop the blank lines. */
+        len = strlen(message);
+        while (len > 0 && message[len - 1] == '\n') len--;
+        check->message = strndup(message, len);
+    }
+    if (!passed && res->status == RESULT_PASSED) {
+        res->status = RESULT_FAILED;
+    }
+    return check;
+}
+
+void test_result_clear(TestResult *res)
+{
+    size_t i;
+
+    for (i = 0; i < res->check_num; i++) {
+        free(res->checks[i].message);
+    }
+    free(res->checks);
+    free(res->reason);
+    memset(res, 0, sizeof(TestResult));
+}
+
+/**
+ * Functions implementing one output format.
+ */
+typedef struct {
+    const char *name;
+    void (*begin)(Reporter *r, size_t num_tests);
+    void (*add)(Reporter *r, const TestResult *res);
+    void (*end)(Reporter *r, double time);
+} ReporterFormat;
+
+struct reporter_t {
+    const ReporterFormat *format;
+    FILE *fh;
+    /** number of reported tests with each status */
+    unsigned int counts[RESULT_CACHED + 1];
+    /** number of all and failed checks of reported tests */
+    unsigned int checks;
+    unsigned int failed_checks;
+};
+
+static const char *status_names[] = {
+    "passed", "failed", "crashed", "timeout", "skipped", "cached"
+};
+
+/**
+ * Write string as JSON string literal including the quotes.
+ */
+static void
+print_json_string(FILE *fh, const char *str)
+{
+    const unsigned char *s = (const unsigned char *) str;
+
+    fputc('"', fh);
+    for (; *s; s++) {
+        switch (*s) {
+        case '"':  fputs("\\\"", fh); break;
+        case '\\': fputs("\\\\", fh); break;
+        case '\n': fputs("\\n", fh); break;
+        case '\t': fputs("\\t", fh); break;
+        default:
+            if (*s < 0x20) {
+                fprintf(fh, "\\u%04x", *s);
+            } else {
+                fputc(*s, fh);
+            }
+        }
+    }
+    fputc('"', fh);
+}
+
+/**
+ * Write string escaped for XML attribute value or text.
+ */
+static void
+print_xml_string(FILE *fh, const char *str)
+{
+    const unsigned char *s = (const unsigned char *) str;
+
+    for (; *s; s++) {
+        switch (*s) {
+        case '&':  fputs("&amp;", fh); break;
+        case '<':  fputs("&lt;", fh); break;
+        case '>':  fputs("&gt;", fh); break;
+        case '"':  fputs("&quot;", fh); break;
+        case '\n': fputs("&#10;", fh); break;
+        case '\t': fputs("&#9;", fh); break;
+        default:
+            /* Other control characters are not allowed in XML 1.0. */
+            fputc(*s < 0x20 ? '?' : *s, fh);
+        }
+    }
+}
+
+/**
+ * Get the first failed check of a result.
+ */
+static const CheckResult *
+first_failure(const TestResult *res)
+{
+    size_t i;
+
+    for (i = 0; i < res->check_num; i++) {
+        if (!res->checks[i].passed) return &res->checks[i];
+    }
+    return NULL;
+}
+
+static void
+junit_begin(Reporter *r, size_t num_tests)
+{
+    fprintf(r->fh, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+            "<testsuite name=\"stest\" tests=\"%zu\">\n", num_tests);
+}
+
+static void
+junit_add(Reporter *r, const TestResult *res)
+{
+    const CheckResult *failed;
+    size_t i;
+
+    fputs("  <testcase classname=\"stest\" name=\"", r->fh);
+    print_xml_string(r->fh, res->test->name);
+    fprintf(r->fh, "\" time=\"%.6f\">\n",
+            res->test->has_usage ? res->test->usage.wall : 0);
+
+    switch (res->status) {
+    case RESULT_SKIPPED:
+    case RESULT_CRASHED:
+    case RESULT_TIMED_OUT:
+        fprintf(r->fh, "    <%s type=\"%s\" message=\"",
+                res->status == RESULT_SKIPPED ? "skipped"
+                : res->status == RESULT_CRASHED ? "error" : "failure",
+                status_names[res->status]);
+        print_xml_string(r->fh, res->reason ? res->reason : "");
+        fputs("\"/>\n", r->fh);
+        break;
+    case RESULT_FAILED:
+        /* Only one failure is allowed, details of all go to its text. */
+        failed = first_failure(res);
+        fprintf(r->fh, "    <failure type=\"%s\" message=\"", failed->name);
+        print_xml_string(r->fh, failed->message ? failed->message : "");
+        fputs("\">", r->fh);
+        for (i = 0; i < res->check_num; i++) {
+            if (res->checks[i].passed) continue;
+            fprintf(r->fh, "%s: ", res->checks[i].name);
+            print_xml_string(r->fh, res->checks[i].message
+                                    ? res->checks[i].message : "failed");
+            if (res->checks[i].diff_lines >= 0) {
+                fprintf(r->fh, " (diff has %ld lines)",
+                        res->checks[i].diff_lines);
+            }
+            fputs("&#10;", r->fh);
+        }
+        fputs("</failure>\n", r->fh);
+        break;
+    case RESULT_CACHED:
+        fputs("    <system-out>cached</system-out>\n", r->fh);
+        break;
+    case RESULT_PASSED:
+        break;
+    }
+    fputs("  </testcase>\n", r->fh);
+}
+
+static void
+junit_end(Reporter *r, double time)
+{
+    fprintf(r->fh, "  <!-- %u failures, %u errors, %u skipped,"
+            " %.3f seconds -->\n</testsuite>\n",
+            r->counts[RESULT_FAILED] + r->counts[RESULT_TIMED_OUT],
+            r->counts[RESULT_CRASHED], r->counts[RESULT_SKIPPED], time);
+}
+
+static void
+tap_begin(Reporter *r, size_t num_tests)
+{
+    fprintf(r->fh, "TAP version 13\n1..%zu\n", num_tests);
+}
+
+static void
+tap_add(Reporter *r, const TestResult *res)
+{
+    unsigned int num = 0;
+    const CheckResult *c;
+    size_t i;
+
+    for (i = 0; i <= RESULT_CACHED; i++) {
+        num += r->counts[i];
+    }
+
+    fprintf(r->fh, "%s %u - %s",
+            res->status == RESULT_PASSED || res->status == RESULT_SKIPPED
+            || res->status == RESULT_CACHED ? "ok" : "not ok", num, res->test->name);
+    if (res->status == RESULT_SKIPPED) {
+        fprintf(r->fh, " # SKIP %s\n", res->reason ? res->reason : "");
+        return;
+    }
+
+    fprintf(r->fh, "\n  ---\n  status: %s\n", status_names[res->status]);
+    if (res->test->has_usage) {
+        fprintf(r->fh, "  duration_ms: %.3f\n", res->test->usage.wall * 1000);
+    }
+    if (res->reason) {
+        fputs("  reason: ", r->fh);
+        print_json_string(r->fh, res->reason);
+        fputc('\n', r->fh);
+    }
+    if (res->check_num > 0) {
+        fputs("  checks:\n", r->fh);
+    }
+    for (i = 0; i < res->check_num; i++) {
+        c = &res->checks[i];
+        fprintf(r->fh, "    - name: %s\n      passed: %s\n", c->name,
+                c->passed ? "true" : "false");
+        if (c->message) {
+            fputs("      message: ", r->fh);
+            print_json_string(r->fh, c->message);
+            fputc('\n', r->fh);
+        }
+        if (c->diff_lines >= 0) {
+            fprintf(r->fh, "      diff_lines: %ld\n", c->diff_lines);
+        }
+    }
+    fputs("  ...\n", r->fh);
+}
+
+static void
+tap_end(Reporter *r, double time)
+{
+    fprintf(r->fh, "# %.3f seconds\n", time);
+}
+
+static void
+jsonl_begin(Reporter *r, size_t num_tests)
+{
+    fprintf(r->fh, "{\"type\":\"start\",\"tests\":%zu}\n", num_tests);
+}
+
+static void
+jsonl_add(Reporter *r, const TestResult *res)
+{
+    const TestUsage *u = &res->test->usage;
+    const CheckResult *c;
+    size_t i;
+
+    fputs("{\"type\":\"test\",\"name\":", r->fh);
+    print_json_string(r->fh, res->test->name);
+    fprintf(r->fh, ",\"status\":\"%s\"", status_names[res->status]);
+    if (res->reason) {
+        fputs(",\"reason\":", r->fh);
+        print_json_string(r->fh, res->reason);
+    }
+    if (res->test->has_usage) {
+        fprintf(r->fh, ",\"wall\":%.6f,\"user\":%.6f,\"system\":%.6f,"
+                "\"max_rss\":%ld", u->wall, u->user, u->sys, u->max_rss);
+    }
+    fputs(",\"checks\":[", r->fh);
+    for (i = 0; i < res->check_num; i++) {
+        c = &res->checks[i];
+        fprintf(r->fh, "%s{\"name\":\"%s\",\"passed\":%s", i > 0 ? "," : "",
+                c->name, c->passed ? "true" : "false");
+        if (c->message) {
+            fputs(",\"message\":", r->fh);
+            print_json_string(r->fh, c->message);
+        }
+        if (c->diff_lines >= 0) {
+            fprintf(r->fh, ",\"diff_lines\":%ld", c->diff_lines);
+        }
+        fputc('}', r->fh);
+    }
+    fputs("]}\n", r->fh);
+}
+
+static void
+jsonl_end(Reporter *r, double time)
+{
+    fprintf(r->fh, "{\"type\":\"summary\",\"passed\":%u,\"failed\":%u,"
+            "\"crashed\":%u,\"timeout\":%u,\"skipped\":%u,\"cached\":%u,"
+            "\"checks\":%u,\"failed_checks\":%u,\"time\":%.3f}\n",
+            r->counts[RESULT_PASSED], r->counts[RESULT_FAILED],
+            r->counts[RESULT_CRASHED], r->counts[RESULT_TIMED_OUT],
+            r->counts[RESULT_SKIPPED], r->counts[RESULT_CACHED], r->checks,
+            r->failed_checks, time);
+}
+
+static const ReporterFormat formats[] = {
+    { "junit", junit_begin, junit_add, junit_end },
+    { "tap",   tap_begin,   tap_add,   tap_end },
+    { "jsonl", jsonl_begin, jsonl_add, jsonl_end },
+    { NULL, NULL, NULL, NULL }
+};
+
+Reporter * reporter_new(const char *spec)
+{
+    Reporter *r;
+    const char *colon = strchr(spec, ':');
+    size_t i, len = colon ? (size_t) (colon - spec) : strlen(spec);
+
+    for (i = 0; formats[i].name; i++) {
+        if (strlen(formats[i].name) == len
+                && strncmp(formats[i].name, spec, len) == 0) {
+            break;
+        }
+    }
+    if (formats[i].name == NULL || colon == NULL || colon[1] == '\0') {
+        fprintf(stderr, "Bad report '%s', expected junit, tap or jsonl"
+                " followed by colon and file name\n", spec);
+        return NULL;
+    }
+
+    r = calloc(1, sizeof(Reporter));
+    r->format = &formats[i];
+    if (strcmp(colon + 1, "-") == 0) {
+        r->fh = stdout;
+    } else {
+        r->fh = fopen(colon + 1, "w");
+        if (r->fh == NULL) {
+            fprintf(stderr, "Can not write report '%s': %s\n", colon + 1,
+                    strerror(errno));
+            free(r);
+            return NULL;
+        }
+    }
+    return r;
+}
+
+void reporter_begin(Reporter *r, size_t num_tests)
+{
+    r->format->begin(r, num_tests);
+    fflush(r->fh);
+}
+
+void reporter_add(Reporter *r, const TestResult *res)
+{
+    size_t i;
+
+    r->counts[res->status]++;
+    for (i = 0; i < res->check_num; i++) {
+        r->checks++;
+        r->failed_checks += !res->checks[i].passed;
+    }
+    r->format->add(r, res);
+    fflush(r->fh);
+}
+
+void reporter_end(Reporter *r, double time)
+{
+    r->format->end(r, time);
+    fflush(r->fh);
+}
+
+void reporter_free(Reporter *r)
+{
+    if (r && r->fh != stdout) {
+        fclose(r->fh);
+    }
+    free(r);
+}
+
+void report_summary_print(const ReportSummary *sum)
+{
+    printf("%u tests, %u crashes, %u timeouts, %u skipped, %u cached,"
+           " %u checks, %u failed (%.3f seconds)\n",
+            sum->tests, sum->crashed, sum->timed_out, sum->skipped,
+            sum->cached, sum->checks, sum->failed, sum->time);
+}
+
+/**
+ * Start of the last line of jsonl report.
+ */
+#define SUMMARY_PREFIX "{\"type\":\"summary\","
+
+/**
+ * Find numeric member of a flat JSON object written by jsonl_end().
+ */
+static int
+json_get_number(const char *obj, const char *key, double *value)
+{
+    char pattern[32];
+    const char *pos;
+    char *end;
+
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    pos = strstr(obj, pattern);
+    if (pos == NULL) {
+        return 0;
+    }
+    pos += strlen(pattern);
+    *value = strtod(pos, &end);
+    return end != pos;
+}
+
+int report_summary_merge(ReportSummary *sum, const char *path)
+{
+    static const char *keys[] = {
+        "passed", "failed", "crashed", "timeout", "skipped", "cached",
+        "checks", "failed_checks", "time"
+    };
+    double values[sizeof(keys) / sizeof(keys[0])];
+    char *line = NULL, *summary = NULL;
+    size_t line_size = 0, i;
+    FILE *fh;
+    int ok = 1;
+
+    fh = fopen(path, "r");
+    if (fh == NULL) {
+        fprintf(stderr, "Can not read report '%s': %s\n", path,
+                strerror(errno));
+        return 0;
+    }
+    while (getline(&line, &line_size, fh) >= 0) {
+        if (strncmp(line, SUMMARY_PREFIX, strlen(SUMMARY_PREFIX)) == 0) {
+            free(summary);
+            summary = strdup(line);
+        }
+    }
+    free(line);
+    fclose(fh);
+
+    for (i = 0; ok && i < sizeof(keys) / sizeof(keys[0]); i++) {
+        ok = summary != NULL && json_get_number(summary, keys[i], &values[i]);
+    }
+    free(summary);
+    if (!ok) {
+        fprintf(stderr, "File '%s' is not a complete jsonl report\n", path);
+        return 0;
+    }
+
+    sum->tests += values[0] + values[1] + values[2] + values[3];
+    sum->crashed += values[2];
+    sum->timed_out += values[3];
+    sum->skipped += values[4];
+    sum->cached += values[5];
+    sum->checks += values[6];
+    sum->failed += values[7];
+    if (values[8] > sum->time) {
+        sum->time = values[8];
+    }
+    return 1;
+}
@@ -0,0 +1,158 @@
+#ifndef REPORTER_H
+#define REPORTER_H
+
+#include <config.h>
+
+#include <stddef.h>
+
+#include "test.h"
+
+/**
+ * Overall outcome of a test.
+ */
+typedef enum {
+    RESULT_PASSED,
+    RESULT_FAILED,
+    RESULT_CRASHED,
+    RESULT_TIMED_OUT,
+    RESULT_SKIPPED,
+    /** passed in a previous run and was not run again */
+    RESULT_CACHED
+} ResultStatus;
+
+typedef struct check_result_t CheckResult;
+struct check_result_t {
+    /** extension of the checked file or other name of the check */
+    const char *name;
+    int passed;
+    /** description of the failure or NULL */
+    char *message;
+    /** number of lines of output diff, -1 if there is none */
+    long diff_lines;
+};
+
+/**
+ * Everything known about one finished test.
+ */
+typedef struct test_result_t TestResult;
+struct test_result_t {
+    Test *test;
+    ResultStatus status;
+    /** why the test was skipped, crashed or timed out, NULL otherwise */
+    char *reason;
+    CheckResult *checks;
+    size_t check_num;
+    size_t check_size;
+};
+
+/**
+ * Clear all data from a result and prepare it for another test.
+ *
+ * @param res   result to reset
+ * @param test  test the result belongs to
+ */
+void test_result_reset(TestResult *res, Test *test);
+
+/**
+ * Record result of a check. A failed check makes the whole test fail.
+ *
+ * @param res       test result
+ * @param name      name of the check, it is not copied
+ * @param passed    whether the check passed
+ * @param message   description of the failure (allow-none)
+ * @return the recorded check (transfer none)
+ */
+CheckResult * test_result_add_check(TestResult *res, const char *name,
+                                    int passed, const char *message);
+
+/**
+ * Free all data held by a result, but not the result itself.
+ *
+ * @param res   result to clear
+ */
+void test_result_clear(TestResult *res);
+
+/**
+ * Reporter writes results of tests in a machine readable format as soon as
+ * they are known.
+ */
+typedef struct reporter_t Reporter;
+
+/**
+ * Create reporter from a specification FORMAT:FILE, where FORMAT is one of
+ * junit, tap or jsonl and FILE is where to write the report. Dash means
+ * standard output. On failure, error message is printed.
+ *
+ * @param spec  format and file
+ * @return new reporter or NULL on failure
+ */
+Reporter * reporter_new(const char *spec);
+
+/**
+ * Start the report.
+ *
+ * @param r         reporter
+ * @param num_tests how many tests will be reported
+ */
+void reporter_begin(Reporter *r, size_t num_tests);
+
+/**
+ * Write result of one test and flush it to the file.
+ *
+ * @param r     reporter
+ * @param res   result of the test
+ */
+void reporter_add(Reporter *r, const TestResult *res);
+
+/**
+ * Finish the report.
+ *
+ * @param r     reporter
+ * @param time  total time in seconds
+ */
+void reporter_end(Reporter *r, double time);
+
+/**
+ * Close the file and free the reporter.
+ *
+ * @param r     reporter to be freed (allow-none)
+ */
+void reporter_free(Reporter *r);
+
+/**
+ * Totals of a whole run, as printed at its end.
+ */
+typedef struct report_summary_t ReportSummary;
+struct report_summary_t {
+    /** number of executed tests, that is without skipped and cached ones */
+    unsigned int tests;
+    unsigned int crashed;
+    unsigned int timed_out;
+    unsigned int skipped;
+    unsigned int cached;
+    unsigned int checks;
+    unsigned int failed;
+    /** time in seconds */
+    double time;
+};
+
+/**
+ * Print summary line to standard output.
+ *
+ * @param sum   summary to print
+ */
+void report_summary_print(const ReportSummary *sum);
+
+/**
+ * Add totals from a report written in jsonl format to a summary. Times of
+ * merged reports are not added, the longest one is used, as the reports are
+ * expected to come from runs executed at the same time. On failure, error
+ * message is printed.
+ *
+ * @param sum   summary to update
+ * @param path  file with the report
+ * @return 1 on success, 0 if the file is not a complete jsonl report
+ */
+int report_summary_merge(ReportSummary *sum, const char *path);
+
+#endif /* end of include guard: REPORTER_H */
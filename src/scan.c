@@ -0,0 +1,251 @@
+#include <config.h>
+
+#include "scan.h"
+
+#include <ctype.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define SCAN_X86 1
+#  include <immintrin.h>
+#endif
+
+/**
+ * Implementations of the kernels for one instruction set.
+ */
+typedef struct {
+    size_t (*count_newlines)(const char *buf, size_t len);
+    size_t (*first_difference)(const char *a, const char *b, size_t len);
+} ScanKernels;
+
+static size_t
+count_newlines_scalar(const char *buf, size_t len)
+{
+    size_t i, num = 0;
+
+    for (i = 0; i < len; i++) {
+        num += buf[i] == '\n';
+    }
+    return num;
+}
+
+static size_t
+first_difference_scalar(const char *a, const char *b, size_t len)
+{
+    uint64_t x, y;
+    size_t i = 0;
+
+    /* Equal words are skipped, the difference is then found bytewise. */
+    while (len - i >= sizeof(uint64_t)) {
+        memcpy(&x, a + i, sizeof(uint64_t));
+        memcpy(&y, b + i, sizeof(uint64_t));
+        if (x != y) break;
+        i += sizeof(uint64_t);
+    }
+    while (i < len && a[i] == b[i]) {
+        i++;
+    }
+    return i;
+}
+
+#ifdef SCAN_X86
+
+/*
+ * Newlines are counted in byte counters, which are summed before they can
+ * overflow after 255 blocks.
+ */
+
+__attribute__((target("sse2")))
+static size_t
+count_newlines_sse2(const char *buf, size_t len)
+{
+    const __m128i nl = _mm_set1_epi8('\n'), zero = _mm_setzero_si128();
+    __m128i acc, sum;
+    size_t i = 0, j, num = 0;
+
+    while (len - i >= 16) {
+        acc = zero;
+        for (j = 0; j < 255 && len - i >= 16; j++, i += 16) {
+            acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(nl,
+                        _mm_loadu_si128((const __m128i *) (buf + i))));
+        }
+        sum = _mm_sad_epu8(acc, zero);
+        num += _mm_cvtsi128_si32(sum) + _mm_extract_epi16(sum, 4);
+    }
+    return num + count_newlines_scalar(buf + i, len - i);
+}
+
+__attribute__((target("sse2")))
+static size_t
+first_difference_sse2(const char *a, const char *b, size_t len)
+{
+    unsigned int mask;
+    size_t i;
+
+    for (i = 0; len - i >= 16; i += 16) {
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(
+                    _mm_loadu_si128((const __m128i *) (a + i)),
+                    _mm_loadu_si128((const __m128i *) (b + i))));
+        if (mask != 0xffff) {
+            return i + __builtin_ctz(~mask);
+        }
+    }
+    return i + first_difference_scalar(a + i, b + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static size_t
+count_newlines_avx2(const char *buf, size_t len)
+{
+    const __m256i nl = _mm256_set1_epi8('\n'), zero = _mm256_setzero_si256();
+    __m256i acc;
+    uint64_t sum[4];
+    size_t i = 0, j, num = 0;
+
+    while (len - i >= 32) {
+        acc = zero;
+        for (j = 0; j < 255 && len - i >= 32; j++, i += 32) {
+            acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(nl,
+                        _mm256_loadu_si256((const __m256i *) (buf + i))));
+        }
+        _mm256_storeu_si256((__m256i *) sum, _mm256_sad_epu8(acc, zero));
+        num += sum[0] + sum[1] + sum[2] + sum[3];
+    }
+    return num + count_newlines_sse2(buf + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static size_t
+first_difference_avx2(const char *a, const char *b, size_t len)
+{
+    __m256i eq0, eq1;
+    unsigned int mask;
+    size_t i;
+
+    /* Two vectors at a time, the difference is searched for only once
+     * the block does not match. */
+    for (i = 0; len - i >= 64; i += 64) {
+        eq0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (a + i)),
+                _mm256_loadu_si256((const __m256i *) (b + i)));
+        eq1 = _mm256_cmpeq_epi8(
+                _mm256_loadu_si256((const __m256i *) (a + i + 32)),
+                _mm256_loadu_si256((const __m256i *) (b + i + 32)));
+        if ((unsigned int) _mm256_movemask_epi8(_mm256_and_si256(eq0, eq1))
+                != 0xffffffffu) {
+            break;
+        }
+    }
+    for (; len - i >= 32; i += 32) {
+        mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+                    _mm256_loadu_si256((const __m256i *) (a + i)),
+                    _mm256_loadu_si256((const __m256i *) (b + i))));
+        if (mask != 0xffffffffu) {
+            return i + __builtin_ctz(~mask);
+        }
+    }
+    return i + first_difference_sse2(a + i, b + i, len - i);
+}
+
+#endif /* SCAN_X86 */
+
+static const ScanKernels kernels[SCAN_LEVELS] = {
+    { count_newlines_scalar, first_difference_scalar },
+#ifdef SCAN_X86
+    { count_newlines_sse2, first_difference_sse2 },
+    { count_newlines_avx2, first_difference_avx2 },
+#endif
+};
+
+static const char *level_names[SCAN_LEVELS] = { "scalar", "sse2", "avx2" };
+
+/** kernels in use, NULL until the first one is called */
+static const ScanKernels *current;
+static ScanLevel current_level;
+
+/**
+ * Check whether the processor supports an instruction set.
+ */
+static int
+scan_supported(ScanLevel level)
+{
+    switch (level) {
+    case SCAN_SCALAR:
+        return 1;
+#ifdef SCAN_X86
+    case SCAN_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case SCAN_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return 0;
+    }
+}
+
+static const ScanKernels *
+scan_kernels(void)
+{
+    int level;
+
+    if (current == NULL) {
+        for (level = SCAN_LEVELS - 1; !scan_supported(level); level--)
+            ;
+        current_level = level;
+        current = &kernels[level];
+    }
+    return current;
+}
+
+ScanLevel scan_get_level(void)
+{
+    scan_kernels();
+    return current_level;
+}
+
+int scan_set_level(ScanLevel level)
+{
+    if (level >= SCAN_LEVELS || !scan_supported(level)) {
+        return 0;
+    }
+    current_level = level;
+    current = &kernels[level];
+    return 1;
+}
+
+const char * scan_level_name(ScanLevel level)
+{
+    return level < SCAN_LEVELS ? level_names[level] : "unknown";
+}
+
+size_t scan_count_newlines(const char *buf, size_t len)
+{
+    return scan_kernels()->count_newlines(buf, len);
+}
+
+size_t scan_first_difference(const char *a, const char *b, size_t len)
+{
+    return scan_kernels()->first_difference(a, b, len);
+}
+
+int scan_equal_ignoring_space(const char *a, size_t alen,
+                              const char *b, size_t blen)
+{
+    const ScanKernels *k = scan_kernels();
+    size_t i = 0, j = 0, n;
+
+    while (1) {
+        n = k->first_difference(a + i, b + j,
+                alen - i < blen - j ? alen - i : blen - j);
+        i += n;
+        j += n;
+        while (i < alen && isspace((unsigned char) a[i])) i++;
+        while (j < blen && isspace((unsigned char) b[j])) j++;
+        if (i == alen || j == blen) {
+            return i == alen && j == blen;
+        }
+        if (a[i] != b[j]) {
+            return 0;
+        }
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <config.h>
+
+#include <stddef.h>
+
+/**
+ * Kernels scanning large buffers, such as outputs of tested programs. Each
+ * kernel has a portable scalar version and on x86 also SSE2 and AVX2
+ * versions. The best version supported by the processor is selected when a
+ * kernel is first used.
+ */
+
+/**
+ * Instruction set used by the kernels.
+ */
+typedef enum {
+    SCAN_SCALAR,
+    SCAN_SSE2,
+    SCAN_AVX2,
+    SCAN_LEVELS
+} ScanLevel;
+
+/**
+ * Get instruction set used by the kernels.
+ *
+ * @return the level
+ */
+ScanLevel scan_get_level(void);
+
+/**
+ * Force the kernels to use given instruction set. This is meant for tests
+ * and benchmarks.
+ *
+ * @param level     the level
+ * @return 1 on success, 0 if the processor or compiler does not support it
+ */
+int scan_set_level(ScanLevel level);
+
+/**
+ * Get human readable name of an instruction set.
+ *
+ * @param level     the level
+ * @return the name
+ */
+const char * scan_level_name(ScanLevel level);
+
+/**
+ * Count newline characters in a buffer.
+ *
+ * @param buf   the buffer
+ * @param len   length of the buffer
+ * @return number of newlines
+ */
+size_t scan_count_newlines(const char *buf, size_t len);
+
+/**
+ * Find the first byte where two buffers of the same length differ.
+ *
+ * @param a     first buffer
+ * @param b     second buffer
+ * @param len   length of both buffers
+ * @return offset of the first different byte or len if they are equal
+ */
+size_t scan_first_difference(const char *a, const char *b, size_t len);
+
+/**
+ * Compare two buffers ignoring all white space, as isspace(3) defines it.
+ * Equal parts are skipped by scan_first_difference(), white space is only
+ * looked at where the buffers differ.
+ *
+ * @param a     first buffer
+ * @param alen  length of the first buffer
+ * @param b     second buffer
+ * @param blen  length of the second buffer
+ * @return 1 if the buffers are equal, 0 otherwise
+ */
+int scan_equal_ignoring_space(const char *a, size_t alen,
+                              const char *b, size_t blen);
+
+#endif /* end of include guard: SCAN_H */
@@ -0,0 +1,133 @@
+#include <config.h>
+
+#include "stats.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int
+compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+double stats_percentile(const double *samples, size_t len, double p)
+{
+    double pos = (len - 1) * p / 100;
+    size_t i = pos;
+
+    if (i + 1 >= len) {
+        return samples[len - 1];
+    }
+    return samples[i] + (pos - i) * (samples[i + 1] - samples[i]);
+}
+
+size_t stats_drop_outliers(double *samples, size_t len)
+{
+    double q1, q3, low, high;
+    size_t first = 0, last = len;
+
+    qsort(samples, len, sizeof(double), compare_doubles);
+    if (len < 4) {
+        return len;
+    }
+
+    q1 = stats_percentile(samples, len, 25);
+    q3 = stats_percentile(samples, len, 75);
+    low = q1 - 1.5 * (q3 - q1);
+    high = q3 + 1.5 * (q3 - q1);
+    while (first < last && samples[first] < low) first++;
+    while (last > first && samples[last - 1] > high) last--;
+
+    memmove(samples, samples + first, (last - first) * sizeof(double));
+    return last - first;
+}
+
+/**
+ * Sample tagged with the set it comes from.
+ */
+typedef struct {
+    double value;
+    int first;
+} RankedSample;
+
+static int
+compare_ranked(const void *a, const void *b)
+{
+    return compare_doubles(&((const RankedSample *) a)->value,
+                           &((const RankedSample *) b)->value);
+}
+
+double stats_mann_whitney(const double *a, size_t alen,
+                          const double *b, size_t blen)
+{
+    RankedSample *all;
+    size_t i, j, k, n = alen + blen;
+    double rank, rank_sum = 0, ties = 0, t, u, mu, sigma, z;
+
+    if (alen == 0 || blen == 0) {
+        return 1;
+    }
+
+    all = malloc(n * sizeof(RankedSample));
+    for (i = 0; i < alen; i++) {
+        all[i].value = a[i];
+        all[i].first = 1;
+    }
+    for (i = 0; i < blen; i++) {
+        all[alen + i].value = b[i];
+        all[alen + i].first = 0;
+    }
+    qsort(all, n, sizeof(RankedSample), compare_ranked);
+
+    /* Samples i..j-1 are tied and share the average of ranks i+1..j. */
+    for (i = 0; i < n; i = j) {
+        for (j = i + 1; j < n && all[j].value == all[i].value; j++)
+            ;
+        rank = (i + 1 + j) / 2.0;
+        t = j - i;
+        ties += t * t * t - t;
+        for (k = i; k < j; k++) {
+            if (all[k].first) rank_sum += rank;
+        }
+    }
+    free(all);
+
+    u = rank_sum - alen * (alen + 1) / 2.0;
+    mu = alen * blen / 2.0;
+    sigma = sqrt(alen * blen / 12.0 * ((n + 1) - ties / ((double) n * (n - 1))));
+    if (sigma == 0) {
+        return 1;
+    }
+    z = (fabs(u - mu) - 0.5) / sigma;
+    if (z < 0) {
+        z = 0;
+    }
+    return erfc(z / sqrt(2));
+}
+
+void stats_compute(double *samples, size_t len, Stats *st)
+{
+    double sum = 0, sq = 0;
+    size_t i;
+
+    memset(st, 0, sizeof(Stats));
+    st->n = stats_drop_outliers(samples, len);
+    if (st->n == 0) {
+        return;
+    }
+
+    for (i = 0; i < st->n; i++) {
+        sum += samples[i];
+    }
+    st->mean = sum / st->n;
+    for (i = 0; i < st->n; i++) {
+        sq += (samples[i] - st->mean) * (samples[i] - st->mean);
+    }
+    st->stddev = st->n > 1 ? sqrt(sq / (st->n - 1)) : 0;
+    st->min = samples[0];
+    st->median = stats_percentile(samples, st->n, 50);
+    st->p95 = stats_percentile(samples, st->n, 95);
+}
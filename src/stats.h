@@ -0,0 +1,71 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <config.h>
+
+#include <stddef.h>
+
+/**
+ * Summary of a set of measurements.
+ */
+typedef struct stats_t Stats;
+struct stats_t {
+    /** number of samples left after discarding outliers */
+    size_t n;
+    double min;
+    double median;
+    double mean;
+    /** 95th percentile */
+    double p95;
+    /** sample standard deviation */
+    double stddev;
+};
+
+/**
+ * Compute percentile of sorted samples. Values between samples are linearly
+ * interpolated.
+ *
+ * @param samples   sorted array of samples
+ * @param len       number of samples, must be positive
+ * @param p         requested percentile between 0 and 100
+ * @return value of the percentile
+ */
+double stats_percentile(const double *samples, size_t len, double p);
+
+/**
+ * Sort samples and drop outliers. A sample is an outlier if it lies more than
+ * 1.5 interquartile ranges outside of the quartiles. With less than four
+ * samples nothing is dropped.
+ *
+ * @param samples   array of samples, it is sorted in place
+ * @param len       number of samples
+ * @return number of samples left at the start of the array
+ */
+size_t stats_drop_outliers(double *samples, size_t len);
+
+/**
+ * Compute summary of samples. Outliers are dropped first, the samples are
+ * reordered in the process.
+ *
+ * @param samples   array of samples
+ * @param len       number of samples
+ * @param st        where to store the summary (out)
+ */
+void stats_compute(double *samples, size_t len, Stats *st);
+
+/**
+ * Compare two sets of samples with Mann-Whitney U test. Ties get average
+ * rank and the normal approximation with continuity correction is used, so
+ * the result is only meaningful for at least a few samples in each set.
+ *
+ * @param a     first set of samples
+ * @param alen  number of samples in the first set
+ * @param b     second set of samples
+ * @param blen  number of samples in the second set
+ * @return two-sided p-value of the hypothesis that both sets come from the
+ *         same distribution
+ */
+double stats_mann_whitney(const double *a, size_t alen,
+                          const double *b, size_t blen);
+
+#endif /* end of include guard: STATS_H */
@@ -1,56 +1,206 @@
 #include <config.h>
 
+#include "cache.h"
+#include "history.h"
 #include "list.h"
+#include "manifest.h"
+#include "reporter.h"
 #include "test.h"
 #include "testcontext.h"
 #include "utils.h"
 
 #include <errno.h>
 #include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
 
-#define OPTSTRING "hmvqV"
+#define OPTSTRING "hj:m::t:vqV"
+#define OPTSUMMARY "hjmtvqV"
+
+/**
+ * Values returned by getopt_long() for options without short form.
+ */
+enum {
+    OPT_TOP = 256,
+    OPT_BENCH,
+    OPT_WARMUP,
+    OPT_SAVE_BASELINE,
+    OPT_COMPARE_BASELINE,
+    OPT_THRESHOLD,
+    OPT_REPORT,
+    OPT_NO_CACHE,
+    OPT_ORDER,
+    OPT_BUDGET,
+    OPT_SHARD,
+    OPT_SHARD_BY,
+    OPT_SHARD_TIMINGS,
+    OPT_MERGE_REPORTS,
+    OPT_VALGRIND,
+    OPT_VALGRIND_FLAGS,
+    OPT_STREAM,
+    OPT_OUTPUT_LIMIT,
+    OPT_UPDATE
+};
 
 static void usage(const char *progname)
 {
-    printf("Usage: %s [%s] COMMAND [TESTDIR]\n", progname, OPTSTRING);
+    printf("Usage: %s [%s] COMMAND [TESTDIR]\n", progname, OPTSUMMARY);
+    printf("       %s --merge-reports FILE...\n", progname);
 }
 
 static void help(void)
 {
     puts("SYNOPSIS");
-    puts("\tstest ["OPTSTRING"] COMMAND [TESTDIR]");
+    puts("\tstest ["OPTSUMMARY"] COMMAND [TESTDIR]");
+    puts("\tstest --merge-reports FILE...");
 
     puts("\nOPTIONS");
-    puts("\t    --diff=OPTIONS\n\t\tpass OPTIONS to diff; see man diff(1)"
-           " for available options\n");
+    puts("\t    --bench=N\n\t\trun each test N times and print statistics"
+           " of\n\t\twall clock and CPU time instead of results,"
+           " one\n\t\ttest at a time\n");
+    puts("\t    --budget=SECONDS\n\t\trun only tests expected to finish"
+           " within SECONDS,\n\t\trecently failed and changed tests"
+           " first\n");
+    puts("\t    --compare-baseline=FILE\n\t\tin benchmark mode, fail tests"
+           " that got slower than\n\t\tin baseline FILE\n");
+    puts("\t    --diff=OPTIONS\n\t\tcompare outputs as diff(1) would with"
+           " OPTIONS;\n\t\tsupported are -i, -b, -w, -Z, -U NUM and"
+           " --strip-trailing-cr\n");
     puts("\t-h, --help\n\t\tdisplay this help\n");
-    puts("\t-m, --memory\n\t\trun Valgrind memory checking tool\n");
-    puts("\t-v, --verbose\n\t\tdisplay output diff of failed tests\n");
+    puts("\t-j, --jobs=N\n\t\trun up to N tests at the same time\n");
+    puts("\t    --merge-reports\n\t\tprint summary of jsonl reports"
+           " given instead of\n\t\tCOMMAND, e.g. of all shards\n");
+    puts("\t-m, --memory[=CHECKER]\n\t\tcheck memory errors with CHECKER,"
+           " which is valgrind\n\t\t(default) or asan for programs built"
+           " with\n\t\t-fsanitize=address or undefined\n");
+    puts("\t    --no-cache\n\t\trun all tests, even those that passed"
+           " before with\n\t\tthe same program and test files\n");
+    puts("\t    --order=ORDER\n\t\trun tests in ORDER, which is"
+           " failed-first,\n\t\tslowest-first or fastest-first\n");
+    puts("\t    --output-limit=SIZE\n\t\tkill tests writing more than SIZE"
+           " bytes to stdout\n\t\tor stderr, SIZE can end with K, M or"
+           " G, 0 means\n\t\tno limit, default is 1G\n");
+    puts("\t    --report=FORMAT:FILE\n\t\twrite results to FILE as they"
+           " come, FORMAT is\n\t\tjunit, tap or jsonl, FILE can be - for"
+           " stdout\n");
+    puts("\t    --save-baseline=FILE\n\t\tin benchmark mode, save measured"
+           " times to FILE\n");
+    puts("\t    --shard=I/N\n\t\trun only I-th of N parts of the"
+           " tests\n");
+    puts("\t    --shard-by=MODE\n\t\thow to split tests to shards,"
+           " MODE is round-robin,\n\t\tname or duration\n");
+    puts("\t    --shard-timings=FILE\n\t\ttake durations for"
+           " --shard-by=duration from\n\t\thistory FILE, required"
+           " by that mode\n");
+    puts("\t    --stream\n\t\tcompare output while the program runs and"
+           " kill it\n\t\tat the first difference\n");
+    puts("\t-t, --timeout=SECONDS\n\t\tkill tests running longer than"
+           " SECONDS\n");
+    puts("\t    --threshold=PERCENT\n\t\thow much slower than baseline"
+           " a test may get,\n\t\tdefault is 5\n");
+    puts("\t    --top=N\n\t\tlist N slowest and N most memory hungry"
+           " tests\n");
+    puts("\t    --update\n\t\twrite actual outputs and exit codes as the"
+           " expected\n\t\tones\n");
+    puts("\t    --valgrind=PATH\n\t\twith -m, run Valgrind from PATH\n");
+    puts("\t    --valgrind-flags=OPTIONS\n\t\twith -m, pass OPTIONS to"
+           " Valgrind instead of\n\t\t--tool=memcheck --leak-check=full\n");
+    puts("\t    --warmup=K\n\t\tin benchmark mode, run each test K more"
+           " times\n\t\twithout measuring\n");
+    puts("\t-v, --verbose\n\t\tdisplay output diff of failed tests and"
+           " resources\n\t\tused by each test\n");
     puts("\t-q, --quiet\n\t\tsuppress all output\n");
     puts("\t-V, --version\n\t\tdisplay version info\n");
-    puts("\tIf TESTDIR is not specified, use ./tests directory.");
+    puts("\tIf TESTDIR is not specified, use ./tests directory. TESTDIR can"
+         " also be\n\ta pack created by gen-test --pack.");
 
     puts("\nRETURN VALUE");
     puts("\tOn success of all tests return 0, otherwise exit with number of");
     puts("\tfailed tests. If options are bad, other return values are possible:");
     puts("\t253\tbad command name");
-    puts("\t254\tbad directory with tests");
+    puts("\t254\tbad directory with tests or bad report");
     puts("\t255\tunrecognized options");
 }
 
+/**
+ * Print summary of reports written by --report=jsonl:FILE.
+ *
+ * @param files     paths to the reports
+ * @param len       number of reports
+ * @return number of failed checks or 254 if some report can not be read
+ */
+static int merge_reports(char **files, int len)
+{
+    ReportSummary sum = { 0 };
+    int i;
+
+    for (i = 0; i < len; i++) {
+        if (!report_summary_merge(&sum, files[i])) {
+            return 254;
+        }
+    }
+    report_summary_print(&sum);
+    return sum.failed;
+}
+
 int main(int argc, char *argv[])
 {
     char *dir = "tests";
     unsigned int failed_checks;
 
-    char c;
+    int c;
+    char *end;
+    long jobs = 1, top, bench = 0, warmup = 0;
+    MemoryChecker memory = MEMORY_NONE;
+    double timeout, threshold, budget = 0;
+    long long output_limit;
+    int baseline = 0;
+    int use_cache = 1;
+    int update = 0;
+    char *cache_path, *history_path, *timings_path = NULL;
+    struct stat info;
+    int packed;
+    const char *state_format;
+    char *state_suffix;
+    char *manifest_path, *state_dir;
+    Manifest *manifest = NULL;
+    long shard = 0, shards = 0;
+    ShardMode shard_by = SHARD_ROUND_ROBIN;
+    int merge = 0;
+    History *timings;
+    int quiet = 0;
+    HistoryOrder order = ORDER_DEFAULT;
+    History *history;
 
     TestContext *tc;
-    List *tests;
+    List *tests, *rest;
+    size_t total;
 
     static const struct option long_options[] = {
+        { "bench",   required_argument, NULL, OPT_BENCH },
+        { "budget",  required_argument, NULL, OPT_BUDGET },
+        { "compare-baseline", required_argument, NULL, OPT_COMPARE_BASELINE },
         { "diff",    required_argument, NULL, 'd' },
-        { "memory",  no_argument,       NULL, 'm' },
+        { "jobs",    required_argument, NULL, 'j' },
+        { "memory",  optional_argument, NULL, 'm' },
+        { "merge-reports", no_argument, NULL, OPT_MERGE_REPORTS },
+        { "no-cache", no_argument,      NULL, OPT_NO_CACHE },
+        { "order",   required_argument, NULL, OPT_ORDER },
+        { "output-limit", required_argument, NULL, OPT_OUTPUT_LIMIT },
+        { "report",  required_argument, NULL, OPT_REPORT },
+        { "save-baseline", required_argument, NULL, OPT_SAVE_BASELINE },
+        { "shard",   required_argument, NULL, OPT_SHARD },
+        { "shard-by", required_argument, NULL, OPT_SHARD_BY },
+        { "shard-timings", required_argument, NULL, OPT_SHARD_TIMINGS },
+        { "stream",  no_argument,       NULL, OPT_STREAM },
+        { "threshold", required_argument, NULL, OPT_THRESHOLD },
+        { "timeout", required_argument, NULL, 't' },
+        { "top",     required_argument, NULL, OPT_TOP },
+        { "update",  no_argument,       NULL, OPT_UPDATE },
+        { "valgrind", required_argument, NULL, OPT_VALGRIND },
+        { "valgrind-flags", required_argument, NULL, OPT_VALGRIND_FLAGS },
+        { "warmup",  required_argument, NULL, OPT_WARMUP },
         { "verbose", no_argument,       NULL, 'v' },
         { "quiet",   no_argument,       NULL, 'q' },
         { "help",    no_argument,       NULL, 'h' },
@@ -70,19 +220,180 @@ int main(int argc, char *argv[])
             help();
             return 0;
         case 'm':
-            test_context_set_use_valgrind(tc);
+            if (optarg == NULL || strcmp(optarg, "valgrind") == 0) {
+                memory = MEMORY_VALGRIND;
+            } else if (strcmp(optarg, "asan") == 0) {
+                memory = MEMORY_ASAN;
+            } else {
+                fprintf(stderr, "Bad memory checker '%s'\n", optarg);
+                usage(argv[0]);
+                return 255;
+            }
+            test_context_set_memory_checker(tc, memory);
             break;
         case 'v':
             test_context_set_verbosity(tc, MODE_VERBOSE);
+            quiet = 0;
             break;
         case 'q':
             test_context_set_verbosity(tc, MODE_QUIET);
+            quiet = 1;
             break;
         case 'V':
             printf("%s %s\n", PACKAGE_NAME, VERSION);
             return 0;
         case 'd':
-            test_context_set_diff_opts(tc, optarg);
+            if (!test_context_set_diff_opts(tc, optarg)) {
+                usage(argv[0]);
+                return 255;
+            }
+            break;
+        case 'j':
+            jobs = strtol(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0' || jobs < 1) {
+                fprintf(stderr, "Bad number of jobs '%s'\n", optarg);
+                usage(argv[0]);
+                return 255;
+            }
+            test_context_set_jobs(tc, jobs);
+            break;
+        case 't':
+            timeout = strtod(optarg, &end);
+            if (*optarg == '\0' || *end != '\0' || !(timeout > 0)) {
+                fprintf(stderr, "Bad time limit '%s'\n", optarg);
+                usage(argv[0]);
+                return 255;
+            }
+            test_context_set_timeout(tc, timeout);
+            break;
+        case OPT_TOP:
+            top = strtol(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0' || top < 0) {
+                fprintf(stderr, "Bad number of tests '%s'\n", optarg);
+                usage(argv[0]);
+                return 255;
+            }
+            test_context_set_top(tc, top);
+            break;
+        case OPT_BENCH:
+            bench = strtol(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0' || bench < 1) {
+                fprintf(stderr, "Bad number of runs '%s'\n", optarg);
+                usage(argv[0]);
+                return 255;
+            }
+            break;
+        case OPT_WARMUP:
+            warmup = strtol(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0' || warmup < 0) {
+                fprintf(stderr, "Bad number of runs '%s'\n", optarg);
+                usage(argv[0]);
+                return 255;
+            }
+            break;
+        case OPT_SAVE_BASELINE:
+            test_context_set_save_baseline(tc, optarg);
+            baseline = 1;
+            break;
+        case OPT_COMPARE_BASELINE:
+            if (!test_context_set_compare_baseline(tc, optarg)) {
+                return 255;
+            }
+            baseline = 1;
+            break;
+        case OPT_REPORT:
+            if (!test_context_add_reporter(tc, optarg)) {
+                usage(argv[0]);
+                return 255;
+            }
+            break;
+        case OPT_NO_CACHE:
+            use_cache = 0;
+            break;
+        case OPT_ORDER:
+            if (strcmp(optarg, "failed-first") == 0) {
+                order = ORDER_FAILED_FIRST;
+            } else if (strcmp(optarg, "slowest-first") == 0) {
+                order = ORDER_SLOWEST_FIRST;
+            } else if (strcmp(optarg, "fastest-first") == 0) {
+                order = ORDER_FASTEST_FIRST;
+            } else {
+                fprintf(stderr, "Bad order '%s'\n", optarg);
+                usage(argv[0]);
+                return 255;
+            }
+            break;
+        case OPT_BUDGET:
+            budget = strtod(optarg, &end);
+            if (*optarg == '\0' || *end != '\0' || !(budget > 0)) {
+                fprintf(stderr, "Bad time budget '%s'\n", optarg);
+                usage(argv[0]);
+                return 255;
+            }
+            break;
+        case OPT_SHARD:
+            shard = strtol(optarg, &end, 10);
+            if (end != optarg && *end == '/') {
+                shards = strtol(end + 1, &end, 10);
+            }
+            if (*end != '\0' || shards < 1 || shard < 1 || shard > shards) {
+                fprintf(stderr, "Bad shard '%s'\n", optarg);
+                usage(argv[0]);
+                return 255;
+            }
+            break;
+        case OPT_SHARD_BY:
+            if (strcmp(optarg, "round-robin") == 0) {
+                shard_by = SHARD_ROUND_ROBIN;
+            } else if (strcmp(optarg, "name") == 0) {
+                shard_by = SHARD_BY_NAME;
+            } else if (strcmp(optarg, "duration") == 0) {
+                shard_by = SHARD_BY_DURATION;
+            } else {
+                fprintf(stderr, "Bad shard mode '%s'\n", optarg);
+                usage(argv[0]);
+                return 255;
+            }
+            break;
+        case OPT_SHARD_TIMINGS:
+            timings_path = optarg;
+            break;
+        case OPT_MERGE_REPORTS:
+            merge = 1;
+            break;
+        case OPT_OUTPUT_LIMIT:
+            output_limit = parse_size(optarg);
+            if (output_limit < 0) {
+                fprintf(stderr, "Bad output limit '%s'\n", optarg);
+                usage(argv[0]);
+                return 255;
+            }
+            test_context_set_output_limit(tc, output_limit);
+            break;
+        case OPT_STREAM:
+            test_context_set_stream(tc, 1);
+            break;
+        case OPT_UPDATE:
+            update = 1;
+            test_context_set_update(tc, 1);
+            break;
+        case OPT_VALGRIND:
+            test_context_set_valgrind(tc, optarg);
+            break;
+        case OPT_VALGRIND_FLAGS:
+            if (!test_context_set_valgrind_flags(tc, optarg)) {
+                usage(argv[0]);
+                return 255;
+            }
+            break;
+        case OPT_THRESHOLD:
+            threshold = strtod(optarg, &end);
+            if (*optarg == '\0' || *end != '\0' || !(threshold >= 0)) {
+                fprintf(stderr, "Bad threshold '%s'\n", optarg);
+                usage(argv[0]);
+                return 255;
+            }
+            test_context_set_threshold(tc, threshold);
             break;
         default:
             usage(argv[0]);
@@ -90,6 +401,35 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (bench > 0 && memory != MEMORY_NONE) {
+        fprintf(stderr, "Benchmark can not be run with memory checker\n");
+        usage(argv[0]);
+        return 255;
+    }
+    /* Memory checkers can add their reports to stderr. */
+    if (update && memory != MEMORY_NONE) {
+        fprintf(stderr, "Outputs can not be updated with memory checker\n");
+        usage(argv[0]);
+        return 255;
+    }
+    if (shards > 0 && shard_by == SHARD_BY_DURATION
+            && timings_path == NULL) {
+        fprintf(stderr, "Durations of shards need --shard-timings,"
+                " splitting tests by name\n");
+        shard_by = SHARD_BY_NAME;
+    }
+    if (baseline && bench == 0) {
+        fprintf(stderr, "Baseline can only be used with --bench\n");
+        usage(argv[0]);
+        return 255;
+    }
+    test_context_set_bench(tc, bench, warmup);
+
+    if (merge) {
+        test_context_free(tc);
+        return merge_reports(argv + optind, argc - optind);
+    }
+
     if (optind >= argc) {
         fprintf(stderr, "Missing command name\n");
         return 253;
@@ -103,20 +443,95 @@ int main(int argc, char *argv[])
         dir = argv[optind];
     }
 
-    tests = test_load_from_dir(dir);
+    /* A regular file is a packed suite, its state files lie next to it. */
+    packed = stat(dir, &info) == 0 && S_ISREG(info.st_mode);
+    if (packed) {
+        tests = test_load_from_pack(dir);
+        state_format = "%s.stest-%s%s";
+    } else {
+        state_format = "%s/" STATE_DIR "/%s%s";
+        manifest_path = str_printf(state_format, dir, MANIFEST_FILE, "");
+        manifest = manifest_load(manifest_path);
+        free(manifest_path);
+        tests = test_load_with_manifest(dir, manifest);
+    }
     if (tests == NULL) {
-        fprintf(stderr, "No tests loaded from directory '%s'", dir);
+        fprintf(stderr, "No tests loaded from %s '%s'",
+                packed ? "pack" : "directory", dir);
         if (errno == 0) {
             fprintf(stderr, "\n");
         } else {
             perror("");
         }
+        manifest_free(manifest);
         return 254;
     }
+    if (packed && update) {
+        fprintf(stderr, "Tests in pack '%s' can not be updated\n", dir);
+        list_destroy(tests, DESTROYFUNC(test_free));
+        return 254;
+    }
+    /* Writing state files to TEST_DIR itself would modify it and its
+     * listing in the manifest could not be used on the next run. */
+    if (!packed) {
+        state_dir = str_printf("%s/%s", dir, STATE_DIR);
+        if (mkdir(state_dir, 0777) != 0 && errno != EEXIST) {
+            fprintf(stderr, "Can not create directory '%s': %s\n",
+                    state_dir, strerror(errno));
+        }
+        free(state_dir);
+    }
+
+    /* Shards can run at the same time, each keeps its own cache and
+     * history, e.g. .stest/cache.2-of-4. */
+    state_suffix = shards > 0 ? str_printf(".%ld-of-%ld", shard, shards)
+                              : strdup("");
+    /* Benchmarks are meant to run the tests. */
+    if (use_cache && bench == 0) {
+        cache_path = str_printf(state_format, dir, CACHE_FILE, state_suffix);
+        test_context_set_cache(tc, cache_path);
+        free(cache_path);
+    }
+
+    history_path = str_printf(state_format, dir, HISTORY_FILE, state_suffix);
+    history = history_load(history_path);
+    free(history_path);
+    free(state_suffix);
+    if (shards > 0) {
+        /* All shards must see the same durations, so they are only taken
+         * from a file that does not change while the shards run. */
+        timings = shard_by == SHARD_BY_DURATION
+            ? history_load(timings_path) : NULL;
+        tests = history_shard(timings, tests, shard - 1, shards, shard_by,
+                &rest);
+        list_destroy(rest, DESTROYFUNC(test_free));
+        history_free(timings);
+    }
+    if (budget > 0) {
+        total = list_length(tests);
+        if (!history_has_durations(history)) {
+            fprintf(stderr, "No test durations are known yet, assuming"
+                    " %.1f seconds per test\n", HISTORY_DEFAULT_WALL);
+        }
+        /* Tests running in parallel share the budget. */
+        tests = history_select(history, tests, budget * jobs, &rest);
+        if (!quiet) {
+            printf("Running %zu of %zu tests within %g seconds\n",
+                    list_length(tests), total, budget);
+        }
+        list_destroy(rest, DESTROYFUNC(test_free));
+    }
+    tests = history_order(history, tests, order);
+    test_context_set_history(tc, history);
 
     failed_checks = test_context_run_tests(tc, tests);
     list_destroy(tests, DESTROYFUNC(test_free));
     test_context_free(tc);
+    /* Arguments and exit codes were added while the tests ran. */
+    if (manifest != NULL) {
+        manifest_save(manifest);
+        manifest_free(manifest);
+    }
 
     return failed_checks;
 }
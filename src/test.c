@@ -1,50 +1,447 @@
 #include <config.h>
 
+#include "cache.h"
+#include "manifest.h"
+#include "pack.h"
 #include "test.h"
 #include "utils.h"
 
+#include <ctype.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
-List * test_load_from_dir(const char *dir)
-{
-    struct dirent **entries;
-    int i, files_num;
-    List *tests = NULL;
-    Test *test;
-    char *dot;
+/**
+ * Size of the buffer for directory entries read by one system call.
+ */
+#define DIRENT_BUFFER (256 * 1024)
+
+#if HAVE_DECL_SYS_GETDENTS64
+/**
+ * Directory entry as returned by getdents64(2).
+ */
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+#endif
+
+/**
+ * Test or subdirectory found in a directory.
+ */
+typedef struct {
+    /** file name up to the first dot, or name of the subdirectory */
+    char *name;
+    /** number at the start of the name, parsed once for sorting */
+    unsigned long long key;
+    uint16_t parts;
+    int is_dir;
+} ScanEntry;
+
+/**
+ * Slot of the hash table of tests. The hash is kept in the table, so that
+ * entries of other tests are rarely touched while probing.
+ */
+typedef struct {
+    uint64_t hash;
+    /** index of the entry plus one, 0 if the slot is free */
+    size_t index;
+} ScanSlot;
+
+/**
+ * Entries of one directory. Files are grouped to tests by a hash table on
+ * their names, so that the entries can come in any order.
+ */
+typedef struct {
+    ScanEntry *entries;
     size_t len;
+    size_t size;
+    /** open addressing table with size being a power of two */
+    ScanSlot *table;
+    size_t table_size;
+} Scan;
+
+static unsigned long long
+parse_sort_key(const char *name)
+{
+    unsigned long long key = 0;
+
+    while (isdigit((unsigned char) *name)) {
+        key = 10 * key + (*name++ - '0');
+    }
+    return key;
+}
+
+static ScanEntry *
+scan_append(Scan *s, const char *name, size_t len, int is_dir)
+{
+    ScanEntry *e;
+
+    if (s->len == s->size) {
+        s->size = s->size ? 2 * s->size : 64;
+        s->entries = realloc(s->entries, s->size * sizeof(ScanEntry));
+    }
+    e = &s->entries[s->len++];
+    e->name = strndup(name, len);
+    e->key = parse_sort_key(name);
+    e->parts = 0;
+    e->is_dir = is_dir;
+    return e;
+}
+
+/**
+ * Find slot of the test of given name or a free slot where it belongs.
+ */
+static ScanSlot *
+scan_slot(Scan *s, uint64_t hash, const char *name, size_t len)
+{
+    size_t mask = s->table_size - 1;
+    size_t i = hash & mask;
+    ScanSlot *slot;
+    ScanEntry *e;
+
+    while ((slot = &s->table[i])->index != 0) {
+        if (slot->hash == hash && name) {
+            e = &s->entries[slot->index - 1];
+            if (strncmp(e->name, name, len) == 0 && e->name[len] == '\0') {
+                break;
+            }
+        }
+        i = (i + 1) & mask;
+    }
+    return slot;
+}
+
+/**
+ * Find test of the given name or add a new one.
+ */
+static ScanEntry *
+scan_get_test(Scan *s, const char *name, size_t len)
+{
+    uint64_t hash = cache_hash(CACHE_HASH_INIT, name, len);
+    ScanSlot *old = s->table, *slot;
+    size_t i, old_size = s->table_size;
+
+    if (2 * (s->len + 1) > s->table_size) {
+        s->table_size = s->table_size ? 2 * s->table_size : 256;
+        s->table = calloc(s->table_size, sizeof(ScanSlot));
+        for (i = 0; i < old_size; i++) {
+            if (old[i].index != 0) {
+                /* All names in the table differ, only a free slot is
+                 * looked for. */
+                *scan_slot(s, old[i].hash, NULL, 0) = old[i];
+            }
+        }
+        free(old);
+    }
+    slot = scan_slot(s, hash, name, len);
+    if (slot->index == 0) {
+        scan_append(s, name, len, 0);
+        slot->hash = hash;
+        slot->index = s->len;
+    }
+    return &s->entries[slot->index - 1];
+}
+
+/**
+ * Add a directory entry. Only names starting with a digit are considered.
+ * Symbolic links and entries of unknown type are classified by what they
+ * point to, so a link to a directory is a group too.
+ */
+static void
+scan_add(Scan *s, int dir_fd, const char *name, unsigned char type)
+{
+    struct stat info;
+    const char *dot;
     TestPart tp;
 
-    files_num = scandir(dir, &entries, filter_tests_wrap, number_sort_wrap);
-    if (files_num <= 0) return NULL;
+    if (!filter_tests(name)) {
+        return;
+    }
+    if (type == DT_UNKNOWN || type == DT_LNK) {
+        if (fstatat(dir_fd, name, &info, 0) != 0) {
+            return;
+        }
+        type = S_ISDIR(info.st_mode) ? DT_DIR : DT_REG;
+    }
+    if (type == DT_DIR) {
+        scan_append(s, name, strlen(name), 1);
+        return;
+    }
+
+    dot = strchr(name, '.');
+    if (dot == NULL) {
+        return;
+    }
+    tp = get_test_part(name);
+    scan_get_test(s, name, dot - name)->parts |= tp != TEST_UNKNOWN ? tp : 0;
+}
+
+/**
+ * Read all entries of a directory.
+ *
+ * @return 1 on success, 0 on failure with errno set
+ */
+static int
+scan_read(Scan *s, int fd)
+{
+#if HAVE_DECL_SYS_GETDENTS64
+    char *buffer = malloc(DIRENT_BUFFER);
+    struct linux_dirent64 *ent;
+    long n, pos;
+
+    while ((n = syscall(SYS_getdents64, fd, buffer, DIRENT_BUFFER)) > 0) {
+        for (pos = 0; pos < n; pos += ent->d_reclen) {
+            ent = (struct linux_dirent64 *) (buffer + pos);
+            scan_add(s, fd, ent->d_name, ent->d_type);
+        }
+    }
+    free(buffer);
+    return n == 0;
+#else
+    DIR *d;
+    struct dirent *ent;
+    int dup_fd = dup(fd);
+
+    if (dup_fd < 0 || (d = fdopendir(dup_fd)) == NULL) {
+        if (dup_fd >= 0) close(dup_fd);
+        return 0;
+    }
+    errno = 0;
+    while ((ent = readdir(d)) != NULL) {
+        scan_add(s, fd, ent->d_name, ent->d_type);
+        errno = 0;
+    }
+    closedir(d);
+    return errno == 0;
+#endif
+}
+
+static int
+compare_entries(const void *a, const void *b)
+{
+    const ScanEntry *e1 = a, *e2 = b;
+
+    if (e1->key != e2->key) {
+        return e1->key < e2->key ? -1 : 1;
+    }
+    return strcmp(e1->name, e2->name);
+}
+
+/**
+ * List a directory or take its listing from the manifest. Entries are
+ * sorted by their numbers.
+ *
+ * @param s         where to store the entries
+ * @param fd        open directory
+ * @param path      path of the directory relative to top directory
+ * @param manifest  manifest to use and update (allow-none)
+ * @param res       where to store 1 on success, 0 on failure with errno set
+ * @return entries of the directory in the manifest, in the same order as
+ *         in 's', or NULL if there is no manifest
+ */
+static ManifestEntry *
+scan_dir(Scan *s, int fd, const char *path, Manifest *manifest, int *res)
+{
+    ManifestEntry *entries;
+    struct stat info;
+    size_t i, len;
 
-    for (i = 0; i < files_num;) {
-        dot = strchr(entries[i]->d_name, '.');
-        if (dot == NULL) {
-            free(entries[i]);
+    *res = 1;
+    if (manifest == NULL || fstat(fd, &info) != 0) {
+        manifest = NULL;
+    } else if ((entries = manifest_get_dir(manifest, path, &info, &len))) {
+        for (i = 0; i < len; i++) {
+            scan_append(s, entries[i].name, strlen(entries[i].name),
+                    entries[i].is_dir)->parts = entries[i].parts;
+        }
+        return entries;
+    }
+
+    if (!(*res = scan_read(s, fd))) {
+        return NULL;
+    }
+    qsort(s->entries, s->len, sizeof(ScanEntry), compare_entries);
+    if (manifest == NULL) {
+        return NULL;
+    }
+    entries = calloc(s->len, sizeof(ManifestEntry));
+    for (i = 0; i < s->len; i++) {
+        entries[i].name = strdup(s->entries[i].name);
+        entries[i].parts = s->entries[i].parts;
+        entries[i].is_dir = s->entries[i].is_dir;
+    }
+    manifest_set_dir(manifest, path, &info, entries, s->len);
+    return entries;
+}
+
+/**
+ * Directory being loaded, linked to the directories containing it.
+ */
+typedef struct load_dir_t LoadDir;
+struct load_dir_t {
+    dev_t dev;
+    ino_t ino;
+    const LoadDir *parent;
+};
+
+/**
+ * Check whether a directory is being loaded already, which happens when a
+ * symbolic link points to a directory containing it.
+ */
+static int
+is_loading(const LoadDir *dirs, int fd)
+{
+    struct stat info;
+
+    if (fstat(fd, &info) != 0) {
+        return 0;
+    }
+    for (; dirs; dirs = dirs->parent) {
+        if (dirs->dev == info.st_dev && dirs->ino == info.st_ino) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Load tests from a directory and its subdirectories in the order of their
+ * numbers. Tests in a subdirectory are named by its path relative to the
+ * top directory and take its place in the order. Subdirectories that would
+ * make a cycle are skipped.
+ *
+ * @param fd        open directory
+ * @param parent    directories containing this one (allow-none)
+ * @param prefix    path of the directory relative to top directory or NULL
+ * @param dir       top directory shared by all tests
+ * @param dir_refs  reference count of dir
+ * @param manifest  manifest with listings of directories (allow-none)
+ * @param tests     list to prepend the tests to
+ * @return 1 on success, 0 on failure with errno set
+ */
+static int
+load_tests(int fd, const LoadDir *parent, const char *prefix, char *dir,
+           unsigned int *dir_refs, Manifest *manifest, List **tests)
+{
+    LoadDir self = { 0, 0, parent };
+    struct stat info;
+    Scan s;
+    ScanEntry *e;
+    ManifestEntry *entries;
+    Test *test;
+    char *name;
+    size_t i;
+    int sub_fd, res;
+
+    if (fstat(fd, &info) == 0) {
+        self.dev = info.st_dev;
+        self.ino = info.st_ino;
+    }
+    memset(&s, 0, sizeof(Scan));
+    entries = scan_dir(&s, fd, prefix ? prefix : ".", manifest, &res);
+
+    for (i = 0; i < s.len; i++) {
+        e = &s.entries[i];
+        if (!res) {
+            free(e->name);
             continue;
         }
-        test = malloc(sizeof(Test));
-        test->dir = strdup(dir);
-        test->parts = 0;
-        len = dot - entries[i]->d_name;
-        test->name = calloc(len + 1, sizeof(char));
-        strncpy(test->name, entries[i]->d_name, len);
-
-        while (i < files_num && strncmp(test->name, entries[i]->d_name, len) == 0) {
-            tp = get_test_part(entries[i]->d_name);
-            if (tp != TEST_UNKNOWN) {
-                test->parts |= tp;
+        name = prefix ? str_printf("%s/%s", prefix, e->name) : e->name;
+        if (e->is_dir) {
+            sub_fd = openat(fd, e->name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            res = sub_fd >= 0 && (is_loading(&self, sub_fd)
+                    || load_tests(sub_fd, &self, name, dir, dir_refs,
+                                  manifest, tests));
+            if (sub_fd >= 0) close(sub_fd);
+            free(name);
+        } else {
+            test = calloc(1, sizeof(Test));
+            test->name = name;
+            test->dir = dir;
+            test->dir_refs = dir_refs;
+            test->parts = e->parts;
+            if (entries != NULL) {
+                test->manifest = manifest;
+                test->manifest_entry = &entries[i];
             }
-            free(entries[i]);
-            i++;
+            (*dir_refs)++;
+            *tests = list_prepend(*tests, test);
+        }
+        if (name != e->name) {
+            free(e->name);
         }
+    }
 
-        tests = list_prepend(tests, test);
+    free(s.entries);
+    free(s.table);
+    return res;
+}
+
+List * test_load_from_dir(const char *dir)
+{
+    return test_load_with_manifest(dir, NULL);
+}
+
+List * test_load_with_manifest(const char *dir, Manifest *manifest)
+{
+    List *tests = NULL;
+    unsigned int *dir_refs;
+    char *shared_dir;
+    int fd, res, err;
+
+    fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+
+    shared_dir = strdup(dir);
+    dir_refs = malloc(sizeof(unsigned int));
+    /* The reference held during loading is dropped below. */
+    *dir_refs = 1;
+    res = load_tests(fd, NULL, NULL, shared_dir, dir_refs, manifest, &tests);
+    err = errno;
+    close(fd);
+
+    if (!res) {
+        list_destroy(tests, DESTROYFUNC(test_free));
+        tests = NULL;
+    }
+    if (--*dir_refs == 0) {
+        free(shared_dir);
+        free(dir_refs);
     }
+    errno = res ? 0 : err;
+    return list_reverse(tests);
+}
 
-    free(entries);
+List * test_load_from_pack(const char *path)
+{
+    List *tests = NULL;
+    Test *test;
+    Pack *pack;
+    size_t i, len;
+
+    errno = 0;
+    if ((pack = pack_open(path)) == NULL) {
+        /* The error was already reported. */
+        return NULL;
+    }
+    len = pack_get_test_num(pack);
+    for (i = 0; i < len; i++) {
+        test = calloc(1, sizeof(Test));
+        test->name = strdup(pack_get_name(pack, i));
+        test->parts = pack_get_parts(pack, i);
+        test->pack = pack_ref(pack);
+        test->pack_index = i;
+        tests = list_prepend(tests, test);
+    }
+    pack_unref(pack);
     return list_reverse(tests);
 }
 
@@ -52,16 +449,130 @@ void test_free(Test *test)
 {
     if (test) {
         free(test->name);
-        free(test->dir);
+        if (test->dir_refs == NULL) {
+            free(test->dir);
+        } else if (--*test->dir_refs == 0) {
+            free(test->dir);
+            free(test->dir_refs);
+        }
+        pack_unref(test->pack);
         free(test);
     }
 }
 
+/**
+ * Files of a test in the order of parts in a pack.
+ */
+static const struct {
+    TestPart part;
+    const char *ext;
+} parts[PACK_PARTS] = {
+    { TEST_INPUT, EXT_INPUT }, { TEST_OUTPUT, EXT_OUTPUT },
+    { TEST_ARGS, EXT_ARGS }, { TEST_ERRORS, EXT_ERRORS },
+    { TEST_RETVAL, EXT_RETVAL }, { TEST_TIMEOUT, EXT_TIMEOUT },
+    { TEST_TIME, EXT_TIME }, { TEST_RSS, EXT_RSS },
+    { TEST_OUTPUT_LIMIT, EXT_OUTPUT_LIMIT }
+};
+
+const char * test_get_part_ext(unsigned int part)
+{
+    return part < PACK_PARTS ? parts[part].ext : NULL;
+}
+
+static unsigned int
+part_index(const char *ext)
+{
+    unsigned int i;
+
+    for (i = 0; i < PACK_PARTS && strcmp(parts[i].ext, ext) != 0; i++)
+        ;
+    return i;
+}
+
+/**
+ * Open file of a test for reading. Files of packed tests are read directly
+ * from the mapped pack.
+ *
+ * @param test  test
+ * @param ext   extension of the file
+ * @return open file or NULL on failure
+ */
+static FILE *
+test_open_file(Test *test, const char *ext)
+{
+    const char *data;
+    char *path;
+    size_t len;
+    FILE *fh;
+
+    if (test->pack) {
+        data = pack_get_data(test->pack, test->pack_index, part_index(ext),
+                &len);
+        if (data == NULL) {
+            return NULL;
+        }
+        /* Empty buffer can not be opened, the terminating zero is read
+         * as end of file. */
+        return len > 0 ? fmemopen((void *) data, len, "r")
+                       : fmemopen((void *) "", 1, "r");
+    }
+    path = get_filepath(test->dir, test->name, ext);
+    fh = fopen(path, "r");
+    free(path);
+    return fh;
+}
+
+/**
+ * Create a file in memory with given content, which can be passed to a
+ * program as its input. Unlike a pipe, it does not need anybody to write
+ * the data while the program runs. The returned descriptor is positioned at
+ * the start of the file.
+ *
+ * @param data  content of the file
+ * @param len   length of the content
+ * @return file descriptor or -1 on failure
+ */
+static int
+open_memory_file(const char *data, size_t len)
+{
+#if HAVE_MEMFD_CREATE
+    int fd = memfd_create("stest-input", MFD_CLOEXEC);
+#else
+    char path[] = "/tmp/stest-input-XXXXXX";
+    int fd = mkstemp(path);
+
+    if (fd >= 0) unlink(path);
+#endif
+    ssize_t n;
+
+    while (fd >= 0 && len > 0) {
+        n = write(fd, data, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            close(fd);
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    if (fd >= 0 && lseek(fd, 0, SEEK_SET) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
 int test_get_input_fd(Test *test)
 {
+    const char *data;
+    size_t len;
     int fd;
     if (!FLAG_SET(test->parts, TEST_INPUT)) {
         fd = open("/dev/null", O_RDONLY);
+    } else if (test->pack) {
+        data = pack_get_data(test->pack, test->pack_index,
+                part_index(EXT_INPUT), &len);
+        fd = open_memory_file(data, len);
     } else {
         char *input_file = get_filepath(test->dir, test->name, EXT_INPUT);
         fd = open(input_file, O_RDONLY);
@@ -70,11 +581,49 @@ int test_get_input_fd(Test *test)
     return fd;
 }
 
+/**
+ * Get status of a file of a test loaded with a manifest, so that the
+ * content recorded in the manifest can be validated.
+ *
+ * @return 1 on success, 0 if the test has no manifest or the file can not
+ *         be checked
+ */
+static int
+test_stat_file(Test *test, const char *ext, struct stat *info)
+{
+    char *path;
+    int res;
+
+    if (test->manifest_entry == NULL) {
+        return 0;
+    }
+    path = get_filepath(test->dir, test->name, ext);
+    res = stat(path, info) == 0;
+    free(path);
+    return res;
+}
+
+static char **
+copy_args(char **args, size_t count)
+{
+    char **copy = malloc(count * sizeof(char *));
+    size_t i;
+
+    for (i = 0; i + 1 < count; i++) {
+        copy[i] = strdup(args[i]);
+    }
+    copy[count - 1] = NULL;
+    return copy;
+}
+
 char ** test_get_args(Test *test, size_t *count)
 {
+    ManifestEntry *e = test->manifest_entry;
     char **args = NULL;
+    struct stat info;
+    int cached;
     FILE *fh;
-    char *path, *line = NULL;
+    char *line = NULL;
     size_t len = 0;
     ssize_t read;
 
@@ -85,8 +634,13 @@ char ** test_get_args(Test *test, size_t *count)
         return args;
     }
 
-    path = get_filepath(test->dir, test->name, EXT_ARGS);
-    fh = fopen(path, "r");
+    cached = test_stat_file(test, EXT_ARGS, &info);
+    if (cached && e->args && manifest_stamp_matches(&e->args_stamp, &info)) {
+        *count = e->arg_count;
+        return copy_args(e->args, e->arg_count);
+    }
+
+    fh = test_open_file(test, EXT_ARGS);
     if (fh == NULL) {
         perror("Can not open arguments file");
         goto out1;
@@ -97,32 +651,221 @@ char ** test_get_args(Test *test, size_t *count)
         goto out2;
     }
     args = parse_args(line, count);
+    if (cached && args) {
+        str_array_free(e->args);
+        e->args = copy_args(args, *count);
+        e->arg_count = *count;
+        manifest_stamp_set(test->manifest, &e->args_stamp, &info);
+    }
 
     free(line);
 out2:
     fclose(fh);
 out1:
-    free(path);
     return args;
 }
 
 int test_get_exit_code(Test *test)
 {
+    ManifestEntry *e = test->manifest_entry;
+    struct stat info;
+    int cached;
     FILE *fh;
     int code = -1;
-    char *path;
 
-    path = get_filepath(test->dir, test->name, EXT_RETVAL);
-    fh = fopen(path, "r");
+    cached = test_stat_file(test, EXT_RETVAL, &info);
+    if (cached && manifest_stamp_matches(&e->ret_stamp, &info)) {
+        return e->exit_code;
+    }
+
+    fh = test_open_file(test, EXT_RETVAL);
     if (fh == NULL) goto out;
     fscanf(fh, " %d", &code);
     fclose(fh);
+    if (cached && code >= 0) {
+        e->exit_code = code;
+        manifest_stamp_set(test->manifest, &e->ret_stamp, &info);
+    }
 out:
-    free(path);
     return code;
 }
 
+double test_get_timeout(Test *test)
+{
+    FILE *fh;
+    double timeout = -1;
+
+    fh = test_open_file(test, EXT_TIMEOUT);
+    if (fh == NULL) goto out;
+    if (fscanf(fh, " %lf", &timeout) != 1 || timeout <= 0) {
+        timeout = -1;
+    }
+    fclose(fh);
+out:
+    return timeout;
+}
+
+int test_get_time_budget(Test *test, double *wall, double *cpu)
+{
+    FILE *fh;
+    int res = 0;
+
+    fh = test_open_file(test, EXT_TIME);
+    if (fh == NULL) goto out;
+    *cpu = 0;
+    switch (fscanf(fh, " %lf %lf", wall, cpu)) {
+    case 2:
+    case 1:
+        res = *wall >= 0 && *cpu >= 0;
+        break;
+    }
+    fclose(fh);
+out:
+    return res;
+}
+
+long test_get_rss_budget(Test *test)
+{
+    FILE *fh;
+    double size;
+    long rss = -1;
+    char unit = 'K';
+
+    fh = test_open_file(test, EXT_RSS);
+    if (fh == NULL) goto out;
+    if (fscanf(fh, " %lf %c", &size, &unit) >= 1 && size >= 0) {
+        switch (unit) {
+        case 'G': case 'g': size *= 1024;   /* fall through */
+        case 'M': case 'm': size *= 1024;   /* fall through */
+        case 'K': case 'k': rss = size;     break;
+        }
+    }
+    fclose(fh);
+out:
+    return rss;
+}
+
+long long test_get_output_limit(Test *test)
+{
+    FILE *fh;
+    char *line = NULL;
+    size_t len = 0;
+    long long limit = -1;
+
+    fh = test_open_file(test, EXT_OUTPUT_LIMIT);
+    if (fh == NULL) goto out;
+    if (getline(&line, &len, fh) >= 0) {
+        limit = parse_size(line);
+    }
+    free(line);
+    fclose(fh);
+out:
+    return limit;
+}
+
 char * test_get_file_for_ext(Test *test, const char *ext)
 {
+    if (test->pack) {
+        return NULL;
+    }
     return get_filepath(test->dir, test->name, ext);
 }
+
+/**
+ * Map a whole file to memory. Empty file is not mapped, an empty string is
+ * returned instead.
+ *
+ * @param path  file to map
+ * @param len   where to store length of the file (out)
+ * @return content of the file or NULL on failure
+ */
+static const char *
+map_file(const char *path, size_t *len)
+{
+    struct stat info;
+    void *map;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &info) < 0) {
+        close(fd);
+        return NULL;
+    }
+    *len = info.st_size;
+    map = *len > 0 ? mmap(NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0) : "";
+    close(fd);
+    return map != MAP_FAILED ? map : NULL;
+}
+
+const char * test_get_data(Test *test, const char *ext, size_t *len)
+{
+    const char *data;
+    char *path;
+
+    if (test->pack) {
+        return pack_get_data(test->pack, test->pack_index, part_index(ext),
+                len);
+    }
+    path = get_filepath(test->dir, test->name, ext);
+    data = map_file(path, len);
+    free(path);
+    return data;
+}
+
+void test_release_data(Test *test, const char *data, size_t len)
+{
+    if (test->pack == NULL && data != NULL && len > 0) {
+        munmap((void *) data, len);
+    }
+}
+
+int test_set_data(Test *test, const char *ext, const char *data, size_t len)
+{
+    char *path;
+    int ok;
+
+    if (test->pack) {
+        errno = EROFS;
+        return 0;
+    }
+    path = get_filepath(test->dir, test->name, ext);
+    ok = write_file(path, data, len);
+    free(path);
+    test->has_files_hash = 0;
+    return ok;
+}
+
+uint64_t test_hash_files(Test *test)
+{
+    uint64_t hash = CACHE_HASH_INIT, size;
+    const char *data;
+    char *path;
+    size_t i, len;
+
+    if (test->has_files_hash) {
+        return test->files_hash;
+    }
+    for (i = 0; i < PACK_PARTS; i++) {
+        hash = cache_hash(hash, parts[i].ext, strlen(parts[i].ext) + 1);
+        if (!FLAG_SET(test->parts, parts[i].part)) {
+            hash = cache_hash(hash, "", 1);
+        } else if (test->pack) {
+            /* The same as cache_hash_file(), so that packing a suite does
+             * not invalidate the cache. */
+            data = pack_get_data(test->pack, test->pack_index, i, &len);
+            size = len;
+            hash = cache_hash(hash, &size, sizeof(size));
+            hash = cache_hash(hash, data, len);
+        } else {
+            path = test_get_file_for_ext(test, parts[i].ext);
+            hash = cache_hash_file(hash, path);
+            free(path);
+        }
+    }
+    test->files_hash = hash;
+    test->has_files_hash = 1;
+    return hash;
+}
@@ -6,16 +6,56 @@
 #include <stdint.h>
 
 #include "list.h"
+#include "manifest.h"
+#include "pack.h"
+
+/**
+ * Resources used by a test program, as reported by wait4(2).
+ */
+typedef struct test_usage_t TestUsage;
+struct test_usage_t {
+    /** wall clock time in seconds */
+    double wall;
+    /** CPU time in user mode in seconds */
+    double user;
+    /** CPU time in kernel mode in seconds */
+    double sys;
+    /** maximum resident set size in kilobytes */
+    long max_rss;
+    long major_faults;
+    long minor_faults;
+    long voluntary_switches;
+    long involuntary_switches;
+};
 
 typedef struct test_t Test;
 struct test_t {
     char *name;
     char *dir;
-    uint8_t parts;
+    /** reference count of dir shared by tests loaded together, NULL if
+     * the test owns dir */
+    unsigned int *dir_refs;
+    /** pack the test is stored in, NULL if it is in dir */
+    Pack *pack;
+    size_t pack_index;
+    /** manifest the test was loaded with and its entry, NULL if none */
+    Manifest *manifest;
+    ManifestEntry *manifest_entry;
+    uint16_t parts;
+    /** whether files_hash is valid */
+    int has_files_hash;
+    /** hash of the files returned by test_hash_files() */
+    uint64_t files_hash;
+    /** whether the test was executed and usage is valid */
+    int has_usage;
+    TestUsage usage;
 };
 
 /**
- * Load all test definitions from a directory.
+ * Load all test definitions from a directory. Subdirectories whose names
+ * start with a digit are loaded as groups of tests: a test in them is named
+ * by its path relative to 'dir', e.g. 010_parser/001_empty, and the group
+ * is ordered among other tests by its number.
  *
  * This function returns NULL if there was a problem loading tests as well as
  * when there no tests present in 'dir'. These situations can be told apart
@@ -26,6 +66,30 @@ struct test_t {
  */
 List * test_load_from_dir(const char *dir);
 
+/**
+ * Load tests from a directory as test_load_from_dir() does, but take
+ * listings of directories that did not change from a manifest. The
+ * manifest is updated with what was found and later with arguments and
+ * exit codes of the tests, so it must not be freed before the tests.
+ *
+ * @param dir       path to directory with tests
+ * @param manifest  manifest of the directory (allow-none)
+ * @return          list of tests or NULL on failure
+ */
+List * test_load_with_manifest(const char *dir, Manifest *manifest);
+
+/**
+ * Load all tests from a pack created by gen-test --pack. Files of the tests
+ * are not copied, they are read from the mapped pack when needed.
+ *
+ * On failure, error message is printed, NULL is returned and errno is set to
+ * zero.
+ *
+ * @param path  file with the pack
+ * @return      list of tests or NULL on failure
+ */
+List * test_load_from_pack(const char *path);
+
 /**
  * Free a test.
  *
@@ -61,13 +125,104 @@ char ** test_get_args(Test *test, size_t *count);
  */
 int test_get_exit_code(Test *test);
 
+/**
+ * Get time limit for this test.
+ *
+ * @param test  test
+ * @return time limit in seconds or -1 on failure
+ */
+double test_get_timeout(Test *test);
+
+/**
+ * Get time budget of this test. The file contains the maximum wall clock
+ * time in seconds, optionally followed by the maximum CPU time (user and
+ * system together). Zero means the time is not checked.
+ *
+ * @param test  test
+ * @param wall  where to store wall clock time budget (out)
+ * @param cpu   where to store CPU time budget (out)
+ * @return 1 on success, 0 on failure
+ */
+int test_get_time_budget(Test *test, double *wall, double *cpu);
+
+/**
+ * Get memory budget of this test. The file contains maximum resident set
+ * size in kilobytes, which can be followed by a K, M or G suffix.
+ *
+ * @param test  test
+ * @return memory budget in kilobytes or -1 on failure
+ */
+long test_get_rss_budget(Test *test);
+
+/**
+ * Get output limit of this test. The file contains maximum number of bytes
+ * the program may write to each of stdout and stderr, which can be followed
+ * by a K, M or G suffix.
+ *
+ * @param test  test
+ * @return output limit in bytes or -1 on failure
+ */
+long long test_get_output_limit(Test *test);
+
 /**
  * Get file path for file with given extension.
  *
  * @param test  test to be queried
  * @param ext   requested extension
- * @return path to the file (transfer full)
+ * @return path to the file (transfer full) or NULL if the test is packed
  */
 char * test_get_file_for_ext(Test *test, const char *ext);
 
+/**
+ * Get content of a file of the test. The file is mapped to memory, content
+ * of a packed test points to the mapped pack.
+ *
+ * @param test  test to be queried
+ * @param ext   requested extension
+ * @param len   where to store length of the content (out)
+ * @return content to be released by test_release_data() or NULL if the file
+ *         can not be read
+ */
+const char * test_get_data(Test *test, const char *ext, size_t *len);
+
+/**
+ * Release content returned by test_get_data().
+ *
+ * @param test  the test
+ * @param data  content of its file (allow-none)
+ * @param len   length of the content
+ */
+void test_release_data(Test *test, const char *data, size_t len);
+
+/**
+ * Replace content of a file of the test. The file is replaced atomically, so
+ * that it is never left partially written. Packed tests can not be changed.
+ *
+ * @param test  the test
+ * @param ext   extension of the file
+ * @param data  new content
+ * @param len   length of the content
+ * @return 1 on success, 0 on failure with errno set
+ */
+int test_set_data(Test *test, const char *ext, const char *data, size_t len);
+
+/**
+ * Get extension of a test file by index of its part, in the same order as
+ * in a pack.
+ *
+ * @param part  index of the part, from 0 to PACK_PARTS - 1
+ * @return the extension or NULL if the index is out of range
+ */
+const char * test_get_part_ext(unsigned int part);
+
+/**
+ * Compute hash of all files of a test. Any change of their content or
+ * adding and removing a file changes the hash. The files are read only
+ * once, the hash is kept in the test until test_set_data() changes them.
+ *
+ * @param test  test to be hashed
+ * @return the hash
+ */
+uint64_t test_hash_files(Test *test);
+
 #endif /* end of include guard: TEST_H */
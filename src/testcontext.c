@@ -1,32 +1,180 @@
 #include <config.h>
 
+#include "baseline.h"
+#include "cache.h"
+#include "capture.h"
+#include "diff.h"
+#include "history.h"
+#include "memcheck.h"
 #include "outputqueue.h"
+#include "reporter.h"
+#include "stats.h"
 #include "test.h"
 #include "testcontext.h"
 #include "utils.h"
 
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
 #include <string.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+/**
+ * How often to check for exited programs if they can not be waited for by
+ * pidfd, in milliseconds.
+ */
+#define WAIT_INTERVAL 10
+
+/**
+ * Options passed to Valgrind unless set by test_context_set_valgrind_flags().
+ */
+#define VALGRIND_FLAGS "--tool=memcheck --leak-check=full"
+
+/**
+ * Name of sanitizer logs in the directory of a run, the sanitizer runtime
+ * appends process id to it.
+ */
+#define SANITIZER_LOG "log"
+
+/**
+ * Probability below which a difference from baseline is considered
+ * significant.
+ */
+#define SIGNIFICANCE_LEVEL 0.05
+
+/**
+ * Default limit of each output of a program, in bytes.
+ */
+#define OUTPUT_LIMIT (1024 * 1024 * 1024)
+
 struct test_context_t {
     char *cmd;
-    char *diff_opts;
-    int use_valgrind;
+    DiffOptions diff_opts;
+    MemoryChecker memory;
+    /** path to Valgrind and options passed to it before the program */
+    char *valgrind;
+    char **valgrind_flags;
+    unsigned int jobs;
+    double timeout;
+    /** whether to compare output while the program runs */
+    int stream;
+    /** whether to write actual outputs as the expected ones */
+    int update;
+    /** maximum size of each output in bytes, 0 for no limit */
+    size_t output_limit;
+    unsigned int top;
+    /** number of measured runs of each test in benchmark mode, 0 otherwise */
+    unsigned int bench_runs;
+    unsigned int warmup_runs;
+    /** wall clock and CPU times of measured runs of current test */
+    double *bench_wall;
+    double *bench_cpu;
+    size_t bench_len;
+    /** baseline to compare with or NULL */
+    Baseline *baseline;
+    /** how much slower a test may get, in percent */
+    double threshold;
+    /** where to save results of this run or NULL */
+    char *save_path;
+    Baseline *new_baseline;
+    /** reporters writing results as they come */
+    List *reporters;
+    /** results of previous runs or NULL if caching is disabled */
+    Cache *cache;
+    /** hash of the tested program */
+    uint64_t cmd_hash;
+    /** outcomes and durations of tests, NULL if not recorded */
+    History *history;
+    /** result of the test being finished */
+    TestResult result;
     OQueue *logs;
     unsigned int test_num;
     unsigned int check_num;
     unsigned int check_failed;
     unsigned int crashed;
+    unsigned int timed_out;
     unsigned int skipped;
+    unsigned int cached;
+    unsigned int updated_tests;
+    unsigned int updated_files;
     VerbosityMode verbose;
 };
 
+/**
+ * State of one execution of a test. Runs are stored in an array in the same
+ * order as tests, so that results can be reported in this order even if the
+ * programs finish in a different one. In benchmark mode each test has several
+ * consecutive runs, only the first one is checked.
+ */
+typedef struct {
+    Test *test;
+    /** index of the run among runs of the same test */
+    unsigned int iteration;
+    pid_t pid;
+    /** descriptor becoming readable once the program exits, -1 if none */
+    int pidfd;
+    int status;
+    /** the program was collected by waitpid() */
+    int reaped;
+    /** both reaped and all output was read */
+    int finished;
+    /** time limit in seconds, 0 if unlimited */
+    double timeout;
+    /** maximum size of each output in bytes, 0 if unlimited */
+    size_t output_limit;
+    /** value of monotonic_time() when the program is killed */
+    double deadline;
+    int timed_out;
+    /** value of monotonic_time() when the program was started */
+    double start;
+    TestUsage usage;
+    const char *skip_msg;
+    /** the test passed before with the same key and was not run */
+    int cached;
+    /** hash of files of the test */
+    uint64_t files;
+    /** key of the test in the result cache */
+    uint64_t key;
+    char **args;
+    Capture *out;
+    Capture *err;
+    /** file with Valgrind output or directory with sanitizer logs */
+    char *mem_file;
+    /** environment of the program, NULL for the default one */
+    char **env;
+    /** expected outputs compared while the program runs, NULL if not
+     * streamed */
+    const char *expected_out;
+    size_t expected_out_len;
+    const char *expected_err;
+    size_t expected_err_len;
+    /** extension of the output that differed while the program ran and
+     * the program was killed, NULL otherwise */
+    const char *diverged;
+    size_t diverged_at;
+    /** extension of the output that went over the limit, NULL otherwise */
+    const char *exceeded;
+    /** how many bytes of the output were received */
+    size_t exceeded_size;
+} TestRun;
+
 TestContext * test_context_new(void)
 {
     TestContext *tc = calloc(sizeof(TestContext), 1);
     tc->verbose = MODE_NORMAL;
+    tc->jobs = 1;
+    tc->threshold = 5;
+    tc->output_limit = OUTPUT_LIMIT;
+    tc->valgrind = strdup(VALGRIND_PATH);
+    tc->valgrind_flags = parse_args(VALGRIND_FLAGS, NULL);
+    diff_options_init(&tc->diff_opts);
     tc->logs = oqueue_new();
     return tc;
 }
@@ -49,15 +197,118 @@ int test_context_set_command(TestContext *tc, const char *cmd)
     return 1;
 }
 
-void test_context_set_use_valgrind(TestContext *tc)
+void test_context_set_memory_checker(TestContext *tc, MemoryChecker checker)
+{
+    tc->memory = checker;
+}
+
+void test_context_set_valgrind(TestContext *tc, const char *path)
+{
+    free(tc->valgrind);
+    tc->valgrind = strdup(path);
+}
+
+int test_context_set_valgrind_flags(TestContext *tc, const char *flags)
+{
+    char **args = parse_args(flags, NULL);
+
+    if (args == NULL) {
+        fprintf(stderr, "Can not parse Valgrind options '%s'\n", flags);
+        return 0;
+    }
+    str_array_free(tc->valgrind_flags);
+    tc->valgrind_flags = args;
+    return 1;
+}
+
+int test_context_set_diff_opts(TestContext *tc, const char *opts)
+{
+    return diff_options_parse(&tc->diff_opts, opts);
+}
+
+void test_context_set_jobs(TestContext *tc, unsigned int jobs)
+{
+    tc->jobs = jobs > 0 ? jobs : 1;
+}
+
+void test_context_set_timeout(TestContext *tc, double timeout)
+{
+    tc->timeout = timeout > 0 ? timeout : 0;
+}
+
+void test_context_set_output_limit(TestContext *tc, size_t limit)
+{
+    tc->output_limit = limit;
+}
+
+void test_context_set_stream(TestContext *tc, int stream)
+{
+    tc->stream = stream;
+}
+
+void test_context_set_update(TestContext *tc, int update)
+{
+    tc->update = update;
+}
+
+void test_context_set_top(TestContext *tc, unsigned int top)
+{
+    tc->top = top;
+}
+
+void test_context_set_bench(TestContext *tc, unsigned int runs,
+                            unsigned int warmup)
+{
+    tc->bench_runs = runs;
+    tc->warmup_runs = runs > 0 ? warmup : 0;
+    tc->bench_wall = realloc(tc->bench_wall, runs * sizeof(double));
+    tc->bench_cpu = realloc(tc->bench_cpu, runs * sizeof(double));
+}
+
+int test_context_set_compare_baseline(TestContext *tc, const char *path)
+{
+    Baseline *b = baseline_load(path);
+
+    if (b == NULL) {
+        return 0;
+    }
+    baseline_free(tc->baseline);
+    tc->baseline = b;
+    return 1;
+}
+
+void test_context_set_threshold(TestContext *tc, double threshold)
+{
+    tc->threshold = threshold;
+}
+
+void test_context_set_save_baseline(TestContext *tc, const char *path)
+{
+    free(tc->save_path);
+    tc->save_path = strdup(path);
+}
+
+int test_context_add_reporter(TestContext *tc, const char *spec)
+{
+    Reporter *r = reporter_new(spec);
+
+    if (r == NULL) {
+        return 0;
+    }
+    tc->reporters = list_append(tc->reporters, r);
+    return 1;
+}
+
+void test_context_set_cache(TestContext *tc, const char *path)
 {
-    tc->use_valgrind = 1;
+    cache_free(tc->cache);
+    tc->cache = cache_load(path);
 }
 
-void test_context_set_diff_opts(TestContext *tc, const char *opts)
+void test_context_set_history(TestContext *tc, History *history)
 {
-    free(tc->diff_opts);
-    tc->diff_opts = strdup(opts);
+    history_free(tc->history);
+    tc->history = history;
 }
 
 void test_context_set_verbosity(TestContext *tc, VerbosityMode verbose)
@@ -69,6 +320,17 @@ void test_context_free(TestContext *tc)
 {
     if (tc) {
         free(tc->cmd);
+        free(tc->valgrind);
+        str_array_free(tc->valgrind_flags);
+        free(tc->bench_wall);
+        free(tc->bench_cpu);
+        free(tc->save_path);
+        baseline_free(tc->baseline);
+        baseline_free(tc->new_baseline);
+        cache_free(tc->cache);
+        history_free(tc->history);
+        list_destroy(tc->reporters, DESTROYFUNC(reporter_free));
+        test_result_clear(&tc->result);
         oqueue_free(tc->logs);
     }
     free(tc);
@@ -79,6 +341,12 @@ void test_context_free(TestContext *tc)
  */
 #define TC_IS_QUIET(tc) (tc->verbose == MODE_QUIET)
 
+/**
+ * How many times each test is run.
+ */
+#define TC_RUNS_PER_TEST(tc) \
+    ((tc)->bench_runs > 0 ? (tc)->warmup_runs + (tc)->bench_runs : 1)
+
 /**
  * Wrapper around print_color() utility function that only prints if the test
  * context is not set to be quiet.
@@ -89,16 +357,18 @@ void test_context_free(TestContext *tc)
  */
 static void test_context_print_color(TestContext *tc, char *color, char *str)
 {
-    if (!TC_IS_QUIET(tc)) {
+    if (!TC_IS_QUIET(tc) && tc->bench_runs == 0) {
         print_color(color, str);
     }
 }
 
 /**
- * Check if condition holds and print appropriate message to stdout.
+ * Check if condition holds and print appropriate message to stdout. The
+ * result is recorded for reporters as well.
  *
  * @param tc    test context
  * @param t     test run
+ * @param check name of the check
  * @param cond  condition to check
  * @param fmt   printf-style formatting string with error message
  * @return 0 if test passed, 1 otherwise
@@ -106,19 +376,27 @@ static void test_context_print_color(TestContext *tc, char *color, char *str)
 static int
 test_context_handle_result(TestContext *tc,
                            Test *test,
+                           const char *check,
                            int cond,
                            const char *fmt,
                            ...)
 {
     va_list args;
+    char *msg;
+
     if (cond) {
         test_context_print_color(tc, GREEN, ".");
+        test_result_add_check(&tc->result, check, 1, NULL);
         return 0;
     }
     va_start(args, fmt);
+    msg = str_vprintf(fmt, args);
+    va_end(args);
     test_context_print_color(tc, RED, "F");
+    test_result_add_check(&tc->result, check, 0, msg);
     oqueue_pushf(tc->logs, "Test %s failed:\n", str_to_bold(test->name));
-    oqueue_pushvf(tc->logs, fmt, args);
+    oqueue_push(tc->logs, msg);
+    free(msg);
     return 1;
 }
 
@@ -139,38 +417,59 @@ test_context_check_return_code(TestContext *tc, Test *test, int status)
     if (expected < 0) exit(EXIT_FAILURE);
 
     actual = WEXITSTATUS(status);
-    return test_context_handle_result(tc, test, expected == actual,
+    return test_context_handle_result(tc, test, EXT_RETVAL, expected == actual,
             "expected exit code %d, got %d\n\n", expected, actual);
 }
 
 /**
- * Get string array to pass to execvp(3) to invoke diff.
+ * Check if the program fits into its time budget.
  *
  * @param tc    test context
- * @param orig  first file to pass to diff
- * @param real  second file to pass to diff
- * @return      NULL-terminated array of strings
+ * @param test  test
+ * @param u     resources used by the program
+ * @return 0 if test passed, 1 otherwise
  */
-static char **
-test_context_get_diff_cmd(TestContext *tc, const char *orig, const char *real)
+static int
+test_context_check_time(TestContext *tc, Test *test, TestUsage *u)
 {
-    const char * const template = "diff -u -d --label=expected --label=actual";
-    size_t len;
-    char *cmd, **args;
+    double wall, cpu;
+    int wall_ok, cpu_ok;
 
-    len = strlen(template) + strlen(orig) + strlen(real) + 10;
-    len += tc->diff_opts != NULL ? strlen(tc->diff_opts) : 0;
-    cmd = calloc(1, len);
-    sprintf(cmd, "%s %s %s %s",
-            template,
-            tc->diff_opts ? tc->diff_opts : "",
-            orig, real);
+    if (!test_get_time_budget(test, &wall, &cpu)) {
+        fprintf(stderr, "Can not read time budget of test %s\n", test->name);
+        exit(EXIT_FAILURE);
+    }
 
-    args = parse_args(cmd, NULL);
+    wall_ok = wall == 0 || u->wall <= wall;
+    cpu_ok = cpu == 0 || u->user + u->sys <= cpu;
+    return test_context_handle_result(tc, test, EXT_TIME, wall_ok && cpu_ok,
+            "%s time %.3f seconds exceeds budget of %g seconds\n\n",
+            wall_ok ? "CPU" : "wall clock",
+            wall_ok ? u->user + u->sys : u->wall,
+            wall_ok ? cpu : wall);
+}
 
-    free(cmd);
+/**
+ * Check if the program fits into its memory budget.
+ *
+ * @param tc    test context
+ * @param test  test
+ * @param u     resources used by the program
+ * @return 0 if test passed, 1 otherwise
+ */
+static int
+test_context_check_rss(TestContext *tc, Test *test, TestUsage *u)
+{
+    long budget = test_get_rss_budget(test);
 
-    return args;
+    if (budget < 0) {
+        fprintf(stderr, "Can not read memory budget of test %s\n", test->name);
+        exit(EXIT_FAILURE);
+    }
+
+    return test_context_handle_result(tc, test, EXT_RSS, u->max_rss <= budget,
+            "maximum resident set size %ld kB exceeds budget of %ld kB\n\n",
+            u->max_rss, budget);
 }
 
 /**
@@ -178,94 +477,186 @@ test_context_get_diff_cmd(TestContext *tc, const char *orig, const char *real)
  *
  * @param tc    test context
  * @param t     test run
- * @param fname file with actual output of the program
+ * @param cap   captured output of the program
  * @param ext   extension specifying type of check to perform
  * @return 0 if test passed, 1 otherwise
  */
 static int
 test_context_check_output_file(TestContext *tc,
                                Test *t,
-                               const char *fname,
+                               Capture *cap,
                                const char *ext)
 {
-    char *expected;
-    pid_t child;
-    int status, res;
-    int mypipe[2];
-
-    if (pipe(mypipe) < 0) {
-        perror("pipe");
-        exit(EXIT_FAILURE);
-    }
-
-    expected = test_get_file_for_ext(t, ext);
+    const char *expected, *actual;
+    size_t expected_len, actual_len, line_num;
+    int res;
 
-    child = fork();
-    if (child == -1) {
-        perror("fork");
-        exit(EXIT_FAILURE);
-    } else if (child == 0) {    /* child */
-        char **args = test_context_get_diff_cmd(tc, expected, fname);
-        close(mypipe[PIPE_READ]);
-        dup2(mypipe[PIPE_WRITE], STDOUT_FILENO);
-        execvp("diff", args);
-        perror("exec");
-        exit(EXIT_FAILURE);
-    }
-    free(expected);
-    close(mypipe[PIPE_WRITE]);
-    wait(&status);
-    if (WIFSIGNALED(status)) {
-        fprintf(stderr, "Diff failed\n");
+    expected = test_get_data(t, ext, &expected_len);
+    if (expected == NULL) {
+        fprintf(stderr, "Can not read std%s of test %s", ext, t->name);
+        perror("");
         exit(EXIT_FAILURE);
     }
+    actual = capture_get_data(cap, &actual_len);
 
-    res = test_context_handle_result(tc, t,
-            WEXITSTATUS(status) == 0, "std%s differs", ext);
-    if (res != 0) {             /* checking failed */
+    res = test_context_handle_result(tc, t, ext,
+            diff_equal(expected, expected_len, actual, actual_len, &tc->diff_opts),
+            "std%s differs", ext);
+    /* checking failed */
+    if (res != 0 && (!TC_IS_QUIET(tc) || tc->reporters != NULL)) {
         if (tc->verbose == MODE_VERBOSE) {
             /* Verbose means copying diff */
             oqueue_push(tc->logs, " - diff follows:\n");
-            oqueue_copy_from_fd(tc->logs, mypipe[PIPE_READ]);
+            line_num = diff_unified(expected, expected_len, actual, actual_len,
+                    &tc->diff_opts, tc->logs);
             oqueue_push(tc->logs, "\n");
         } else {                /* Otherwise only print how big the diff is */
-            size_t line_num = count_lines_on_fd(mypipe[PIPE_READ]);
-            oqueue_pushf(tc->logs, " - diff has %zu lines\n\n", line_num - 2);
+            line_num = diff_unified(expected, expected_len, actual, actual_len,
+                    &tc->diff_opts, NULL);
+            oqueue_pushf(tc->logs, " - diff has %zu lines\n\n", line_num);
         }
+        tc->result.checks[tc->result.check_num - 1].diff_lines = line_num;
     }
-    close(mypipe[PIPE_READ]);
+    test_release_data(t, expected, expected_len);
     return res;
 }
 
+/**
+ * Print errors found by Valgrind to the log.
+ *
+ * @param tc        test context
+ * @param report    parsed output of Valgrind
+ */
 static void
-test_context_analyze_memory(TestContext *tc, Test *t, char *file)
+test_context_log_memory_errors(TestContext *tc, MemcheckReport *report)
 {
-    int errors, contexts;
-    FILE *fh = fopen(file, "r");
-    if (!get_num_errors(fh, &errors, &contexts)) {
-        /* log failure to parse */
+    MemcheckError *e;
+    size_t i, j;
+
+    for (i = 0; i < report->len; i++) {
+        e = &report->errors[i];
+        oqueue_pushf(tc->logs, "%s: %s\n", e->kind ? e->kind : "Error",
+                e->what ? e->what : "");
+        for (j = 0; j < e->frame_num; j++) {
+            oqueue_pushf(tc->logs, "    %s %s\n", j == 0 ? "at" : "by",
+                    e->frames[j]);
+        }
+    }
+    if (!report->complete) {
+        oqueue_push(tc->logs, "Valgrind output is incomplete.\n");
+    }
+}
+
+/**
+ * Parse all sanitizer logs in a directory. There is one log for each process
+ * that reported something, processes that exited cleanly leave no log.
+ *
+ * @param dir       directory with the logs
+ * @param report    where to store the errors
+ * @return 1 on success, 0 if the directory can not be read
+ */
+static int
+read_sanitizer_logs(const char *dir, MemcheckReport *report)
+{
+    DIR *d = opendir(dir);
+    struct dirent *ent;
+    char *path;
+    FILE *fh;
+
+    if (d == NULL) {
+        return 0;
+    }
+    while ((ent = readdir(d)) != NULL) {
+        if (ent->d_name[0] == '.') continue;
+        path = str_printf("%s/%s", dir, ent->d_name);
+        if ((fh = fopen(path, "r")) != NULL) {
+            memcheck_parse_sanitizer(fh, report);
+            fclose(fh);
+        }
+        free(path);
+    }
+    closedir(d);
+    report->complete = 1;
+    return 1;
+}
+
+/**
+ * Check output of the memory checker and update counters accordingly. If
+ * the output can not be read, the checker did not run and no check is
+ * recorded.
+ *
+ * Sanitizers that ignore log_path, such as UndefinedBehaviorSanitizer in
+ * the runtime shared with AddressSanitizer, still write to error output of
+ * the program, so it is searched for reports too.
+ *
+ * @param tc    test context
+ * @param t     test
+ * @param err   captured stderr
+ * @param file  file with XML output of Valgrind or directory with sanitizer
+ *              logs
+ */
+static void
+test_context_analyze_memory(TestContext *tc, Test *t, Capture *err,
+                            char *file)
+{
+    MemcheckReport report;
+    MemcheckError *first;
+    char *msg, *detail;
+    FILE *fh = NULL;
+    const char *data;
+    size_t len;
+
+    memset(&report, 0, sizeof(MemcheckReport));
+    if (tc->memory == MEMORY_ASAN) {
+        if (!read_sanitizer_logs(file, &report)) {
+            goto out;
+        }
+        data = capture_get_data(err, &len);
+        if (len > 0 && (fh = fmemopen((void *) data, len, "r")) != NULL) {
+            memcheck_parse_sanitizer(fh, &report);
+        }
+    } else if ((fh = fopen(file, "r")) == NULL
+            || !memcheck_parse(fh, &report)) {
         goto out;
     }
 
     tc->check_num++;
-    if (errors == 0) {
+    if (report.len == 0) {
         test_context_print_color(tc, GREEN, ".");
-    } else {
-        tc->check_failed++;
-        test_context_print_color(tc, YELLOW, "M");
-        if (TC_IS_QUIET(tc)) goto out;
-        oqueue_pushf(tc->logs, "Test %s failed:\ndetected %d memory %s in %d contexts\n",
-                str_to_bold(t->name), errors,
-                errors > 1 ? "error" : "errors",
-                contexts);
+        test_result_add_check(&tc->result, "memory", 1, NULL);
+        goto out;
+    }
+
+    tc->check_failed++;
+    test_context_print_color(tc, YELLOW, "M");
+    msg = str_printf("detected %ld memory %s in %zu %s", report.total,
+            report.total == 1 ? "error" : "errors", report.len,
+            report.len == 1 ? "context" : "contexts");
+    if (report.leaked_bytes > 0) {
+        detail = str_printf("%s, %ld bytes leaked", msg, report.leaked_bytes);
+        free(msg);
+        msg = detail;
+    }
+    first = &report.errors[0];
+    detail = str_printf("%s; first is %s: %s%s%s", msg,
+            first->kind ? first->kind : "Error",
+            first->what ? first->what : "",
+            first->frame_num > 0 ? " at " : "",
+            first->frame_num > 0 ? first->frames[0] : "");
+    test_result_add_check(&tc->result, "memory", 0, detail);
+    free(detail);
+    if (!TC_IS_QUIET(tc)) {
+        oqueue_pushf(tc->logs, "Test %s failed:\n%s\n",
+                str_to_bold(t->name), msg);
         if (tc->verbose == MODE_VERBOSE) {
-            oqueue_copy_from_valgrind(tc->logs, fh, contexts);
-        } else {
-            oqueue_push(tc->logs, "\n");
+            test_context_log_memory_errors(tc, &report);
         }
+        oqueue_push(tc->logs, "\n");
     }
+    free(msg);
 
 out:
+    memcheck_report_clear(&report);
     if (fh) fclose(fh);
 }
 
@@ -292,22 +683,24 @@ out:
  *
  * @param tc    test context
  * @param test  test run
- * @param out_file  where stdout was stored
- * @param err_file  where stderr was stored
+ * @param out       captured stdout
+ * @param err       captured stderr
  * @param mem_file  where memory output was stored
  * @param status    status received from wait()
  */
 static void
 test_context_analyze_test_run(TestContext *tc,
                               Test *test,
-                              const char *out_file,
-                              const char *err_file,
+                              Capture *out,
+                              Capture *err,
                               char *mem_file,
                               int status)
 {
     tc->test_num++;
     if (!WIFEXITED(status)) {
         tc->crashed++;
+        tc->result.status = RESULT_CRASHED;
+        tc->result.reason = strdup(strsignal(WTERMSIG(status)));
         test_context_print_color(tc, RED, "C");
         if (tc->verbose == MODE_VERBOSE) {
             oqueue_pushf(tc->logs, "Crash in %s: %s (%d)\n\n",
@@ -320,32 +713,21 @@ test_context_analyze_test_run(TestContext *tc,
     test_context_check(tc, test, TEST_RETVAL,
             test_context_check_return_code, status);
     test_context_check(tc, test, TEST_OUTPUT,
-            test_context_check_output_file, out_file, EXT_OUTPUT);
+            test_context_check_output_file, out, EXT_OUTPUT);
     test_context_check(tc, test, TEST_ERRORS,
-            test_context_check_output_file, err_file, EXT_ERRORS);
-    if (tc->use_valgrind) {
-        test_context_analyze_memory(tc, test, mem_file);
+            test_context_check_output_file, err, EXT_ERRORS);
+    if (tc->memory != MEMORY_NONE) {
+        /* Resources used under a memory checker say nothing about the
+         * program. */
+        test_context_analyze_memory(tc, test, err, mem_file);
+    } else {
+        test_context_check(tc, test, TEST_TIME,
+                test_context_check_time, &test->usage);
+        test_context_check(tc, test, TEST_RSS,
+                test_context_check_rss, &test->usage);
     }
 }
 
-/**
- * Create temporary files for stdout and stderr, open them and then return
- * their file descriptors. The (char *) arguments will be modified and
- * therefore can not point to string constant.
- *
- * @return whether files were opened
- */
-static int
-test_context_prepare_outfiles(char *out_file,
-                              int *out_fd,
-                              char *err_file,
-                              int *err_fd)
-{
-    *out_fd = mkstemp(out_file);
-    *err_fd = mkstemp(err_file);
-    return *err_fd > 0 && *out_fd > 0;
-}
-
 /**
  * Build argument vector to be passed to tested program. First element will be
  * the executed command. This function always returns vector with at least one
@@ -382,6 +764,8 @@ static void
 test_context_skip(TestContext *tc, Test *t, const char *msg)
 {
     test_context_print_color(tc, YELLOW, "S");
+    tc->result.status = RESULT_SKIPPED;
+    tc->result.reason = strdup(msg);
     if (tc->verbose == MODE_VERBOSE) {
         oqueue_pushf(tc->logs, "Skipping test %s: %s.\n\n",
                 str_to_bold(t->name), msg);
@@ -393,143 +777,1049 @@ test_context_skip(TestContext *tc, Test *t, const char *msg)
  * Given a file descriptor with standard input and descriptors for both
  * standard and error output, execute the program as specified by args. The
  * actual command to be executed is extracted from the command-line arguments
- * parameter.
+ * parameter. The descriptors are closed in any case.
+ *
+ * The program is started with posix_spawn(3), which does not need to copy
+ * address space of stest the way fork(2) does.
+ *
+ * Programs with time limit are placed in a new process group, so that the
+ * whole group can be killed. Other programs stay in the group of stest to
+ * receive signals from terminal.
  *
  * @param in_fd     where to read standard input from
  * @param out_fd    where to store standard output
  * @param err_fd    where to store error output
  * @param args      arguments of the program
+ * @param env       environment of the program (allow-none)
+ * @param new_group whether to start new process group
+ * @return process id of the started program or -1 on failure
  */
-static void
-execute_test(int in_fd, int out_fd, int err_fd, char **args)
+static pid_t
+execute_test(int in_fd, int out_fd, int err_fd, char **args, char **env,
+             int new_group)
 {
-    static char * const env[] = { "MALLOC_CHECK_=2", NULL };
-    int child;
+    static char * const default_env[] = { "MALLOC_CHECK_=2", NULL };
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    pid_t child;
+    int res;
+
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, in_fd, STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, out_fd, STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, err_fd, STDERR_FILENO);
+    posix_spawnattr_init(&attr);
+    if (new_group) {
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+        posix_spawnattr_setpgroup(&attr, 0);
+    }
+
+    res = posix_spawn(&child, args[0], &actions, &attr, args,
+            env ? env : default_env);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
 
-    child = fork();
-    if (child == -1) {
-        perror("fork");
-        exit(EXIT_FAILURE);
-    } else if (child == 0) {    /* Child */
-        dup2(in_fd, STDIN_FILENO);
-        dup2(out_fd, STDOUT_FILENO);
-        dup2(err_fd, STDERR_FILENO);
-        execve(args[0], args, env);
-        perror("exec");
-        exit(EXIT_FAILURE);
-    }                           /* Parent */
     close(in_fd);
     close(out_fd);
     close(err_fd);
+    if (res != 0) {
+        errno = res;
+        return -1;
+    }
+    return child;
 }
 
 /**
- * Modify array of arguments so as to be passed to valgrind. The returned path
+ * Modify array of arguments so as to be passed to Valgrind. The returned path
  * points to a file that should be unlinked when it is no longer needed. Caller
  * is responsible for freeing the returned pointer.
  *
- * @param _args pointer to a NULL-terminated array of strings @return filename
- * path to a file where valgrind output will be stored
+ * Each run writes XML output to its own file, so that tests can run in
+ * parallel. Plain text messages of Valgrind are discarded, they would mix
+ * with error output of the program.
+ *
+ * @param tc    test context
+ * @param _args pointer to a NULL-terminated array of strings
+ * @return path to a file where Valgrind output will be stored
  */
 static char *
-prepare_for_valgrind(char ***_args)
+prepare_for_valgrind(TestContext *tc, char ***_args)
 {
     char **args = *_args;
-    int len = 1, i, fd;
+    size_t len = 1, flags = 0, i, n = 0;
     char *file = strdup("/tmp/stest-memory-XXXXXX");
-
-    for (i = 0; args[i] != NULL; i++) {
-        len++;
-    }
-
-    args = realloc(args, (4 + len) * sizeof(char *));
-    memmove(args + 4, args, len * sizeof(char *));
-    args[0] = strdup("/usr/bin/valgrind");
-    args[1] = strdup("--tool=memcheck");
-    args[2] = strdup("--leak-check=full");
-    args[3] = calloc(sizeof(char), 128);
+    int fd;
 
     fd = mkstemp(file);
     if (fd < 0) {
         free(file);
-        file = NULL;
-        goto out;
+        return NULL;
     }
     close(fd);
 
-    snprintf(args[3], 128, "--log-file=%s", file);
-out:
+    for (i = 0; args[i] != NULL; i++) {
+        len++;
+    }
+    for (i = 0; tc->valgrind_flags[i] != NULL; i++) {
+        flags++;
+    }
+
+    args = realloc(args, (5 + flags + len) * sizeof(char *));
+    memmove(args + 5 + flags, args, len * sizeof(char *));
+    args[n++] = strdup(tc->valgrind);
+    for (i = 0; i < flags; i++) {
+        args[n++] = strdup(tc->valgrind_flags[i]);
+    }
+    args[n++] = strdup("--xml=yes");
+    args[n++] = str_printf("--xml-file=%s", file);
+    args[n++] = strdup("--log-file=/dev/null");
+    args[n++] = strdup("--child-silent-after-fork=yes");
+
     *_args = args;
     return file;
 }
 
 /**
- * Run a test in given context and analyze the results.
+ * Create environment in which sanitizers write their reports to a directory
+ * of the run instead of error output of the program. The returned path
+ * points to a directory that should be removed with all its contents when it
+ * is no longer needed. Caller is responsible for freeing the returned
+ * pointer.
+ *
+ * @param _env  where to store the environment
+ * @return path to the directory for the logs or NULL on failure
+ */
+static char *
+prepare_for_sanitizer(char ***_env)
+{
+    char *dir = strdup("/tmp/stest-asan-XXXXXX");
+    char **env;
+
+    if (mkdtemp(dir) == NULL) {
+        free(dir);
+        return NULL;
+    }
+    env = malloc(5 * sizeof(char *));
+    env[0] = strdup("MALLOC_CHECK_=2");
+    env[1] = str_printf("ASAN_OPTIONS=log_path=%s/" SANITIZER_LOG
+            ":detect_leaks=1", dir);
+    env[2] = str_printf("LSAN_OPTIONS=log_path=%s/" SANITIZER_LOG, dir);
+    env[3] = str_printf("UBSAN_OPTIONS=log_path=%s/" SANITIZER_LOG
+            ":print_stacktrace=1", dir);
+    env[4] = NULL;
+
+    *_env = env;
+    return dir;
+}
+
+/**
+ * Remove directory with sanitizer logs.
+ *
+ * @param dir   the directory
+ */
+static void
+remove_sanitizer_dir(const char *dir)
+{
+    DIR *d = opendir(dir);
+    struct dirent *ent;
+    char *path;
+
+    while (d != NULL && (ent = readdir(d)) != NULL) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) {
+            continue;
+        }
+        path = str_printf("%s/%s", dir, ent->d_name);
+        unlink(path);
+        free(path);
+    }
+    if (d) closedir(d);
+    rmdir(dir);
+}
+
+/**
+ * Open a descriptor that becomes readable when the process exits.
+ *
+ * @param pid   process to watch
+ * @return file descriptor or -1 if not supported
+ */
+static int
+open_pidfd(pid_t pid)
+{
+#if HAVE_DECL_SYS_PIDFD_OPEN
+    return syscall(SYS_pidfd_open, pid, 0);
+#else
+    return -1;
+#endif
+}
+
+/**
+ * Compute key of a test in the result cache. It covers the tested program,
+ * all files of the test and options that can change the result.
  *
- * @param t     test to be run
  * @param tc    test context
+ * @param files hash of files of the test
+ * @return the key
  */
-static void test_context_run_test(Test *t, TestContext *tc)
+static uint64_t
+test_context_get_key(TestContext *tc, uint64_t files)
 {
-    int in_fd, out_fd, err_fd;
-    char out_file[] = "/tmp/stest-stdout-XXXXXX";
-    char err_file[] = "/tmp/stest-stderr-XXXXXX";
-    int status = 0;
-    char **args = NULL, *mem_file = NULL;
+    uint64_t key = tc->cmd_hash;
+    size_t i;
 
-    if (!test_context_prepare_outfiles(out_file, &out_fd, err_file, &err_fd)) {
-        test_context_skip(tc, t, "can not open temporary files");
-        goto out;
+    key = cache_hash(key, &tc->diff_opts.flags, sizeof(tc->diff_opts.flags));
+    key = cache_hash(key, &tc->diff_opts.context,
+            sizeof(tc->diff_opts.context));
+    key = cache_hash(key, &tc->memory, sizeof(tc->memory));
+    if (tc->memory == MEMORY_VALGRIND) {
+        key = cache_hash(key, tc->valgrind, strlen(tc->valgrind) + 1);
+        for (i = 0; tc->valgrind_flags[i] != NULL; i++) {
+            key = cache_hash(key, tc->valgrind_flags[i],
+                    strlen(tc->valgrind_flags[i]) + 1);
+        }
     }
-    if ((in_fd = test_get_input_fd(t)) < 0) {
-        test_context_skip(tc, t, "can not open input file");
-        goto out;
+    key = cache_hash(key, &tc->timeout, sizeof(tc->timeout));
+    key = cache_hash(key, &tc->output_limit, sizeof(tc->output_limit));
+    key = cache_hash(key, &tc->stream, sizeof(tc->stream));
+    key = cache_hash(key, &tc->update, sizeof(tc->update));
+    return cache_hash(key, &files, sizeof(files));
+}
+
+/**
+ * Load expected outputs of a run, so that the outputs are compared as they
+ * come. Outputs that can not be compared byte by byte are only checked once
+ * the program finishes.
+ *
+ * @param tc    test context
+ * @param run   run to be started
+ */
+static void
+test_context_stream_outputs(TestContext *tc, TestRun *run)
+{
+    if (tc->diff_opts.flags != 0) {
+        return;
     }
-    if ((args = test_context_get_args(tc, t)) == NULL) {
-        test_context_skip(tc, t, "can not read arguments");
-        goto out;
+    if (FLAG_SET(run->test->parts, TEST_OUTPUT)) {
+        run->expected_out = test_get_data(run->test, EXT_OUTPUT,
+                &run->expected_out_len);
+        if (run->expected_out) {
+            capture_set_expected(run->out, run->expected_out,
+                    run->expected_out_len);
+        }
+    }
+    /* Memory checkers can add their reports to stderr. */
+    if (FLAG_SET(run->test->parts, TEST_ERRORS)
+            && tc->memory == MEMORY_NONE) {
+        run->expected_err = test_get_data(run->test, EXT_ERRORS,
+                &run->expected_err_len);
+        if (run->expected_err) {
+            capture_set_expected(run->err, run->expected_err,
+                    run->expected_err_len);
+        }
     }
+}
 
-    if (tc->use_valgrind) {
-        mem_file = prepare_for_valgrind(&args);
-        if (!mem_file) {
-            test_context_skip(tc, t, "can not open memory output file");
-            goto out;
+/**
+ * Start a test in given context. The program is only launched, it is
+ * supervised by test_context_supervise(). If the test can not be started,
+ * it is marked as finished with the reason stored in skip_msg. Tests that
+ * passed with the same key before are not started at all.
+ *
+ * @param tc    test context
+ * @param run   run to be started
+ * @return 1 if the program is running, 0 otherwise
+ */
+static int test_context_start_test(TestContext *tc, TestRun *run)
+{
+    long long limit;
+    int in_fd;
+
+    run->pidfd = -1;
+    if (tc->cache || tc->history) {
+        run->files = test_hash_files(run->test);
+    }
+    if (tc->cache) {
+        run->key = test_context_get_key(tc, run->files);
+        if (cache_lookup(tc->cache, run->test->name, run->key)) {
+            run->cached = 1;
+            run->finished = 1;
+            return 0;
+        }
+    }
+    run->timeout = tc->timeout;
+    if (FLAG_SET(run->test->parts, TEST_TIMEOUT)
+            && (run->timeout = test_get_timeout(run->test)) < 0) {
+        run->skip_msg = "can not read time limit";
+        goto fail1;
+    }
+    run->output_limit = tc->output_limit;
+    if (FLAG_SET(run->test->parts, TEST_OUTPUT_LIMIT)) {
+        limit = test_get_output_limit(run->test);
+        if (limit < 0) {
+            run->skip_msg = "can not read output limit";
+            goto fail1;
         }
+        run->output_limit = limit;
     }
-    execute_test(in_fd, out_fd, err_fd, args);
 
-    wait(&status);
+    run->out = capture_new(CAPTURE_MEMORY_LIMIT);
+    run->err = capture_new(CAPTURE_MEMORY_LIMIT);
+    if (run->out == NULL || run->err == NULL) {
+        run->skip_msg = "can not create pipes for output";
+        goto fail1;
+    }
+    if (run->output_limit > 0) {
+        capture_set_max(run->out, run->output_limit);
+        capture_set_max(run->err, run->output_limit);
+    }
+    /* Updated outputs must be read completely. */
+    if (tc->stream && !tc->update && run->iteration == 0) {
+        test_context_stream_outputs(tc, run);
+    }
+    if ((in_fd = test_get_input_fd(run->test)) < 0) {
+        run->skip_msg = "can not open input file";
+        goto fail1;
+    }
+    if ((run->args = test_context_get_args(tc, run->test)) == NULL) {
+        run->skip_msg = "can not read arguments";
+        goto fail2;
+    }
 
-    test_context_analyze_test_run(tc, t, out_file, err_file, mem_file, status);
-out:
-    str_array_free(args);
+    if (tc->memory == MEMORY_VALGRIND) {
+        run->mem_file = prepare_for_valgrind(tc, &run->args);
+    } else if (tc->memory == MEMORY_ASAN) {
+        run->mem_file = prepare_for_sanitizer(&run->env);
+    }
+    if (tc->memory != MEMORY_NONE && !run->mem_file) {
+        run->skip_msg = "can not open memory output file";
+        goto fail2;
+    }
+    run->start = monotonic_time();
+    run->pid = execute_test(in_fd, capture_take_write_fd(run->out),
+            capture_take_write_fd(run->err), run->args, run->env,
+            run->timeout > 0);
+    if (run->pid < 0) {
+        run->skip_msg = "can not execute command";
+        goto fail1;
+    }
+    run->pidfd = open_pidfd(run->pid);
+    if (run->timeout > 0) {
+        run->deadline = monotonic_time() + run->timeout;
+    }
+    return 1;
+
+fail2:
+    close(in_fd);
+fail1:
+    run->finished = 1;
+    return 0;
+}
+
+/**
+ * Check whether all output of a run was read.
+ */
+#define RUN_OUTPUT_CLOSED(run) (capture_get_read_fd((run)->out) < 0 \
+                                && capture_get_read_fd((run)->err) < 0)
+
+/**
+ * Add descriptor to be polled.
+ */
+static void
+add_pollfd(struct pollfd *fds, size_t *num, int fd)
+{
+    if (fd >= 0) {
+        fds[*num].fd = fd;
+        fds[*num].events = POLLIN;
+        fds[*num].revents = 0;
+        (*num)++;
+    }
+}
+
+/**
+ * Collect exited program of a run and store resources it used.
+ *
+ * @param run   run with a started program
+ * @param block whether to wait for the program to exit
+ */
+static void
+test_run_reap(TestRun *run, int block)
+{
+    TestUsage *usage = &run->usage;
+    struct rusage ru;
+    pid_t pid;
+
+    do {
+        pid = wait4(run->pid, &run->status, block ? 0 : WNOHANG, &ru);
+    } while (pid < 0 && errno == EINTR);
+    if (pid < 0) {
+        perror("wait4");
+        exit(EXIT_FAILURE);
+    }
+    if (pid != run->pid) {
+        return;
+    }
+
+    run->reaped = 1;
+    if (run->pidfd >= 0) {
+        close(run->pidfd);
+        run->pidfd = -1;
+    }
+
+    usage->wall = monotonic_time() - run->start;
+    usage->user = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6;
+    usage->sys = ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+    usage->max_rss = ru.ru_maxrss;
+    usage->major_faults = ru.ru_majflt;
+    usage->minor_faults = ru.ru_minflt;
+    usage->voluntary_switches = ru.ru_nvcsw;
+    usage->involuntary_switches = ru.ru_nivcsw;
+}
+
+/**
+ * Check whether an output of a run went over the limit or differs from the
+ * expected one. Program that already exited is checked as usual when its
+ * output differs, all its output is going to be read anyway.
+ *
+ * @param run   started test
+ * @return 1 if the run should be stopped, 0 otherwise
+ */
+static int
+test_run_check_outputs(TestRun *run)
+{
+    if (capture_exceeded(run->out, &run->exceeded_size)) {
+        run->exceeded = EXT_OUTPUT;
+    } else if (capture_exceeded(run->err, &run->exceeded_size)) {
+        run->exceeded = EXT_ERRORS;
+    } else if (run->reaped) {
+        return 0;
+    } else if (capture_diverged(run->out, &run->diverged_at)) {
+        run->diverged = EXT_OUTPUT;
+    } else if (capture_diverged(run->err, &run->diverged_at)) {
+        run->diverged = EXT_ERRORS;
+    }
+    return run->exceeded != NULL || run->diverged != NULL;
+}
+
+/**
+ * Wait until some of the running tests produce output, exit or run out of
+ * time. Output is read into captures of the runs without blocking, so that
+ * programs are never stuck on a full pipe. Programs are collected by their
+ * pid. Once the program exited, the output left in the pipes is read and
+ * they are closed, processes started by the program may still hold them
+ * open. If a deadline passes, whole process group of the program is
+ * killed and the run is finished without waiting for the output to close.
+ * The same happens when an output goes over the limit or a streamed output
+ * differs from the expected one.
+ *
+ * @param runs  array of runs that may be running
+ * @param len   length of the array
+ * @return number of runs that finished
+ */
+static size_t test_context_supervise(TestRun *runs, size_t len)
+{
+    struct pollfd *fds;
+    size_t i, num = 0, finished = 0;
+    int wait_ms = -1, ms;
+    double left, now = monotonic_time();
+    TestRun *run;
+
+    fds = calloc(3 * len, sizeof(struct pollfd));
+    for (i = 0; i < len; i++) {
+        run = &runs[i];
+        if (run->finished) continue;
+        add_pollfd(fds, &num, capture_get_read_fd(run->out));
+        add_pollfd(fds, &num, capture_get_read_fd(run->err));
+        add_pollfd(fds, &num, run->pidfd);
+        ms = -1;
+        if (run->deadline > 0) {
+            left = run->deadline - now;
+            ms = left <= 0 ? 0 : left > INT_MAX / 1000 ? INT_MAX : left * 1000 + 1;
+        }
+        if (!run->reaped && run->pidfd < 0 && (ms < 0 || ms > WAIT_INTERVAL)) {
+            ms = WAIT_INTERVAL;
+        }
+        if (ms >= 0 && (wait_ms < 0 || ms < wait_ms)) {
+            wait_ms = ms;
+        }
+    }
+
+    if (poll(fds, num, wait_ms) < 0 && errno != EINTR) {
+        perror("poll");
+        exit(EXIT_FAILURE);
+    }
+    free(fds);
+
+    now = monotonic_time();
+    for (i = 0; i < len; i++) {
+        run = &runs[i];
+        if (run->finished) continue;
+        if (capture_get_read_fd(run->out) >= 0) capture_read(run->out);
+        if (capture_get_read_fd(run->err) >= 0) capture_read(run->err);
+        if (!run->reaped) {
+            test_run_reap(run, 0);
+        }
+        if (run->reaped) {
+            capture_drain(run->out);
+            capture_drain(run->err);
+        }
+        if (!run->timed_out && !run->diverged && !run->exceeded
+                && test_run_check_outputs(run)) {
+            /* The program can not be killed once it was collected, its pid
+             * could be reused. */
+            if (!run->reaped) {
+                kill(run->timeout > 0 ? -run->pid : run->pid, SIGKILL);
+            }
+            capture_close(run->out);
+            capture_close(run->err);
+            if (!run->reaped) {
+                test_run_reap(run, 1);
+            }
+        }
+        if (run->deadline > 0 && now >= run->deadline && !run->timed_out
+                && !run->diverged && !run->exceeded) {
+            kill(-run->pid, SIGKILL);
+            run->timed_out = 1;
+            capture_close(run->out);
+            capture_close(run->err);
+            if (!run->reaped) {
+                test_run_reap(run, 1);
+            }
+        }
+        if (run->reaped && RUN_OUTPUT_CLOSED(run)) {
+            if (run->pidfd >= 0) close(run->pidfd);
+            run->finished = 1;
+            finished++;
+        }
+    }
+
+    return finished;
+}
+
+/**
+ * Report a test that was killed for running out of time. Running out of time
+ * counts as a failed check.
+ *
+ * @param tc    test context
+ * @param run   finished run
+ */
+static void
+test_context_report_timeout(TestContext *tc, TestRun *run)
+{
+    tc->test_num++;
+    tc->timed_out++;
+    tc->check_num++;
+    tc->check_failed++;
+    test_context_print_color(tc, RED, "T");
+    tc->result.reason = str_printf("killed after time limit of %g seconds",
+            run->timeout);
+    test_result_add_check(&tc->result, EXT_TIMEOUT, 0, tc->result.reason);
+    tc->result.status = RESULT_TIMED_OUT;
+    oqueue_pushf(tc->logs, "Test %s failed:\n%s\n\n",
+            str_to_bold(run->test->name), tc->result.reason);
+}
+
+/**
+ * Report a test that wrote more output than allowed. Only part of the
+ * output was kept, so nothing else is checked.
+ *
+ * @param tc    test context
+ * @param run   finished run
+ */
+static void
+test_context_report_output_limit(TestContext *tc, TestRun *run)
+{
+    tc->test_num++;
+    tc->check_num++;
+    tc->check_failed += test_context_handle_result(tc, run->test,
+            EXT_OUTPUT_LIMIT, 0,
+            "output limit exceeded, std%s reached %zu bytes with limit of"
+            " %zu\n\n", run->exceeded, run->exceeded_size,
+            run->output_limit);
+}
+
+/**
+ * Report a test whose output differed from the expected one while it ran.
+ * The program was killed, so nothing else is checked.
+ *
+ * @param tc    test context
+ * @param run   finished run
+ */
+static void
+test_context_report_divergence(TestContext *tc, TestRun *run)
+{
+    const char *expected, *end, *p;
+    size_t line = 1;
+
+    if (strcmp(run->diverged, EXT_OUTPUT) == 0) {
+        expected = run->expected_out;
+        end = expected + run->expected_out_len;
+    } else {
+        expected = run->expected_err;
+        end = expected + run->expected_err_len;
+    }
+    if (run->diverged_at < (size_t) (end - expected)) {
+        end = expected + run->diverged_at;
+    }
+    for (p = expected; (p = memchr(p, '\n', end - p)) != NULL; p++) {
+        line++;
+    }
+
+    tc->test_num++;
+    tc->check_num++;
+    tc->check_failed += test_context_handle_result(tc, run->test,
+            run->diverged, 0,
+            "std%s differs from line %zu, the program was killed\n\n",
+            run->diverged, line);
+}
+
+/**
+ * Print one row of benchmark results.
+ */
+static void
+print_bench_row(const char *name, const char *what, const Stats *st)
+{
+    printf("%-24s %-4s %5zu %10.6f %10.6f %10.6f %10.6f %10.6f\n",
+            name, what, st->n, st->min, st->median, st->mean, st->p95,
+            st->stddev);
+}
+
+/**
+ * Compare wall clock times of a test with the baseline. The test regressed if
+ * its median grew by more than the threshold and Mann-Whitney U test says the
+ * difference is significant. Each test found in the baseline counts as one
+ * check.
+ *
+ * @param tc        test context
+ * @param test      benchmarked test
+ * @param samples   measured wall clock times
+ * @param len       number of samples
+ */
+static void
+test_context_compare_baseline(TestContext *tc, Test *test,
+                              const double *samples, size_t len)
+{
+    const double *base;
+    double *copy, p, change;
+    char *msg;
+    size_t base_len;
+    Stats before, after;
+
+    base = baseline_find(tc->baseline, test->name, &base_len);
+    if (base == NULL || base_len == 0 || len == 0) {
+        return;
+    }
+
+    p = stats_mann_whitney(base, base_len, samples, len);
+    copy = malloc((base_len > len ? base_len : len) * sizeof(double));
+    memcpy(copy, base, base_len * sizeof(double));
+    stats_compute(copy, base_len, &before);
+    memcpy(copy, samples, len * sizeof(double));
+    stats_compute(copy, len, &after);
+    free(copy);
+
+    change = before.median > 0 ? 100 * (after.median / before.median - 1) : 0;
+    if (!TC_IS_QUIET(tc)) {
+        print_bench_row("", "base", &before);
+        printf("%-24s %-4s %+.1f%% (p = %.3g)\n", "", "diff", change, p);
+    }
+
+    tc->check_num++;
+    if (p < SIGNIFICANCE_LEVEL && change > tc->threshold) {
+        tc->check_failed++;
+        msg = str_printf("median wall clock time %.6f seconds is %.1f%% above"
+                " baseline %.6f seconds (p = %.3g)", after.median, change,
+                before.median, p);
+        test_result_add_check(&tc->result, "baseline", 0, msg);
+        oqueue_pushf(tc->logs, "Test %s failed:\n%s\n\n",
+                str_to_bold(test->name), msg);
+        free(msg);
+    } else {
+        test_result_add_check(&tc->result, "baseline", 1, NULL);
+    }
+}
+
+/**
+ * Record times of a finished run in benchmark mode. Warmup runs and runs that
+ * did not exit normally are not measured. After the last run of a test, its
+ * statistics are printed.
+ *
+ * @param tc    test context
+ * @param run   finished run
+ */
+static void
+test_context_bench_sample(TestContext *tc, TestRun *run)
+{
+    double *copy;
+    Stats st;
+
+    if (run->iteration >= tc->warmup_runs && run->reaped && !run->timed_out
+            && WIFEXITED(run->status)) {
+        tc->bench_wall[tc->bench_len] = run->usage.wall;
+        tc->bench_cpu[tc->bench_len] = run->usage.user + run->usage.sys;
+        tc->bench_len++;
+    }
+    if (run->iteration + 1 < tc->warmup_runs + tc->bench_runs) {
+        return;
+    }
+
+    if (tc->new_baseline) {
+        baseline_add(tc->new_baseline, run->test->name, tc->bench_wall,
+                tc->bench_len);
+    }
+    if (!TC_IS_QUIET(tc)) {
+        /* Wall clock times are still needed in original form. */
+        copy = malloc((tc->bench_len ? tc->bench_len : 1) * sizeof(double));
+        memcpy(copy, tc->bench_wall, tc->bench_len * sizeof(double));
+        stats_compute(copy, tc->bench_len, &st);
+        print_bench_row(run->test->name, "wall", &st);
+        stats_compute(tc->bench_cpu, tc->bench_len, &st);
+        print_bench_row("", "cpu", &st);
+        free(copy);
+    }
+    if (tc->baseline) {
+        test_context_compare_baseline(tc, run->test, tc->bench_wall,
+                tc->bench_len);
+    }
+    tc->bench_len = 0;
+}
 
-    unlink(out_file);
-    unlink(err_file);
-    if (mem_file) {
-        unlink(mem_file);
-        free(mem_file);
+/**
+ * Write actual output of a program as the expected one, if it differs.
+ *
+ * @param tc        test context
+ * @param test      the test
+ * @param ext       extension of the file
+ * @param actual    what the program wrote
+ * @param len       length of the output
+ * @return 1 if the file was written, 0 if it is unchanged, -1 on failure
+ */
+static int
+test_context_update_file(TestContext *tc, Test *test, const char *ext,
+                         const char *actual, size_t len)
+{
+    const char *expected;
+    size_t expected_len = 0;
+    int same;
+
+    expected = test_get_data(test, ext, &expected_len);
+    same = expected != NULL && expected_len == len
+           && memcmp(expected, actual, len) == 0;
+    test_release_data(test, expected, expected_len);
+    if (same) {
+        return 0;
+    }
+    if (!test_set_data(test, ext, actual, len)) {
+        tc->check_num++;
+        tc->check_failed += test_context_handle_result(tc, test, ext, 0,
+                "can not update %s file: %s\n\n", ext, strerror(errno));
+        return -1;
     }
+    return 1;
+}
+
+/**
+ * Store outputs and exit code of a program that exited as the expected ones.
+ * Only files the test already has are written and only those whose content
+ * changed. Updated tests are listed in the log.
+ *
+ * @param tc    test context
+ * @param run   finished run
+ */
+static void
+test_context_update_test(TestContext *tc, TestRun *run)
+{
+    Test *test = run->test;
+    const char *data, *updated[3];
+    unsigned int num = 0, i;
+    size_t len;
+    char *str;
+    int code = WEXITSTATUS(run->status);
+
+    if (FLAG_SET(test->parts, TEST_OUTPUT)) {
+        data = capture_get_data(run->out, &len);
+        if (test_context_update_file(tc, test, EXT_OUTPUT, data, len) > 0) {
+            updated[num++] = EXT_OUTPUT;
+        }
+    }
+    if (FLAG_SET(test->parts, TEST_ERRORS)) {
+        data = capture_get_data(run->err, &len);
+        if (test_context_update_file(tc, test, EXT_ERRORS, data, len) > 0) {
+            updated[num++] = EXT_ERRORS;
+        }
+    }
+    /* The exit code is compared by value, not by formatting of the file. */
+    if (FLAG_SET(test->parts, TEST_RETVAL)
+            && test_get_exit_code(test) != code) {
+        str = str_printf("%d\n", code);
+        if (test_context_update_file(tc, test, EXT_RETVAL, str,
+                    strlen(str)) > 0) {
+            updated[num++] = EXT_RETVAL;
+        }
+        free(str);
+    }
+    if (num == 0) {
+        return;
+    }
+    tc->updated_tests++;
+    tc->updated_files += num;
+    oqueue_pushf(tc->logs, "Updated %s:", str_to_bold(test->name));
+    for (i = 0; i < num; i++) {
+        oqueue_pushf(tc->logs, " %s", updated[i]);
+    }
+    oqueue_push(tc->logs, "\n\n");
+}
+
+/**
+ * Analyze results of a finished test and release all resources held by the
+ * run.
+ *
+ * @param tc    test context
+ * @param run   finished run
+ */
+static void test_context_finish_test(TestContext *tc, TestRun *run)
+{
+    List *tmp;
+
+    if (run->reaped) {
+        run->test->usage = run->usage;
+        run->test->has_usage = 1;
+    }
+    if (run->iteration == 0) {
+        test_result_reset(&tc->result, run->test);
+    }
+
+    if (run->iteration > 0) {
+        /* Only the first run of a benchmarked test is checked. */
+    } else if (run->cached) {
+        test_context_print_color(tc, GREEN, ",");
+        tc->result.status = RESULT_CACHED;
+        tc->cached++;
+    } else if (run->skip_msg) {
+        test_context_skip(tc, run->test, run->skip_msg);
+    } else if (run->timed_out) {
+        test_context_report_timeout(tc, run);
+    } else if (run->exceeded) {
+        test_context_report_output_limit(tc, run);
+    } else if (run->diverged) {
+        test_context_report_divergence(tc, run);
+    } else {
+        if (tc->update && WIFEXITED(run->status)) {
+            test_context_update_test(tc, run);
+        }
+        test_context_analyze_test_run(tc, run->test, run->out, run->err,
+                run->mem_file, run->status);
+    }
+    if (tc->cache && !run->cached && !run->skip_msg) {
+        cache_update(tc->cache, run->test->name, run->key,
+                tc->result.status == RESULT_PASSED);
+    }
+    if (tc->history && run->iteration == 0 && !run->skip_msg) {
+        /* Durations under a memory checker would spoil the history. */
+        history_record(tc->history, run->test->name, run->files,
+                tc->result.status != RESULT_PASSED
+                && tc->result.status != RESULT_CACHED,
+                run->reaped && tc->memory == MEMORY_NONE
+                ? run->usage.wall : -1);
+    }
+    if (tc->bench_runs > 0) {
+        test_context_bench_sample(tc, run);
+    }
+    if (run->iteration + 1 == TC_RUNS_PER_TEST(tc)) {
+        for (tmp = tc->reporters; tmp != NULL; tmp = tmp->next) {
+            reporter_add(tmp->data, &tc->result);
+        }
+    }
+
+    test_release_data(run->test, run->expected_out, run->expected_out_len);
+    test_release_data(run->test, run->expected_err, run->expected_err_len);
+    str_array_free(run->args);
+    capture_free(run->out);
+    capture_free(run->err);
+    str_array_free(run->env);
+    if (run->mem_file) {
+        if (tc->memory == MEMORY_ASAN) {
+            remove_sanitizer_dir(run->mem_file);
+        } else {
+            unlink(run->mem_file);
+        }
+        free(run->mem_file);
+    }
+}
+
+/**
+ * Print a table with resources used by tests.
+ *
+ * @param title     heading of the table
+ * @param tests     tests to be listed, all of them must have usage
+ * @param len       number of tests
+ */
+static void
+print_usage_table(const char *title, Test **tests, size_t len)
+{
+    TestUsage *u;
+    size_t i;
+
+    printf("%s:\n%8s %8s %8s %9s %7s %8s %7s %7s  %s\n", title,
+            "wall", "user", "system", "RSS(KiB)", "major", "minor",
+            "vol", "invol", "test");
+    for (i = 0; i < len; i++) {
+        u = &tests[i]->usage;
+        printf("%8.3f %8.3f %8.3f %9ld %7ld %8ld %7ld %7ld  %s\n",
+                u->wall, u->user, u->sys, u->max_rss, u->major_faults,
+                u->minor_faults, u->voluntary_switches,
+                u->involuntary_switches, tests[i]->name);
+    }
+    printf("\n");
+}
+
+static int
+compare_wall_time(const void *a, const void *b)
+{
+    const TestUsage *x = &(*(Test * const *) a)->usage;
+    const TestUsage *y = &(*(Test * const *) b)->usage;
+    return (x->wall < y->wall) - (x->wall > y->wall);
+}
+
+static int
+compare_max_rss(const void *a, const void *b)
+{
+    const TestUsage *x = &(*(Test * const *) a)->usage;
+    const TestUsage *y = &(*(Test * const *) b)->usage;
+    return (x->max_rss < y->max_rss) - (x->max_rss > y->max_rss);
+}
+
+/**
+ * Report resources used by executed tests. In verbose mode all tests are
+ * listed, the lists of slowest and most memory hungry tests are printed when
+ * requested by test_context_set_top().
+ *
+ * @param tc    test context
+ * @param tests list of tests that were run
+ */
+static void
+test_context_report_usage(TestContext *tc, List *tests)
+{
+    Test **measured;
+    List *tmp;
+    size_t len = 0;
+
+    if (tc->verbose != MODE_VERBOSE && tc->top == 0) {
+        return;
+    }
+
+    for (tmp = tests; tmp != NULL; tmp = tmp->next) {
+        len++;
+    }
+    measured = calloc(len, sizeof(Test *));
+    len = 0;
+    for (tmp = tests; tmp != NULL; tmp = tmp->next) {
+        if (((Test *) tmp->data)->has_usage) {
+            measured[len++] = tmp->data;
+        }
+    }
+
+    if (tc->verbose == MODE_VERBOSE) {
+        print_usage_table("Resource usage", measured, len);
+    }
+    if (tc->top > 0) {
+        qsort(measured, len, sizeof(Test *), compare_wall_time);
+        print_usage_table("Slowest tests", measured,
+                len < tc->top ? len : tc->top);
+        qsort(measured, len, sizeof(Test *), compare_max_rss);
+        print_usage_table("Most memory hungry tests", measured,
+                len < tc->top ? len : tc->top);
+    }
+    free(measured);
 }
 
 unsigned int
 test_context_run_tests(TestContext *tc, List *tests)
 {
-    struct timeval ta, tb, res;
+    TestRun *runs;
+    List *tmp;
+    size_t len = 0, started = 0, reported = 0, running = 0;
+    unsigned int i, per_test = TC_RUNS_PER_TEST(tc), jobs = tc->jobs;
+    double start, elapsed;
+    ReportSummary summary;
+
+    /* Benchmarked runs would compete for processors and caches. */
+    if (tc->bench_runs > 0) {
+        jobs = 1;
+    }
 
-    gettimeofday(&ta, NULL);
-    list_foreach(tests, CBFUNC(test_context_run_test), tc);
-    gettimeofday(&tb, NULL);
-    time_difference(&tb, &ta, &res);
+    for (tmp = tests; tmp != NULL; tmp = tmp->next) {
+        len += per_test;
+    }
+    for (tmp = tc->reporters; tmp != NULL; tmp = tmp->next) {
+        reporter_begin(tmp->data, len / per_test);
+    }
+    runs = calloc(len, sizeof(TestRun));
+    for (tmp = tests; tmp != NULL; tmp = tmp->next) {
+        for (i = 0; i < per_test; i++) {
+            runs[started].iteration = i;
+            runs[started++].test = tmp->data;
+        }
+    }
+    started = 0;
+
+    if (tc->cache) {
+        tc->cmd_hash = cache_hash_file(CACHE_HASH_INIT, tc->cmd);
+    }
+    if (tc->save_path) {
+        baseline_free(tc->new_baseline);
+        tc->new_baseline = baseline_new();
+    }
+    if (tc->bench_runs > 0 && !TC_IS_QUIET(tc)) {
+        printf("%-24s %-4s %5s %10s %10s %10s %10s %10s\n", "test", "time",
+                "runs", "min", "median", "mean", "p95", "stddev");
+    }
+
+    start = monotonic_time();
+    while (reported < len) {
+        while (running < jobs && started < len) {
+            running += test_context_start_test(tc, &runs[started++]);
+        }
+        /* Results are processed strictly in the order of tests. */
+        while (reported < started && runs[reported].finished) {
+            test_context_finish_test(tc, &runs[reported++]);
+        }
+        if (running > 0) {
+            running -= test_context_supervise(runs + reported,
+                                              started - reported);
+        }
+    }
+    elapsed = monotonic_time() - start;
+    free(runs);
+    for (tmp = tc->reporters; tmp != NULL; tmp = tmp->next) {
+        reporter_end(tmp->data, elapsed);
+    }
+
+    if (tc->new_baseline) {
+        baseline_save(tc->new_baseline, tc->save_path);
+    }
+    if (tc->cache) {
+        cache_save(tc->cache);
+    }
+    if (tc->history) {
+        history_save(tc->history);
+    }
 
     if (!TC_IS_QUIET(tc)) {
-        printf("\n\n");
+        printf(tc->bench_runs > 0 ? "\n" : "\n\n");
         oqueue_flush(tc->logs, stdout);
-        printf("%u tests, %u crashes, %u skipped, %u checks, %u failed"
-               " (%ld.%03ld seconds)\n",
-                tc->test_num, tc->crashed, tc->skipped, tc->check_num,
-                tc->check_failed, res.tv_sec, res.tv_usec / 1000);
+        if (tc->update) {
+            printf("Updated %u files of %u tests\n\n", tc->updated_files,
+                    tc->updated_tests);
+        }
+        test_context_report_usage(tc, tests);
+        summary.tests = tc->test_num;
+        summary.crashed = tc->crashed;
+        summary.timed_out = tc->timed_out;
+        summary.skipped = tc->skipped;
+        summary.cached = tc->cached;
+        summary.checks = tc->check_num;
+        summary.failed = tc->check_failed;
+        summary.time = elapsed;
+        report_summary_print(&summary);
     }
     return tc->check_failed;
 }
@@ -3,6 +3,7 @@
 
 #include <config.h>
 
+#include "history.h"
 #include "list.h"
 
 typedef enum {
@@ -11,6 +12,17 @@ typedef enum {
     MODE_VERBOSE
 } VerbosityMode;
 
+/**
+ * How memory errors of tested programs are detected.
+ */
+typedef enum {
+    MEMORY_NONE,
+    /** run the program under Valgrind */
+    MEMORY_VALGRIND,
+    /** read reports of sanitizers the program was built with */
+    MEMORY_ASAN
+} MemoryChecker;
+
 typedef struct test_context_t TestContext;
 
 /**
@@ -32,19 +44,180 @@ TestContext * test_context_new(void);
 int test_context_set_command(TestContext *tc, const char *cmd);
 
 /**
- * Use Valgrind tool in the context.
+ * Check memory errors of tested programs. With MEMORY_ASAN, the program has
+ * to be built with AddressSanitizer or UndefinedBehaviorSanitizer, their
+ * reports are redirected by ASAN_OPTIONS, LSAN_OPTIONS and UBSAN_OPTIONS
+ * to a directory of each run.
+ *
+ * @param tc        test context to modify
+ * @param checker   how to detect memory errors
+ */
+void test_context_set_memory_checker(TestContext *tc, MemoryChecker checker);
+
+/**
+ * Set custom options for comparing outputs. The string is parsed as diff(1)
+ * command line options, but only options understood by the built-in diff
+ * are accepted. If some option is not supported, the function prints error
+ * message and returns zero.
+ *
+ * @param tc        test context to modify
+ * @param opts      diff(1) options
+ * @return 1 if ok, 0 if options are not supported
+ */
+int test_context_set_diff_opts(TestContext *tc, const char *opts);
+
+/**
+ * Set how many tests can run at the same time. Results are still reported in
+ * the order of tests.
+ *
+ * @param tc        test context to modify
+ * @param jobs      maximal number of simultaneously running tests
+ */
+void test_context_set_jobs(TestContext *tc, unsigned int jobs);
+
+/**
+ * Set time limit for each test. Tests running longer are killed together
+ * with all processes they started and reported as failed. Tests with a
+ * .timeout file use the limit from the file instead.
+ *
+ * @param tc        test context to modify
+ * @param timeout   time limit in seconds, zero for no limit
+ */
+void test_context_set_timeout(TestContext *tc, double timeout);
+
+/**
+ * Set limit of each output of a program. When a program writes more to
+ * stdout or stderr, it is killed and the test fails. Tests with a .outlimit
+ * file use the limit from the file instead. The default is 1 GiB.
+ *
+ * @param tc        test context to modify
+ * @param limit     maximum size in bytes, zero for no limit
+ */
+void test_context_set_output_limit(TestContext *tc, size_t limit);
+
+/**
+ * Compare outputs with the expected ones while the program runs. When the
+ * output differs or gets longer than expected, the program is killed and
+ * the test fails without waiting for the rest of the output. Outputs are
+ * only streamed when diff options do not change how lines are compared,
+ * stderr is not streamed under a memory checker.
+ *
+ * @param tc        test context to modify
+ * @param stream    whether to stream outputs
+ */
+void test_context_set_stream(TestContext *tc, int stream);
+
+/**
+ * Write actual outputs and exit codes of programs as the expected ones.
+ * Files of parts the test already has are replaced atomically when their
+ * content differs, the tests are then checked against the new content.
+ * Programs that crash, time out or exceed the output limit are not used.
+ * Outputs are never streamed in this mode.
+ *
+ * @param tc        test context to modify
+ * @param update    whether to update expected outputs
+ */
+void test_context_set_update(TestContext *tc, int update);
+
+/**
+ * Set how many of the slowest and most memory hungry tests are listed after
+ * all tests are run.
+ *
+ * @param tc    test context to modify
+ * @param top   number of tests in each list, zero to disable the lists
+ */
+void test_context_set_top(TestContext *tc, unsigned int top);
+
+/**
+ * Switch to benchmark mode. Each test is run warmup + runs times, only the
+ * first run is checked. Instead of results of the checks, statistics of wall
+ * clock and CPU time of the measured runs are printed for each test.
+ *
+ * @param tc        test context to modify
+ * @param runs      number of measured runs, zero to disable benchmark mode
+ * @param warmup    number of runs that are not measured
+ */
+void test_context_set_bench(TestContext *tc, unsigned int runs,
+                            unsigned int warmup);
+
+/**
+ * Load baseline to compare benchmark results with. Tests that got slower
+ * than in the baseline count as failed checks. If the file can not be
+ * loaded, error message is printed and zero returned.
+ *
+ * @param tc        test context to modify
+ * @param path      file with baseline
+ * @return 1 if ok, 0 on failure
+ */
+int test_context_set_compare_baseline(TestContext *tc, const char *path);
+
+/**
+ * Set by how many percent median wall clock time of a test may grow before
+ * it is reported as a regression. The default is 5 %.
+ *
+ * @param tc        test context to modify
+ * @param threshold allowed growth in percent
+ */
+void test_context_set_threshold(TestContext *tc, double threshold);
+
+/**
+ * Save wall clock times measured in benchmark mode to a file, so that they
+ * can be used as a baseline later.
+ *
+ * @param tc        test context to modify
+ * @param path      where to save the baseline
+ */
+void test_context_set_save_baseline(TestContext *tc, const char *path);
+
+/**
+ * Add reporter writing results of tests in machine readable format. The
+ * specification is FORMAT:FILE, where FORMAT is junit, tap or jsonl and FILE
+ * is the path to write to, or a dash for standard output. On failure, error
+ * message is printed and zero returned.
+ *
+ * @param tc        test context to modify
+ * @param spec      format and file of the report
+ * @return 1 if ok, 0 on failure
+ */
+int test_context_add_reporter(TestContext *tc, const char *spec);
+
+/**
+ * Skip tests that passed before, as recorded in the cache file at path. The
+ * cache is updated with results of executed tests.
+ *
+ * @param tc        test context to modify
+ * @param path      file with the cache, it does not need to exist
+ */
+void test_context_set_cache(TestContext *tc, const char *path);
+
+/**
+ * Record outcome and duration of each executed test in history. The
+ * history is saved after all tests finish.
+ *
+ * @param tc        test context to modify
+ * @param history   history to update (transfer full)
+ */
+void test_context_set_history(TestContext *tc, History *history);
+
+/**
+ * Set path to Valgrind used with MEMORY_VALGRIND. The
+ * default is found by configure.
  *
  * @param tc        test context to modify
+ * @param path      path to the valgrind program
  */
-void test_context_set_use_valgrind(TestContext *tc);
+void test_context_set_valgrind(TestContext *tc, const char *path);
 
 /**
- * Set custom options to underlying diff.
+ * Set options passed to Valgrind, they replace the default
+ * --tool=memcheck --leak-check=full. The options are split the same way as
+ * arguments of tests. Any tool producing XML output can be used.
  *
  * @param tc        test context to modify
- * @param diff_opts option string passed to diff (allow-none)
+ * @param flags     options for Valgrind
+ * @return 1 if ok, 0 if options can not be parsed
  */
-void test_context_set_diff_opts(TestContext *tc, const char *opts);
+int test_context_set_valgrind_flags(TestContext *tc, const char *flags);
 
 /**
  * Set verbosity level.
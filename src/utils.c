@@ -1,16 +1,16 @@
 #include <config.h>
 
 #include "list.h"
+#include "scan.h"
 #include "utils.h"
 
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
-
-int number_sort_wrap(const struct dirent **entry1, const struct dirent **entry2)
-{
-    return number_sort((*entry1)->d_name, (*entry2)->d_name);
-}
+#include <sys/stat.h>
+#include <time.h>
 
 int number_sort(const char *name1, const char *name2)
 {
@@ -22,11 +22,6 @@ int number_sort(const char *name1, const char *name2)
     return num1 - num2;
 }
 
-int filter_tests_wrap(const struct dirent *entry)
-{
-    return filter_tests(entry->d_name);
-}
-
 int filter_tests(const char *name)
 {
     int digits = 0;
@@ -41,9 +36,7 @@ int filter_tests(const char *name)
 
 unsigned int count_lines(const char *buffer, int len)
 {
-    unsigned int num = 0;
-    while ((len--) > 0) if (*(buffer++) == '\n') num++;
-    return num;
+    return len > 0 ? scan_count_newlines(buffer, len) : 0;
 }
 
 void print_color(const char *color, const char *str)
@@ -59,7 +52,8 @@ void print_color(const char *color, const char *str)
 TestPart get_test_part(const char *filename)
 {
     static const char *extensions[] = { EXT_INPUT, EXT_OUTPUT,
-        EXT_ARGS, EXT_ERRORS, EXT_RETVAL, NULL };
+        EXT_ARGS, EXT_ERRORS, EXT_RETVAL, EXT_TIMEOUT, EXT_TIME, EXT_RSS,
+        EXT_OUTPUT_LIMIT, NULL };
     char *ext;
     int i;
 
@@ -90,25 +84,130 @@ char * get_filepath(const char *dir, const char *fname, const char *ext)
     return path;
 }
 
+/**
+ * Size of buffer used by count_lines_on_fd(), large enough for the counting
+ * to outweigh the reads.
+ */
+#define COUNT_BUFFER_SIZE (64 * 1024)
+
 size_t count_lines_on_fd(int source)
 {
-    char buffer[1024];
+    char *buffer = malloc(COUNT_BUFFER_SIZE);
     ssize_t len;
     size_t lines = 0;
 
-    while ((len = read(source, buffer, 1024)) > 0) {
-        lines += count_lines(buffer, len);
+    while ((len = read(source, buffer, COUNT_BUFFER_SIZE)) > 0) {
+        lines += scan_count_newlines(buffer, len);
     }
+    free(buffer);
 
     return lines;
 }
 
+char * read_file(const char *path, size_t *len)
+{
+    struct stat info;
+    char *buffer = NULL;
+    size_t size = 0;
+    ssize_t n;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    return_val_if_fail(fd >= 0, NULL);
+
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        size = info.st_size;
+    }
+    buffer = malloc(size + 1);
+    *len = 0;
+    while ((n = read(fd, buffer + *len, size - *len)) > 0) {
+        *len += n;
+        if (*len == size) {
+            size = size * 2 + 1024;
+            buffer = realloc(buffer, size + 1);
+        }
+    }
+    close(fd);
+    if (n < 0) {
+        free(buffer);
+        return NULL;
+    }
+    buffer[*len] = '\0';
+    return buffer;
+}
+
+int write_file(const char *path, const char *data, size_t len)
+{
+    struct stat info;
+    char *tmp = str_printf("%s.XXXXXX", path);
+    size_t done = 0;
+    ssize_t n;
+    mode_t mask;
+    int fd, ok, saved;
+
+    fd = mkstemp(tmp);
+    if (fd < 0) {
+        free(tmp);
+        return 0;
+    }
+    /* The temporary file is only readable by the owner, a new file gets
+     * the mode open(2) would give it. */
+    if (stat(path, &info) == 0) {
+        ok = fchmod(fd, info.st_mode & 07777) == 0;
+    } else {
+        mask = umask(0);
+        umask(mask);
+        ok = fchmod(fd, 0666 & ~mask) == 0;
+    }
+    while (ok && done < len) {
+        n = write(fd, data + done, len - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        ok = n > 0;
+        done += ok ? n : 0;
+    }
+    /* Data must reach the disk before the rename does, otherwise a crash
+     * can leave an empty file. */
+    ok = ok && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    ok = ok && rename(tmp, path) == 0;
+    if (!ok) {
+        saved = errno;
+        unlink(tmp);
+        errno = saved;
+    }
+    free(tmp);
+    return ok;
+}
+
 /**
  * Make s point to next character. If that character is terminating '\0',
  * go to out label.
  */
 #define try_inc_string(s) do { s++; if (*s == '\0') goto out; } while (0)
 
+long long parse_size(const char *str)
+{
+    double size;
+    char *end;
+
+    size = strtod(str, &end);
+    if (end == str || !(size >= 0)) {
+        return -1;
+    }
+    switch (*end) {
+    case 'G': case 'g': size *= 1024;   /* fall through */
+    case 'M': case 'm': size *= 1024;   /* fall through */
+    case 'K': case 'k': size *= 1024;   end++; break;
+    }
+    while (isspace((unsigned char) *end)) {
+        end++;
+    }
+    /* Anything bigger does not fit into the result. */
+    return *end == '\0' && size < 9e18 ? (long long) size : -1;
+}
+
 char ** parse_args(const char *str, size_t *len)
 {
     char **array;
@@ -175,19 +274,6 @@ out:
     return NULL;
 }
 
-int get_num_errors(FILE *fh, int *errors, int *contexts)
-{
-    char c;
-
-    fseek(fh, -40, SEEK_END);
-    do {
-        c = fgetc(fh);
-        fseek(fh, -2, SEEK_CUR);
-    } while (c != 'Y');
-    fseek(fh, 3, SEEK_CUR);
-    return fscanf(fh, " %d errors from %d", errors, contexts) == 2;
-}
-
 #define MAXLEN 512
 const char * str_to_bold(const char *str)
 {
@@ -219,3 +305,39 @@ void time_difference(struct timeval *a, struct timeval *b, struct timeval *res)
         res->tv_usec += 1000000;
     }
 }
+
+char * str_vprintf(const char *fmt, va_list ap)
+{
+    va_list ap_copy;
+    char *str;
+    int len;
+
+    va_copy(ap_copy, ap);
+    len = vsnprintf(NULL, 0, fmt, ap_copy);
+    va_end(ap_copy);
+    if (len < 0) {
+        return strdup("");
+    }
+    str = malloc(len + 1);
+    vsnprintf(str, len + 1, fmt, ap);
+    return str;
+}
+
+char * str_printf(const char *fmt, ...)
+{
+    va_list ap;
+    char *str;
+
+    va_start(ap, fmt);
+    str = str_vprintf(fmt, ap);
+    va_end(ap);
+    return str;
+}
+
+double monotonic_time(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
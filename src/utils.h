@@ -5,6 +5,7 @@
 
 #include <dirent.h>
 #include <stdio.h>
+#include <stdarg.h>
 #include <sys/time.h>
 
 /**
@@ -12,12 +13,6 @@
  */
 int number_sort(const char *name1, const char *name2);
 
-/**
- * Wrapper around number_sort() that extracts filenames from pointers to
- * pointers to dirent structure.
- */
-int number_sort_wrap(const struct dirent **entry1, const struct dirent **entry2);
-
 /**
  * Test whether particular filename is a test definition - that is, whether
  * it starts with at least one digit.
@@ -27,11 +22,6 @@ int number_sort_wrap(const struct dirent **entry1, const struct dirent **entry2)
  */
 int filter_tests(const char *name);
 
-/**
- * Wrapper around filter_tests that takes pointer to dirent structure.
- */
-int filter_tests_wrap(const struct dirent *entry);
-
 /**
  * Count number of lines in given string.
  *
@@ -107,6 +97,14 @@ typedef enum {
     TEST_ERRORS = 2 << 3,
     /** Expected exit value of the program */
     TEST_RETVAL = 2 << 4,
+    /** Time limit for the program */
+    TEST_TIMEOUT = 2 << 5,
+    /** Maximum wall clock and CPU time the program may use */
+    TEST_TIME   = 2 << 6,
+    /** Maximum resident memory the program may use */
+    TEST_RSS    = 2 << 7,
+    /** Maximum size of each output of the program */
+    TEST_OUTPUT_LIMIT = 2 << 8,
     /** Falback value for unknown test type */
     TEST_UNKNOWN
 } TestPart;
@@ -119,6 +117,10 @@ typedef enum {
 #define EXT_ARGS    "args"
 #define EXT_ERRORS  "err"
 #define EXT_RETVAL  "ret"
+#define EXT_TIMEOUT "timeout"
+#define EXT_TIME    "time"
+#define EXT_RSS     "rss"
+#define EXT_OUTPUT_LIMIT "outlimit"
 
 /**
  * Find out which test part is stored in given file.
@@ -148,6 +150,39 @@ char * get_filepath(const char *dir, const char *fname, const char *ext);
  */
 size_t count_lines_on_fd(int source);
 
+/**
+ * Read whole contents of a file into memory. The returned buffer is always
+ * terminated by a zero byte, which is not included in the length. Caller is
+ * responsible for freeing the memory.
+ *
+ * @param path  file to be read
+ * @param len   where to store length of the contents (out)
+ * @return contents of the file or NULL on failure
+ */
+char * read_file(const char *path, size_t *len);
+
+/**
+ * Replace contents of a file. The data are written to a temporary file in
+ * the same directory, which is then renamed over the original, so that the
+ * file is never left partially written, not even after a crash. Permissions
+ * of an existing file are kept, a new file gets 0666 without umask.
+ *
+ * @param path  file to be written
+ * @param data  new contents
+ * @param len   length of the contents
+ * @return 1 on success, 0 on failure with errno set
+ */
+int write_file(const char *path, const char *data, size_t len);
+
+/**
+ * Parse size in bytes, which can be followed by K, M or G suffix for
+ * multiples of 1024. Trailing white space is ignored.
+ *
+ * @param str   string to be parsed
+ * @return the size or -1 if the string is malformed
+ */
+long long parse_size(const char *str);
+
 /**
  * Parse string as command line arguments.
  * This function tokenizes string into an array of strings in a similar way
@@ -173,17 +208,6 @@ size_t count_lines_on_fd(int source);
  */
 char ** parse_args(const char *str, size_t *len);
 
-/**
- * Parse Valgrind output and find out how many errors in how many context were
- * found.
- *
- * @param fh    file handle to output
- * @param errors    where to store number of errors
- * @param contexts  where to store number of contexts
- * @return 0 if parsing failed, non-negative integer on success.
- */
-int get_num_errors(FILE *fh, int *errors, int *contexts);
-
 /**
  * Make the string bold. The returned pointer points to static memory and
  * should no be freed.
@@ -214,4 +238,31 @@ void str_array_free(char **array);
  */
 void time_difference(struct timeval *a, struct timeval *b, struct timeval *res);
 
+/**
+ * Get current time of a monotonic clock in seconds. The value is only
+ * meaningful when compared with another value returned by this function.
+ *
+ * @return number of seconds since unspecified point in the past
+ */
+double monotonic_time(void);
+
+/**
+ * Format a string into newly allocated buffer.
+ *
+ * @param fmt   printf-style format string
+ * @param ap    arguments for the format
+ * @return formatted string that should be freed by caller
+ */
+char * str_vprintf(const char *fmt, va_list ap);
+
+/**
+ * Format a string into newly allocated buffer.
+ *
+ * @param fmt   printf-style format string
+ * @param ...   arguments for the format
+ * @return formatted string that should be freed by caller
+ */
+char * str_printf(const char *fmt, ...)
+    __attribute__ ((format (printf, 1, 2)));
+
 #endif /* end of include guard: UTILS_H */
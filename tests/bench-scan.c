@@ -0,0 +1,87 @@
+/*
+ * Throughput of the scanning kernels with every instruction set the
+ * processor supports. Build with make bench-scan and run it with an
+ * optional buffer size in megabytes.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "scan.h"
+
+/** minimal time spent measuring one kernel, in seconds */
+#define MIN_TIME 0.5
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Results are accumulated so that the calls are not optimized out. */
+static volatile size_t sink;
+
+static void
+report(const char *kernel, ScanLevel level, size_t bytes, double start)
+{
+    printf("%-20s %-7s %8.2f GB/s\n", kernel, scan_level_name(level),
+            bytes / (now() - start) / 1e9);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t size = (argc > 1 ? strtoul(argv[1], NULL, 10) : 16) << 20;
+    size_t i, bytes;
+    char *a, *b;
+    double start;
+    int level;
+
+    if (size == 0) {
+        fprintf(stderr, "Usage: %s [MEGABYTES]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    a = malloc(size);
+    b = malloc(size);
+    if (a == NULL || b == NULL) {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+    /* Text with lines of 40 characters on average. */
+    srand(1);
+    for (i = 0; i < size; i++) {
+        a[i] = rand() % 40 == 0 ? '\n' : ' ' + rand() % 95;
+    }
+    memcpy(b, a, size);
+
+    for (level = 0; level < SCAN_LEVELS; level++) {
+        if (!scan_set_level(level)) continue;
+
+        start = now();
+        for (bytes = 0; bytes == 0 || now() - start < MIN_TIME; bytes += size) {
+            sink += scan_count_newlines(a, size);
+        }
+        report("count_newlines", level, bytes, start);
+
+        start = now();
+        for (bytes = 0; bytes == 0 || now() - start < MIN_TIME; bytes += size) {
+            sink += scan_first_difference(a, b, size);
+        }
+        report("first_difference", level, bytes, start);
+
+        start = now();
+        for (bytes = 0; bytes == 0 || now() - start < MIN_TIME; bytes += size) {
+            sink += scan_equal_ignoring_space(a, size, b, size);
+        }
+        report("equal_ignoring_space", level, bytes, start);
+    }
+
+    free(a);
+    free(b);
+    return EXIT_SUCCESS;
+}
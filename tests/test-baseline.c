@@ -0,0 +1,95 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <cutter.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <baseline.h>
+
+char filename[] = "/tmp/cutter-tmp-file.XXXXXX";
+Baseline *baseline;
+
+void
+cut_setup(void)
+{
+    int fd = mkstemp(filename);
+    close(fd);
+    baseline = NULL;
+}
+
+void
+cut_teardown(void)
+{
+    unlink(filename);
+    baseline_free(baseline);
+}
+
+static void
+write_file(const char *str)
+{
+    FILE *fh = fopen(filename, "w");
+    fputs(str, fh);
+    fclose(fh);
+}
+
+void
+test_find(void)
+{
+    double a[] = { 1, 2 }, b[] = { 3 };
+    const double *res;
+    size_t len;
+
+    baseline = baseline_new();
+    baseline_add(baseline, "002_second", b, 1);
+    baseline_add(baseline, "001_first", a, 2);
+
+    res = baseline_find(baseline, "001_first", &len);
+    cut_assert_not_null(res);
+    cut_assert_equal_uint(2, len);
+    cut_assert_equal_double(2, 0.0001, res[1]);
+    res = baseline_find(baseline, "002_second", &len);
+    cut_assert_not_null(res);
+    cut_assert_equal_uint(1, len);
+    cut_assert_null(baseline_find(baseline, "003_missing", &len));
+}
+
+void
+test_save_and_load(void)
+{
+    double a[] = { 0.5, 0.25, 0.125 };
+    const double *res;
+    size_t len;
+    Baseline *loaded;
+
+    baseline = baseline_new();
+    baseline_add(baseline, "001 with space", a, 3);
+    baseline_add(baseline, "002_empty", a, 0);
+    cut_assert_true(baseline_save(baseline, filename));
+
+    loaded = baseline_load(filename);
+    cut_assert_not_null(loaded);
+    res = baseline_find(loaded, "001 with space", &len);
+    cut_assert_not_null(res);
+    cut_assert_equal_uint(3, len);
+    cut_assert_equal_double(0.125, 0.0001, res[2]);
+    res = baseline_find(loaded, "002_empty", &len);
+    cut_assert_not_null(res);
+    cut_assert_equal_uint(0, len);
+    baseline_free(loaded);
+}
+
+void
+test_load_bad(void)
+{
+    write_file("001_test\t0.5\n");
+    cut_assert_null(baseline_load(filename));
+
+    write_file("# stest baseline 1\n001_test 0.5\n");
+    cut_assert_null(baseline_load(filename));
+
+    write_file("# stest baseline 1\n001_test\t0.5 x\n");
+    cut_assert_null(baseline_load(filename));
+
+    cut_assert_null(baseline_load("/nonexistent/baseline"));
+}
@@ -0,0 +1,75 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <cutter.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <baseline.h>
+#include <list.h>
+#include <test.h>
+#include <testcontext.h>
+#include <utils.h>
+
+char dirname[] = "/tmp/cutter-tmp-dir.XXXXXX";
+char *path;
+TestContext *tc;
+
+static void
+create(const char *name, const char *content)
+{
+    char *file = str_printf("%s/%s", dirname, name);
+    FILE *fh = fopen(file, "w");
+
+    fputs(content, fh);
+    fclose(fh);
+    free(file);
+}
+
+void
+cut_setup(void)
+{
+    mkdtemp(dirname);
+    path = str_printf("%s.baseline", dirname);
+    tc = test_context_new();
+    test_context_set_command(tc, "/bin/sh");
+    test_context_set_verbosity(tc, MODE_QUIET);
+}
+
+void
+cut_teardown(void)
+{
+    char *cmd = str_printf("rm -rf %s %s", dirname, path);
+
+    test_context_free(tc);
+    system(cmd);
+    free(cmd);
+    free(path);
+    strcpy(dirname, "/tmp/cutter-tmp-dir.XXXXXX");
+}
+
+void
+test_bench_skips_killed_runs(void)
+{
+    Baseline *b;
+    List *tests;
+    size_t len = 0;
+
+    create("1_exits.args", "-c 'exit 1'\n");
+    create("1_exits.ret", "1\n");
+    create("2_killed.args", "-c 'kill -9 $$'\n");
+    test_context_set_bench(tc, 3, 1);
+    test_context_set_save_baseline(tc, path);
+    tests = test_load_from_dir(dirname);
+    test_context_run_tests(tc, tests);
+    list_destroy(tests, DESTROYFUNC(test_free));
+
+    b = baseline_load(path);
+    cut_assert_not_null(b);
+    cut_assert_not_null(baseline_find(b, "1_exits", &len));
+    cut_assert_equal_uint(3, len);
+    cut_assert_not_null(baseline_find(b, "2_killed", &len));
+    cut_assert_equal_uint(0, len);
+    baseline_free(b);
+}
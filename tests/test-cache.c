@@ -0,0 +1,107 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <cutter.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <cache.h>
+
+char filename[] = "/tmp/cutter-tmp-file.XXXXXX";
+Cache *cache;
+
+void
+cut_setup(void)
+{
+    int fd = mkstemp(filename);
+    close(fd);
+    cache = NULL;
+}
+
+void
+cut_teardown(void)
+{
+    unlink(filename);
+    cache_free(cache);
+}
+
+static void
+write_file(const char *str)
+{
+    FILE *fh = fopen(filename, "w");
+    fputs(str, fh);
+    fclose(fh);
+}
+
+void
+test_hash(void)
+{
+    /* Reference values of 64-bit FNV-1a. */
+    cut_assert_true(cache_hash(CACHE_HASH_INIT, "", 0)
+            == UINT64_C(0xcbf29ce484222325));
+    cut_assert_true(cache_hash(CACHE_HASH_INIT, "a", 1)
+            == UINT64_C(0xaf63dc4c8601ec8c));
+    cut_assert_true(cache_hash(CACHE_HASH_INIT, "foobar", 6)
+            == UINT64_C(0x85944171f73967e8));
+}
+
+void
+test_hash_file(void)
+{
+    uint64_t empty, missing, content;
+
+    write_file("");
+    empty = cache_hash_file(CACHE_HASH_INIT, filename);
+    write_file("foobar");
+    content = cache_hash_file(CACHE_HASH_INIT, filename);
+    missing = cache_hash_file(CACHE_HASH_INIT, "/nonexistent/file");
+
+    cut_assert_true(empty != missing);
+    cut_assert_true(empty != content);
+    cut_assert_true(content == cache_hash_file(CACHE_HASH_INIT, filename));
+}
+
+void
+test_lookup_and_update(void)
+{
+    cache = cache_load("/nonexistent/cache");
+    cut_assert_not_null(cache);
+    cut_assert_false(cache_lookup(cache, "001_test", 1));
+
+    cache_update(cache, "002_test", 2, 1);
+    cache_update(cache, "001_test", 1, 1);
+    cut_assert_true(cache_lookup(cache, "001_test", 1));
+    cut_assert_false(cache_lookup(cache, "001_test", 2));
+    cut_assert_true(cache_lookup(cache, "002_test", 2));
+
+    cache_update(cache, "001_test", 1, 0);
+    cut_assert_false(cache_lookup(cache, "001_test", 1));
+}
+
+void
+test_save_and_load(void)
+{
+    Cache *loaded;
+
+    cache = cache_load(filename);
+    cache_update(cache, "001 with space", UINT64_C(0xffffffffffffffff), 1);
+    cache_update(cache, "002_failed", 2, 1);
+    cache_update(cache, "002_failed", 2, 0);
+    cut_assert_true(cache_save(cache));
+
+    loaded = cache_load(filename);
+    cut_assert_true(cache_lookup(loaded, "001 with space",
+                UINT64_C(0xffffffffffffffff)));
+    cut_assert_false(cache_lookup(loaded, "002_failed", 2));
+    cache_free(loaded);
+}
+
+void
+test_load_bad(void)
+{
+    write_file("001_test 12\n002_test\tzz\n003_test\t1f\n");
+    cache = cache_load(filename);
+    cut_assert_false(cache_lookup(cache, "001_test", 0x12));
+    cut_assert_false(cache_lookup(cache, "002_test", 0));
+    cut_assert_true(cache_lookup(cache, "003_test", 0x1f));
+}
@@ -0,0 +1,107 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <cutter.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <capture.h>
+
+Capture *capture;
+int write_fd;
+
+void
+cut_setup(void)
+{
+    capture = capture_new(CAPTURE_MEMORY_LIMIT);
+    write_fd = capture_take_write_fd(capture);
+}
+
+void
+cut_teardown(void)
+{
+    if (write_fd >= 0) close(write_fd);
+    capture_free(capture);
+}
+
+static void
+feed(const char *data)
+{
+    /* Small writes are read at once. */
+    write(write_fd, data, strlen(data));
+    cut_assert_true(capture_read(capture));
+}
+
+void
+test_capture_expected_equal(void)
+{
+    const char *data;
+    size_t len, offset = 0;
+
+    capture_set_expected(capture, "first\nsecond\n", 13);
+    feed("first\n");
+    cut_assert_false(capture_diverged(capture, &offset));
+    feed("second\n");
+    cut_assert_false(capture_diverged(capture, &offset));
+    data = capture_get_data(capture, &len);
+    cut_assert_equal_memory("first\nsecond\n", 13, data, len);
+}
+
+void
+test_capture_expected_differs(void)
+{
+    size_t offset = 0;
+
+    capture_set_expected(capture, "first\nsecond\n", 13);
+    feed("first\n");
+    feed("secant\n");
+    cut_assert_true(capture_diverged(capture, &offset));
+    cut_assert_equal_uint(9, offset);
+    feed("more\n");
+    cut_assert_true(capture_diverged(capture, &offset));
+    cut_assert_equal_uint(9, offset);
+}
+
+void
+test_capture_expected_longer(void)
+{
+    size_t offset = 0;
+
+    capture_set_expected(capture, "short\n", 6);
+    feed("short\nand more\n");
+    cut_assert_true(capture_diverged(capture, &offset));
+    cut_assert_equal_uint(6, offset);
+}
+
+void
+test_capture_max(void)
+{
+    const char *data;
+    size_t len, received = 0;
+
+    capture_set_max(capture, 8);
+    feed("1234");
+    cut_assert_false(capture_exceeded(capture, &received));
+    write(write_fd, "567890", 6);
+    cut_assert_false(capture_read(capture));
+    cut_assert_true(capture_exceeded(capture, &received));
+    cut_assert_equal_uint(10, received);
+    cut_assert_equal_int(-1, capture_get_read_fd(capture));
+    data = capture_get_data(capture, &len);
+    cut_assert_equal_memory("12345678", 8, data, len);
+}
+
+void
+test_capture_drain(void)
+{
+    const char *data;
+    size_t len;
+
+    /* The write end stays open, as if a process started by the program
+     * kept it. */
+    write(write_fd, "left in pipe\n", 13);
+    capture_drain(capture);
+    cut_assert_equal_int(-1, capture_get_read_fd(capture));
+    data = capture_get_data(capture, &len);
+    cut_assert_equal_memory("left in pipe\n", 13, data, len);
+}
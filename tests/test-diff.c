@@ -0,0 +1,189 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <cutter.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <diff.h>
+#include <outputqueue.h>
+
+FILE *output;
+char filename[] = "/tmp/cutter-tmp-file.XXXXXX";
+#define BUF_SIZE 1024
+char buffer[BUF_SIZE];
+OQueue *queue;
+DiffOptions opts;
+
+void
+cut_setup(void)
+{
+    int fd = mkstemp(filename);
+    close(fd);
+    output = fopen(filename, "w+");
+    queue = oqueue_new();
+    diff_options_init(&opts);
+}
+
+void
+cut_teardown(void)
+{
+    fclose(output);
+    unlink(filename);
+    oqueue_free(queue);
+    queue = NULL;
+}
+
+char * load_output(void)
+{
+    oqueue_flush(queue, output);
+    memset(buffer, 0, BUF_SIZE * sizeof(char));
+    rewind(output);
+    fread(buffer, sizeof(char), BUF_SIZE, output);
+    rewind(output);
+    truncate(filename, 0);
+    return buffer;
+}
+
+#define call_diff_equal(a, b) diff_equal(a, strlen(a), b, strlen(b), &opts)
+#define call_diff_unified(a, b, q) diff_unified(a, strlen(a), b, strlen(b), &opts, q)
+
+void
+test_options_parse(void)
+{
+    cut_assert_equal_int(1, diff_options_parse(&opts, "-u -d"));
+    cut_assert_equal_uint(0, opts.flags);
+    cut_assert_equal_uint(3, opts.context);
+
+    cut_assert_equal_int(1, diff_options_parse(&opts, "-wi --unified=5"));
+    cut_assert_equal_uint(DIFF_IGNORE_ALL_SPACE | DIFF_IGNORE_CASE, opts.flags);
+    cut_assert_equal_uint(5, opts.context);
+
+    cut_assert_equal_int(1, diff_options_parse(&opts, "-U 1 --strip-trailing-cr"));
+    cut_assert_equal_uint(5, opts.context);
+    cut_assert_true(opts.flags & DIFF_STRIP_TRAILING_CR);
+
+    diff_options_init(&opts);
+    cut_assert_equal_int(1, diff_options_parse(&opts, "-U0"));
+    cut_assert_equal_uint(3, opts.context);
+    cut_assert_equal_int(1, diff_options_parse(&opts, "-U 7"));
+    cut_assert_equal_uint(7, opts.context);
+}
+
+void
+test_options_parse_bad(void)
+{
+    cut_assert_equal_int(0, diff_options_parse(&opts, "-y"));
+    cut_assert_equal_int(0, diff_options_parse(&opts, "--side-by-side"));
+    cut_assert_equal_int(0, diff_options_parse(&opts, "-U"));
+    cut_assert_equal_int(0, diff_options_parse(&opts, "-U x"));
+    cut_assert_equal_int(0, diff_options_parse(&opts, "file"));
+}
+
+void
+test_equal(void)
+{
+    cut_assert_equal_int(1, call_diff_equal("", ""));
+    cut_assert_equal_int(1, call_diff_equal("foo\nbar\n", "foo\nbar\n"));
+    cut_assert_equal_int(0, call_diff_equal("foo\nbar\n", "foo\nbar"));
+    cut_assert_equal_int(0, call_diff_equal("foo\n", "Foo\n"));
+}
+
+void
+test_equal_with_options(void)
+{
+    opts.flags = DIFF_IGNORE_CASE;
+    cut_assert_equal_int(1, call_diff_equal("foo\n", "Foo\n"));
+    cut_assert_equal_int(0, call_diff_equal("foo\n", "Foo"));
+
+    opts.flags = DIFF_IGNORE_SPACE_CHANGE;
+    cut_assert_equal_int(1, call_diff_equal("a  b \n", "a b\n"));
+    cut_assert_equal_int(0, call_diff_equal("a b\n", "ab\n"));
+    cut_assert_equal_int(1, call_diff_equal("a\n", "a"));
+
+    opts.flags = DIFF_IGNORE_ALL_SPACE;
+    cut_assert_equal_int(1, call_diff_equal("a b\n", "ab\n"));
+    cut_assert_equal_int(0, call_diff_equal("a\n\n", "a\n"));
+    cut_assert_equal_int(1, call_diff_equal(" a\tb\nc \n", "ab\nc"));
+    cut_assert_equal_int(0, call_diff_equal("a\nb\n", "ab\n"));
+    cut_assert_equal_int(0, call_diff_equal("", "  "));
+
+    opts.flags = DIFF_STRIP_TRAILING_CR;
+    cut_assert_equal_int(1, call_diff_equal("a\r\nb\r\n", "a\nb\n"));
+}
+
+void
+test_unified_no_changes(void)
+{
+    cut_assert_equal_uint(0, call_diff_unified("a\nb\n", "a\nb\n", queue));
+    cut_assert_equal_string("", load_output());
+}
+
+void
+test_unified_simple(void)
+{
+    cut_assert_equal_uint(6, call_diff_unified("a\nB\nc\nd\n", "a\nb\nc\n", queue));
+    cut_assert_equal_string("--- expected\n+++ actual\n"
+                            "@@ -1,4 +1,3 @@\n a\n-B\n+b\n c\n-d\n",
+                            load_output());
+}
+
+void
+test_unified_single_line(void)
+{
+    cut_assert_equal_uint(3, call_diff_unified("different\n", "exiting\n", queue));
+    cut_assert_equal_string("--- expected\n+++ actual\n"
+                            "@@ -1 +1 @@\n-different\n+exiting\n",
+                            load_output());
+}
+
+void
+test_unified_empty_file(void)
+{
+    cut_assert_equal_uint(3, call_diff_unified("", "a\nb\n", queue));
+    cut_assert_equal_string("--- expected\n+++ actual\n"
+                            "@@ -0,0 +1,2 @@\n+a\n+b\n",
+                            load_output());
+}
+
+void
+test_unified_missing_newline(void)
+{
+    cut_assert_equal_uint(5, call_diff_unified("a\nb", "a\nb\n", queue));
+    cut_assert_equal_string("--- expected\n+++ actual\n"
+                            "@@ -1,2 +1,2 @@\n a\n-b\n"
+                            "\\ No newline at end of file\n+b\n",
+                            load_output());
+}
+
+void
+test_unified_hunks(void)
+{
+    const char *a = "1\n2\n3\n4\n5\n6\n7\n8\n9\n10\n11\n12\n13\n14\n15\n";
+    const char *b = "1\nX\n3\n4\n5\n6\n7\n8\n9\n10\n11\n12\n13\nY\n15\n";
+
+    cut_assert_equal_uint(14, call_diff_unified(a, b, queue));
+    cut_assert_equal_string("--- expected\n+++ actual\n"
+                            "@@ -1,5 +1,5 @@\n 1\n-2\n+X\n 3\n 4\n 5\n"
+                            "@@ -11,5 +11,5 @@\n 11\n 12\n 13\n-14\n+Y\n 15\n",
+                            load_output());
+}
+
+void
+test_unified_context(void)
+{
+    opts.context = 0;
+    cut_assert_equal_uint(2, call_diff_unified("a\nb\nc\n", "a\nc\n", queue));
+    cut_assert_equal_string("--- expected\n+++ actual\n"
+                            "@@ -2 +1,0 @@\n-b\n",
+                            load_output());
+}
+
+void
+test_unified_binary(void)
+{
+    cut_assert_equal_uint(1, diff_unified("a\0b", 3, "a\0c", 3, &opts, queue));
+    cut_assert_equal_string("Binary files expected and actual differ\n",
+                            load_output());
+}
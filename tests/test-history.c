@@ -0,0 +1,209 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <cutter.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <history.h>
+
+char filename[] = "/tmp/cutter-tmp-file.XXXXXX";
+History *history;
+List *tests;
+
+static Test *
+new_test(const char *name)
+{
+    Test *test = calloc(1, sizeof(Test));
+    test->name = strdup(name);
+    test->dir = strdup("/nonexistent");
+    return test;
+}
+
+static List *
+new_tests(void)
+{
+    List *list = NULL;
+
+    list = list_prepend(list, new_test("004_new"));
+    list = list_prepend(list, new_test("003_slow"));
+    list = list_prepend(list, new_test("002_failed"));
+    list = list_prepend(list, new_test("001_fast"));
+    return list;
+}
+
+void
+cut_setup(void)
+{
+    int fd = mkstemp(filename);
+    close(fd);
+    history = history_load("/nonexistent/history");
+    tests = new_tests();
+}
+
+void
+cut_teardown(void)
+{
+    unlink(filename);
+    history_free(history);
+    list_destroy(tests, DESTROYFUNC(test_free));
+}
+
+static void
+record_tests(void)
+{
+    history_record(history, "001_fast", test_hash_files(tests->data), 0, 1);
+    history_record(history, "002_failed", 0, 1, 2);
+    history_record(history, "003_slow",
+            test_hash_files(tests->next->next->data), 0, 4);
+}
+
+/**
+ * Check names of tests in the list, unused trailing names are NULL.
+ */
+static void
+assert_order(const char *first, const char *second, const char *third,
+             const char *fourth)
+{
+    const char *names[] = { first, second, third, fourth };
+    List *tmp = tests;
+    size_t i;
+
+    for (i = 0; i < 4 && names[i] != NULL; i++) {
+        cut_assert_not_null(tmp);
+        cut_assert_equal_string(names[i], ((Test *) tmp->data)->name);
+        tmp = tmp->next;
+    }
+    cut_assert_null(tmp);
+}
+
+void
+test_record(void)
+{
+    const HistoryEntry *e;
+
+    cut_assert_null(history_find(history, "001_test"));
+    history_record(history, "001_test", 7, 1, 2);
+    history_record(history, "001_test", 7, 0, 4);
+    history_record(history, "001_test", 8, 0, -1);
+
+    e = history_find(history, "001_test");
+    cut_assert_not_null(e);
+    cut_assert_equal_uint(4, e->failures);
+    cut_assert_true(e->files == 8);
+    cut_assert_equal_double(3, 0.0001, e->wall);
+}
+
+void
+test_save_and_load(void)
+{
+    const HistoryEntry *e;
+    History *loaded;
+
+    history_free(history);
+    history = history_load(filename);
+    history_record(history, "001 with space", 0xabc, 1, -1);
+    history_record(history, "002_measured", 1, 0, 0.5);
+    cut_assert_true(history_save(history));
+
+    loaded = history_load(filename);
+    e = history_find(loaded, "001 with space");
+    cut_assert_not_null(e);
+    cut_assert_equal_uint(1, e->failures);
+    cut_assert_true(e->files == 0xabc);
+    cut_assert_true(e->wall < 0);
+    e = history_find(loaded, "002_measured");
+    cut_assert_not_null(e);
+    cut_assert_equal_double(0.5, 0.0001, e->wall);
+    history_free(loaded);
+}
+
+void
+test_order(void)
+{
+    record_tests();
+
+    tests = history_order(history, tests, ORDER_DEFAULT);
+    assert_order("001_fast", "002_failed", "003_slow", "004_new");
+    tests = history_order(history, tests, ORDER_FAILED_FIRST);
+    assert_order("002_failed", "001_fast", "003_slow", "004_new");
+    tests = history_order(history, tests, ORDER_SLOWEST_FIRST);
+    assert_order("003_slow", "002_failed", "001_fast", "004_new");
+    tests = history_order(history, tests, ORDER_FASTEST_FIRST);
+    assert_order("001_fast", "002_failed", "003_slow", "004_new");
+}
+
+void
+test_select(void)
+{
+    List *rest;
+
+    record_tests();
+
+    /* The new test is expected to take average time of the others. */
+    tests = history_select(history, tests, 4.5, &rest);
+    cut_assert_not_null(tests);
+    cut_assert_equal_string("002_failed", ((Test *) tests->data)->name);
+    cut_assert_not_null(tests->next);
+    cut_assert_equal_string("004_new", ((Test *) tests->next->data)->name);
+    cut_assert_null(tests->next->next);
+    cut_assert_not_null(rest);
+    cut_assert_equal_uint(2, list_length(rest));
+
+    tests = list_reverse(tests);
+    tests->next->next = rest;
+    tests = history_select(history, tests, 100, &rest);
+    cut_assert_null(rest);
+    assert_order("002_failed", "004_new", "001_fast", "003_slow");
+}
+
+void
+test_select_without_durations(void)
+{
+    List *rest;
+
+    /* Each test is expected to take the default time. */
+    cut_assert_false(history_has_durations(history));
+    tests = history_select(history, tests, 2.5 * HISTORY_DEFAULT_WALL, &rest);
+    assert_order("001_fast", "002_failed", NULL, NULL);
+    cut_assert_equal_uint(2, list_length(rest));
+    list_destroy(rest, DESTROYFUNC(test_free));
+
+    history_record(history, "003_slow", 0, 0, -1);
+    cut_assert_false(history_has_durations(history));
+    history_record(history, "003_slow", 0, 0, 4);
+    cut_assert_true(history_has_durations(history));
+}
+
+void
+test_shard(void)
+{
+    List *rest;
+    size_t i, total = 0;
+
+    record_tests();
+
+    tests = history_shard(NULL, tests, 1, 2, SHARD_ROUND_ROBIN, &rest);
+    assert_order("002_failed", "004_new", NULL, NULL);
+    list_destroy(rest, DESTROYFUNC(test_free));
+    list_destroy(tests, DESTROYFUNC(test_free));
+
+    /* Shards get 4 + 1 and 2.33 + 2 seconds, in original order. */
+    tests = history_shard(history, new_tests(), 0, 2, SHARD_BY_DURATION,
+            &rest);
+    assert_order("001_fast", "003_slow", NULL, NULL);
+    cut_assert_equal_uint(2, list_length(tests));
+    cut_assert_equal_uint(2, list_length(rest));
+    list_destroy(rest, DESTROYFUNC(test_free));
+    list_destroy(tests, DESTROYFUNC(test_free));
+
+    for (i = 0; i < 3; i++) {
+        tests = history_shard(NULL, new_tests(), i, 3, SHARD_BY_NAME, &rest);
+        total += list_length(tests);
+        list_destroy(rest, DESTROYFUNC(test_free));
+        list_destroy(tests, DESTROYFUNC(test_free));
+    }
+    tests = NULL;
+    cut_assert_equal_uint(4, total);
+}
@@ -0,0 +1,149 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <cutter.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <import.h>
+#include <utils.h>
+
+char dirname[] = "/tmp/cutter-tmp-dir.XXXXXX";
+ImportRecord *records;
+size_t len;
+
+static char *
+create(const char *name, const char *content)
+{
+    char *path = str_printf("%s/%s", dirname, name);
+    FILE *fh = fopen(path, "w");
+
+    fputs(content, fh);
+    fclose(fh);
+    return path;
+}
+
+static void
+load(const char *name, const char *content)
+{
+    char *path = create(name, content);
+
+    records = import_load(path, &len);
+    free(path);
+}
+
+void
+cut_setup(void)
+{
+    mkdtemp(dirname);
+    records = NULL;
+    len = 0;
+}
+
+void
+cut_teardown(void)
+{
+    char *cmd = str_printf("rm -rf %s", dirname);
+
+    import_free(records, len);
+    system(cmd);
+    free(cmd);
+    strcpy(dirname, "/tmp/cutter-tmp-dir.XXXXXX");
+}
+
+void
+test_import_jsonl(void)
+{
+    load("t.jsonl",
+         "{\"name\": \"a\", \"args\": \"-x\", \"stdout\": \"\\u00e9\\n\","
+         " \"exit_code\": 3}\n"
+         "\n"
+         "{\"name\":\"b\",\"stdin_file\":\"in\",\"stderr\":null}\n");
+    cut_assert_not_null(records);
+    cut_assert_equal_uint(2, len);
+    cut_assert_equal_string("a", records[0].values[IMPORT_NAME]);
+    cut_assert_equal_string("-x", records[0].values[IMPORT_ARGS]);
+    cut_assert_equal_string("\xc3\xa9\n", records[0].values[IMPORT_STDOUT]);
+    cut_assert_equal_string("3", records[0].values[IMPORT_EXIT_CODE]);
+    cut_assert_null(records[0].values[IMPORT_STDIN]);
+    cut_assert_equal_uint(3, records[1].line);
+    cut_assert_equal_string("in", records[1].values[IMPORT_STDIN_FILE]);
+    cut_assert_null(records[1].values[IMPORT_STDERR]);
+}
+
+void
+test_import_csv(void)
+{
+    load("t.csv",
+         "name,stdin,stdin_file,stdout,exit_code\r\n"
+         "\"a, b\",\"1\n2\",,\"say \"\"hi\"\"\",0\r\n"
+         "c,,in,,\n");
+    cut_assert_not_null(records);
+    cut_assert_equal_uint(2, len);
+    cut_assert_equal_string("a, b", records[0].values[IMPORT_NAME]);
+    cut_assert_equal_string("1\n2", records[0].values[IMPORT_STDIN]);
+    cut_assert_null(records[0].values[IMPORT_STDIN_FILE]);
+    cut_assert_equal_string("say \"hi\"", records[0].values[IMPORT_STDOUT]);
+    cut_assert_equal_string("0", records[0].values[IMPORT_EXIT_CODE]);
+    cut_assert_equal_uint(4, records[1].line);
+    cut_assert_null(records[1].values[IMPORT_STDIN]);
+    cut_assert_equal_string("in", records[1].values[IMPORT_STDIN_FILE]);
+    cut_assert_equal_string("", records[1].values[IMPORT_STDOUT]);
+    cut_assert_null(records[1].values[IMPORT_EXIT_CODE]);
+}
+
+void
+test_import_malformed(void)
+{
+    load("1.jsonl", "{\"name\": \"a\", \"bad\": 1}\n");
+    cut_assert_null(records);
+    load("2.jsonl", "{\"name\": \"a\"\n");
+    cut_assert_null(records);
+    load("3.jsonl", "{\"stdout\": \"x\"}\n");
+    cut_assert_null(records);
+    load("4.jsonl", "{\"name\": \"a\", \"exit_code\": 256}\n");
+    cut_assert_null(records);
+    load("5.jsonl", "{\"name\": \"a\", \"stdin\": \"\","
+         " \"stdin_file\": \"x\"}");
+    cut_assert_null(records);
+    load("6.csv", "name,ret\na,0\n");
+    cut_assert_null(records);
+    load("7.csv", "name,args\n\"a\n");
+    cut_assert_null(records);
+    load("8.csv", "name,args\na,b,c\n");
+    cut_assert_null(records);
+}
+
+void
+test_import_write(void)
+{
+    char *path, *data, *tests;
+    size_t n;
+
+    free(create("in", "input\n"));
+    load("t.jsonl",
+         "{\"name\": \"First Test\", \"args\": \"-x\", \"stdin_file\": \"in\","
+         " \"stdout\": \"out\", \"exit_code\": 1}\n");
+    cut_assert_not_null(records);
+    tests = str_printf("%s/tests", dirname);
+    mkdir(tests, 0777);
+    free(create("tests/002_old.out", ""));
+
+    cut_assert_true(import_write(records, len, dirname, tests));
+    path = str_printf("%s/003_first_test.in", tests);
+    data = read_file(path, &n);
+    cut_assert_equal_string("input\n", data);
+    free(data);
+    free(path);
+    path = str_printf("%s/003_first_test.ret", tests);
+    data = read_file(path, &n);
+    cut_assert_equal_string("1\n", data);
+    free(data);
+    free(path);
+    path = str_printf("%s/003_first_test.err", tests);
+    cut_assert_null(read_file(path, &n));
+    free(path);
+    free(tests);
+}
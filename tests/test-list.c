@@ -70,6 +70,18 @@ test_reverse_list(void)
     cut_assert_null(l->next->next->next);
 }
 
+void
+test_list_length(void)
+{
+    List *l = NULL;
+
+    cut_assert_equal_uint(0, list_length(l));
+    l = list_prepend(l, INT_TO_POINTER(1));
+    l = list_prepend(l, INT_TO_POINTER(2));
+    cut_assert_equal_uint(2, list_length(l));
+    list_destroy(l, NULL);
+}
+
 void foreach_cb(void *item, void *data)
 {
     int i = POINTER_TO_INT(item);
@@ -0,0 +1,190 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <cutter.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <test.h>
+#include <utils.h>
+
+char dirname[] = "/tmp/cutter-tmp-dir.XXXXXX";
+List *tests;
+
+static void
+create(const char *name)
+{
+    char path[256];
+    FILE *fh;
+
+    snprintf(path, sizeof(path), "%s/%s", dirname, name);
+    if (name[strlen(name) - 1] == '/') {
+        mkdir(path, 0700);
+    } else {
+        fh = fopen(path, "w");
+        fclose(fh);
+    }
+}
+
+void
+cut_setup(void)
+{
+    mkdtemp(dirname);
+    tests = NULL;
+}
+
+void
+cut_teardown(void)
+{
+    char *cmd = malloc(strlen(dirname) + 8);
+
+    sprintf(cmd, "rm -rf %s", dirname);
+    system(cmd);
+    free(cmd);
+    strcpy(dirname, "/tmp/cutter-tmp-dir.XXXXXX");
+    list_destroy(tests, DESTROYFUNC(test_free));
+}
+
+static Test *
+nth(size_t n)
+{
+    List *tmp = tests;
+
+    while (n-- > 0 && tmp) tmp = tmp->next;
+    cut_assert_not_null(tmp);
+    return tmp->data;
+}
+
+void
+test_load_sorted(void)
+{
+    create("10_last.in");
+    create("2_second.out");
+    create("001_first.in");
+    create("10_last.out");
+    create("2_second.args");
+    create("001_first.ret");
+    create("readme.txt");
+
+    tests = test_load_from_dir(dirname);
+    cut_assert_equal_uint(3, list_length(tests));
+    cut_assert_equal_string("001_first", nth(0)->name);
+    cut_assert_equal_int(TEST_INPUT | TEST_RETVAL, nth(0)->parts);
+    cut_assert_equal_string("2_second", nth(1)->name);
+    cut_assert_equal_int(TEST_OUTPUT | TEST_ARGS, nth(1)->parts);
+    cut_assert_equal_string("10_last", nth(2)->name);
+    cut_assert_equal_string(dirname, nth(2)->dir);
+}
+
+void
+test_load_same_number(void)
+{
+    create("1_b.in");
+    create("1_a.in");
+    create("1_b.out");
+    create("1_a.out");
+
+    tests = test_load_from_dir(dirname);
+    cut_assert_equal_uint(2, list_length(tests));
+    cut_assert_equal_string("1_a", nth(0)->name);
+    cut_assert_equal_int(TEST_INPUT | TEST_OUTPUT, nth(0)->parts);
+    cut_assert_equal_string("1_b", nth(1)->name);
+    cut_assert_equal_int(TEST_INPUT | TEST_OUTPUT, nth(1)->parts);
+}
+
+void
+test_load_without_dot(void)
+{
+    create("1_nodot");
+    create("2_test.in");
+
+    tests = test_load_from_dir(dirname);
+    cut_assert_equal_uint(1, list_length(tests));
+    cut_assert_equal_string("2_test", nth(0)->name);
+}
+
+void
+test_load_nested(void)
+{
+    create("1_top.in");
+    create("2_group/");
+    create("2_group/2_inner.in");
+    create("2_group/1_inner.in");
+    create("2_group/3_sub/");
+    create("2_group/3_sub/1_deep.out");
+    create("3_end.in");
+    create("data/");
+    create("data/1_ignored.in");
+
+    tests = test_load_from_dir(dirname);
+    cut_assert_equal_uint(5, list_length(tests));
+    cut_assert_equal_string("1_top", nth(0)->name);
+    cut_assert_equal_string("2_group/1_inner", nth(1)->name);
+    cut_assert_equal_string("2_group/2_inner", nth(2)->name);
+    cut_assert_equal_string("2_group/3_sub/1_deep", nth(3)->name);
+    cut_assert_equal_int(TEST_OUTPUT, nth(3)->parts);
+    cut_assert_equal_string("3_end", nth(4)->name);
+}
+
+void
+test_load_symlinks(void)
+{
+    char target[256], path[256];
+
+    create("1_top.in");
+    create("data/");
+    create("data/1_linked.in");
+    snprintf(target, sizeof(target), "%s/data", dirname);
+    snprintf(path, sizeof(path), "%s/2_group", dirname);
+    cut_assert_equal_int(0, symlink(target, path));
+    /* Links making a cycle are not followed. */
+    snprintf(path, sizeof(path), "%s/data/2_loop", dirname);
+    cut_assert_equal_int(0, symlink(dirname, path));
+    snprintf(target, sizeof(target), "%s/1_top.in", dirname);
+    snprintf(path, sizeof(path), "%s/3_file.in", dirname);
+    cut_assert_equal_int(0, symlink(target, path));
+
+    tests = test_load_from_dir(dirname);
+    cut_assert_equal_uint(3, list_length(tests));
+    cut_assert_equal_string("1_top", nth(0)->name);
+    cut_assert_equal_string("2_group/1_linked", nth(1)->name);
+    cut_assert_equal_int(TEST_INPUT, nth(1)->parts);
+    cut_assert_equal_string("3_file", nth(2)->name);
+}
+
+void
+test_load_errors(void)
+{
+    tests = test_load_from_dir(dirname);
+    cut_assert_null(tests);
+    cut_assert_equal_int(0, errno);
+
+    tests = test_load_from_dir("/nonexistent/dir");
+    cut_assert_null(tests);
+    cut_assert_equal_int(ENOENT, errno);
+}
+
+void
+test_load_hash_files(void)
+{
+    char path[256];
+    uint64_t hash;
+    FILE *fh;
+
+    create("1_a.out");
+    tests = test_load_from_dir(dirname);
+    hash = test_hash_files(nth(0));
+
+    /* The files are not read again for the same test. */
+    snprintf(path, sizeof(path), "%s/1_a.out", dirname);
+    fh = fopen(path, "w");
+    fputs("changed\n", fh);
+    fclose(fh);
+    cut_assert_true(hash == test_hash_files(nth(0)));
+
+    cut_assert_true(test_set_data(nth(0), EXT_OUTPUT, "new\n", 4));
+    cut_assert_true(hash != test_hash_files(nth(0)));
+}
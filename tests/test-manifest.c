@@ -0,0 +1,239 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <cutter.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <manifest.h>
+#include <test.h>
+#include <utils.h>
+
+char dirname[] = "/tmp/cutter-tmp-dir.XXXXXX";
+char *path;
+Manifest *manifest;
+List *tests;
+
+/**
+ * Set modification time of a file a minute ago, so that its stamp can be
+ * trusted.
+ */
+static void
+age(const char *file)
+{
+    struct timespec times[2];
+
+    clock_gettime(CLOCK_REALTIME, &times[0]);
+    times[0].tv_sec -= 60;
+    times[1] = times[0];
+    utimensat(AT_FDCWD, file, times, 0);
+}
+
+static void
+create(const char *name, const char *content)
+{
+    char file[256];
+    FILE *fh;
+
+    snprintf(file, sizeof(file), "%s/%s", dirname, name);
+    fh = fopen(file, "w");
+    fputs(content, fh);
+    fclose(fh);
+    age(file);
+    age(dirname);
+}
+
+void
+cut_setup(void)
+{
+    char *state_dir;
+
+    mkdtemp(dirname);
+    state_dir = str_printf("%s/%s", dirname, STATE_DIR);
+    mkdir(state_dir, 0777);
+    free(state_dir);
+    path = str_printf("%s/%s/%s", dirname, STATE_DIR, MANIFEST_FILE);
+    manifest = manifest_load(path);
+    tests = NULL;
+}
+
+void
+cut_teardown(void)
+{
+    char *cmd = malloc(strlen(dirname) + 8);
+
+    list_destroy(tests, DESTROYFUNC(test_free));
+    manifest_free(manifest);
+    free(path);
+    sprintf(cmd, "rm -rf %s", dirname);
+    system(cmd);
+    free(cmd);
+    strcpy(dirname, "/tmp/cutter-tmp-dir.XXXXXX");
+}
+
+static void
+reload(void)
+{
+    list_destroy(tests, DESTROYFUNC(test_free));
+    cut_assert_true(manifest_save(manifest));
+    manifest_free(manifest);
+    manifest = manifest_load(path);
+    tests = test_load_with_manifest(dirname, manifest);
+}
+
+void
+test_manifest_dir(void)
+{
+    ManifestEntry *entries, *found;
+    struct stat info;
+    size_t len = 0;
+
+    create("1_a.in", "");
+    stat(dirname, &info);
+    entries = calloc(2, sizeof(ManifestEntry));
+    entries[0].name = strdup("1_a");
+    entries[0].parts = TEST_INPUT;
+    entries[1].name = strdup("2_group");
+    entries[1].is_dir = 1;
+    manifest_set_dir(manifest, ".", &info, entries, 2);
+    cut_assert_true(manifest_save(manifest));
+    manifest_free(manifest);
+
+    manifest = manifest_load(path);
+    found = manifest_get_dir(manifest, ".", &info, &len);
+    cut_assert_not_null(found);
+    cut_assert_equal_uint(2, len);
+    cut_assert_equal_string("1_a", found[0].name);
+    cut_assert_equal_int(TEST_INPUT, found[0].parts);
+    cut_assert_equal_int(0, found[0].is_dir);
+    cut_assert_equal_string("2_group", found[1].name);
+    cut_assert_equal_int(1, found[1].is_dir);
+    cut_assert_null(manifest_get_dir(manifest, "2_group", &info, &len));
+
+    info.st_mtim.tv_nsec++;
+    cut_assert_null(manifest_get_dir(manifest, ".", &info, &len));
+}
+
+void
+test_manifest_saved(void)
+{
+    struct stat before, after;
+    size_t len;
+
+    create("1_a.in", "");
+    stat(dirname, &before);
+    tests = test_load_with_manifest(dirname, manifest);
+    reload();
+
+    /* Saving the manifest did not modify the directory, so it was not
+     * listed again. */
+    stat(dirname, &after);
+    cut_assert_equal_int(before.st_mtim.tv_sec, after.st_mtim.tv_sec);
+    cut_assert_equal_int(before.st_mtim.tv_nsec, after.st_mtim.tv_nsec);
+    cut_assert_not_null(manifest_get_dir(manifest, ".", &after, &len));
+    cut_assert_equal_uint(1, len);
+    cut_assert_equal_uint(1, list_length(tests));
+}
+
+void
+test_manifest_recent(void)
+{
+    ManifestStamp stamp;
+    struct stat info;
+    FILE *fh;
+
+    fh = fopen(path, "w");
+    fclose(fh);
+    stat(path, &info);
+    manifest_stamp_set(manifest, &stamp, &info);
+    cut_assert_false(manifest_stamp_matches(&stamp, &info));
+
+    create("1_a.in", "");
+    stat(dirname, &info);
+    manifest_stamp_set(manifest, &stamp, &info);
+    cut_assert_true(manifest_stamp_matches(&stamp, &info));
+}
+
+void
+test_manifest_args(void)
+{
+    ManifestEntry *entries;
+    struct stat info;
+    char **args;
+    size_t count, len;
+
+    create("1_a.args", "-x \"tab\there\" 'a b'\n");
+    create("1_a.ret", "3\n");
+    tests = test_load_with_manifest(dirname, manifest);
+    cut_assert_equal_uint(1, list_length(tests));
+    args = test_get_args(tests->data, &count);
+    str_array_free(args);
+    cut_assert_equal_int(3, test_get_exit_code(tests->data));
+    reload();
+
+    stat(dirname, &info);
+    entries = manifest_get_dir(manifest, ".", &info, &len);
+    cut_assert_not_null(entries);
+    cut_assert_equal_uint(1, len);
+    cut_assert_equal_uint(4, entries[0].arg_count);
+    cut_assert_equal_string("tab\there", entries[0].args[1]);
+    cut_assert_equal_string("a b", entries[0].args[2]);
+    cut_assert_equal_int(3, entries[0].exit_code);
+
+    args = test_get_args(tests->data, &count);
+    cut_assert_equal_uint(4, count);
+    cut_assert_equal_string("-x", args[0]);
+    cut_assert_equal_string("tab\there", args[1]);
+    cut_assert_null(args[3]);
+    str_array_free(args);
+    cut_assert_equal_int(3, test_get_exit_code(tests->data));
+}
+
+void
+test_manifest_changed(void)
+{
+    char **args;
+    size_t count;
+
+    create("1_a.args", "old\n");
+    create("1_a.ret", "1\n");
+    tests = test_load_with_manifest(dirname, manifest);
+    args = test_get_args(tests->data, &count);
+    str_array_free(args);
+    test_get_exit_code(tests->data);
+    reload();
+
+    create("1_a.args", "new args\n");
+    create("1_a.ret", "2\n");
+    create("2_b.in", "");
+    reload();
+    cut_assert_equal_uint(2, list_length(tests));
+    args = test_get_args(tests->data, &count);
+    cut_assert_equal_uint(3, count);
+    cut_assert_equal_string("new", args[0]);
+    str_array_free(args);
+    cut_assert_equal_int(2, test_get_exit_code(tests->data));
+}
+
+void
+test_manifest_malformed(void)
+{
+    struct stat info;
+    size_t len;
+    FILE *fh;
+
+    fh = fopen(path, "w");
+    fputs("stest-manifest\t2\nD\t.\t1\t2\t3\nX\n", fh);
+    fclose(fh);
+    manifest_free(manifest);
+    manifest = manifest_load(path);
+    info.st_mtim.tv_sec = 0;
+    info.st_mtim.tv_nsec = 1;
+    info.st_size = 2;
+    info.st_ino = 3;
+    cut_assert_null(manifest_get_dir(manifest, ".", &info, &len));
+}
@@ -0,0 +1,199 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <cutter.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <memcheck.h>
+
+char filename[] = "/tmp/cutter-tmp-file.XXXXXX";
+MemcheckReport report;
+
+void
+cut_setup(void)
+{
+    int fd = mkstemp(filename);
+    close(fd);
+    memset(&report, 0, sizeof(MemcheckReport));
+}
+
+void
+cut_teardown(void)
+{
+    unlink(filename);
+    memcheck_report_clear(&report);
+}
+
+static int
+parse(const char *str)
+{
+    FILE *fh = fopen(filename, "w+");
+    int res;
+
+    fputs(str, fh);
+    rewind(fh);
+    res = memcheck_parse(fh, &report);
+    fclose(fh);
+    return res;
+}
+
+static size_t
+parse_sanitizer(const char *str)
+{
+    FILE *fh = fopen(filename, "w+");
+    size_t res;
+
+    fputs(str, fh);
+    rewind(fh);
+    res = memcheck_parse_sanitizer(fh, &report);
+    fclose(fh);
+    return res;
+}
+
+#define HEADER "<?xml version=\"1.0\"?>\n<valgrindoutput>\n" \
+    "<protocolversion>4</protocolversion>\n<tool>memcheck</tool>\n"
+
+void
+test_no_errors(void)
+{
+    cut_assert_true(parse(HEADER "<errorcounts>\n</errorcounts>\n"
+                "</valgrindoutput>\n"));
+    cut_assert_equal_uint(0, report.len);
+    cut_assert_equal_int(0, report.total);
+    cut_assert_true(report.complete);
+}
+
+void
+test_errors(void)
+{
+    cut_assert_true(parse(HEADER
+        "<error>\n  <unique>0x0</unique>\n  <kind>InvalidRead</kind>\n"
+        "  <what>Invalid read of size 4</what>\n  <stack>\n"
+        "    <frame><ip>0x1</ip><obj>/bin/prog</obj><fn>get</fn>"
+        "<dir>/src</dir><file>a.c</file><line>5</line></frame>\n"
+        "    <frame><ip>0x2</ip><obj>/lib/libc.so</obj></frame>\n"
+        "  </stack>\n  <auxwhat>Address 0x0 is not stack'd</auxwhat>\n"
+        "  <stack><frame><fn>other</fn></frame></stack>\n</error>\n"
+        "<error>\n  <kind>Leak_DefinitelyLost</kind>\n  <xwhat>\n"
+        "    <text>8 bytes in 1 blocks are definitely lost</text>\n"
+        "    <leakedbytes>8</leakedbytes>\n  </xwhat>\n"
+        "  <stack><frame><fn>operator new&lt;int&gt;</fn>"
+        "<file>b.c</file><line>7</line></frame></stack>\n</error>\n"
+        "<errorcounts>\n  <pair><count>3</count><unique>0x0</unique>"
+        "</pair>\n</errorcounts>\n<suppcounts/>\n</valgrindoutput>\n"));
+
+    cut_assert_equal_uint(2, report.len);
+    cut_assert_equal_int(4, report.total);
+    cut_assert_equal_int(8, report.leaked_bytes);
+    cut_assert_equal_string("InvalidRead", report.errors[0].kind);
+    cut_assert_equal_string("Invalid read of size 4", report.errors[0].what);
+    cut_assert_equal_uint(2, report.errors[0].frame_num);
+    cut_assert_equal_string("get (a.c:5)", report.errors[0].frames[0]);
+    cut_assert_equal_string("??? (in /lib/libc.so)",
+            report.errors[0].frames[1]);
+    cut_assert_equal_string("8 bytes in 1 blocks are definitely lost",
+            report.errors[1].what);
+    cut_assert_equal_string("operator new<int> (b.c:7)",
+            report.errors[1].frames[0]);
+}
+
+void
+test_incomplete(void)
+{
+    cut_assert_true(parse(HEADER "<error><kind>InvalidFree</kind>"));
+    cut_assert_false(report.complete);
+    cut_assert_equal_uint(1, report.len);
+    cut_assert_equal_string("InvalidFree", report.errors[0].kind);
+}
+
+void
+test_not_xml(void)
+{
+    cut_assert_false(parse("==123== Memcheck, a memory error detector\n"));
+}
+
+void
+test_sanitizer_error(void)
+{
+    cut_assert_equal_uint(1, parse_sanitizer(
+        "=================================================================\n"
+        "==42==ERROR: AddressSanitizer: heap-buffer-overflow on address"
+        " 0x602 at pc 0x4c3 bp 0x7ff sp 0x7fe\n"
+        "READ of size 4 at 0x602 thread T0\n"
+        "    #0 0x4c3b1a in get /src/a.c:5:12\n"
+        "    #1 0x4c3c00 in main /src/a.c:9:3\n"
+        "    #2 0x7f00 (/lib/libc.so.6+0x21b96)\n\n"
+        "0x602 is located 0 bytes to the right of 4-byte region\n"
+        "allocated by thread T0 here:\n"
+        "    #0 0x494 in malloc (/bin/prog+0x494)\n\n"
+        "SUMMARY: AddressSanitizer: heap-buffer-overflow /src/a.c:5:12\n"));
+
+    cut_assert_equal_uint(1, report.len);
+    cut_assert_equal_int(1, report.total);
+    cut_assert_true(report.complete);
+    cut_assert_equal_string("heap-buffer-overflow", report.errors[0].kind);
+    cut_assert_equal_uint(3, report.errors[0].frame_num);
+    cut_assert_equal_string("get (/src/a.c:5:12)",
+            report.errors[0].frames[0]);
+    cut_assert_equal_string("??? (in /lib/libc.so.6+0x21b96)",
+            report.errors[0].frames[2]);
+}
+
+void
+test_sanitizer_leaks(void)
+{
+    cut_assert_equal_uint(2, parse_sanitizer(
+        "==7==ERROR: LeakSanitizer: detected memory leaks\n\n"
+        "Direct leak of 10 byte(s) in 1 object(s) allocated from:\n"
+        "    #0 0x494 in malloc (/bin/prog+0x494)\n"
+        "    #1 0x4c3 in main /src/a.c:3:5\n\n"
+        "Indirect leak of 6 byte(s) in 2 object(s) allocated from:\n"
+        "    #0 0x494 in strdup (/bin/prog+0x494)\n\n"
+        "SUMMARY: AddressSanitizer: 16 byte(s) leaked in 3 allocation(s).\n"));
+
+    cut_assert_equal_uint(2, report.len);
+    cut_assert_equal_int(2, report.total);
+    cut_assert_equal_int(16, report.leaked_bytes);
+    cut_assert_equal_string("direct-leak", report.errors[0].kind);
+    cut_assert_equal_int(10, report.errors[0].leaked_bytes);
+    cut_assert_equal_string("malloc (in /bin/prog+0x494)",
+            report.errors[0].frames[0]);
+    cut_assert_equal_string("indirect-leak", report.errors[1].kind);
+}
+
+void
+test_sanitizer_undefined(void)
+{
+    cut_assert_equal_uint(1, parse_sanitizer(
+        "/src/a.c:4:7: runtime error: signed integer overflow:"
+        " 2147483647 + 1 cannot be represented in type 'int'\n"
+        "    #0 0x4c3 in main /src/a.c:4:7\n"));
+
+    cut_assert_equal_uint(1, report.len);
+    cut_assert_equal_string("undefined-behavior", report.errors[0].kind);
+    cut_assert_equal_uint(2, report.errors[0].frame_num);
+    cut_assert_equal_string("??? (/src/a.c:4:7)", report.errors[0].frames[0]);
+}
+
+void
+test_sanitizer_undefined_printed(void)
+{
+    /* Only reports starting with a location count. */
+    cut_assert_equal_uint(0, parse_sanitizer(
+        "script.py: runtime error: name 'x' is not defined\n"
+        "Traceback: a.c:4:7: runtime error: shown by the program\n"
+        "a.c:x:7: runtime error: not a location\n"
+        "a.c:4: runtime error: no column\n"
+        ":4:7: runtime error: no file\n"));
+    cut_assert_equal_uint(0, report.len);
+}
+
+void
+test_sanitizer_clean(void)
+{
+    cut_assert_equal_uint(0, parse_sanitizer(""));
+    cut_assert_equal_uint(0, report.len);
+    cut_assert_true(report.complete);
+}
@@ -1,6 +1,7 @@
 #define _POSIX_C_SOURCE 200809L
 
 #include <cutter.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -147,3 +148,65 @@ test_push_formatted_many(void)
     cut_assert_equal_string("int 5\nstring foo\nanother string bar\nnext int 0",
             load_output());
 }
+
+void
+test_push_large(void)
+{
+    char *line = malloc(40000), *expected, *data;
+    size_t len;
+    int i;
+
+    memset(line, 'x', 39999);
+    line[39999] = '\0';
+    expected = str_printf("start\n%s\n%s%d\n", line, line, 42);
+    /* Both strings overflow the chunks they start in. */
+    oqueue_push(queue, "start\n");
+    oqueue_push(queue, line);
+    oqueue_pushf(queue, "\n%s%d\n", line, 42);
+    oqueue_flush(queue, output);
+    fflush(output);
+
+    data = read_file(filename, &len);
+    cut_assert_equal_memory(expected, strlen(expected), data, len);
+    free(data);
+
+    /* The queue is reused after flush. */
+    truncate(filename, 0);
+    rewind(output);
+    for (i = 0; i < 3; i++) {
+        oqueue_pushf(queue, "%d", i);
+    }
+    oqueue_flush(queue, output);
+    cut_assert_equal_string("012", load_output());
+
+    free(line);
+    free(expected);
+}
+
+void
+test_copy_large_from_fd(void)
+{
+    char *expected = malloc(100000), *data;
+    size_t len;
+    int fd;
+
+    memset(expected, 'y', 100000);
+    expected[500] = '\0';
+    fd = open(filename, O_WRONLY | O_TRUNC);
+    write(fd, expected, 100000);
+    close(fd);
+
+    fd = open(filename, O_RDONLY);
+    oqueue_push(queue, "in:");
+    oqueue_copy_from_fd(queue, fd);
+    close(fd);
+    truncate(filename, 0);
+    oqueue_flush(queue, output);
+
+    data = read_file(filename, &len);
+    cut_assert_equal_int(100003, len);
+    cut_assert_equal_memory("in:", 3, data, 3);
+    cut_assert_equal_memory(expected, 100000, data + 3, len - 3);
+    free(data);
+    free(expected);
+}
@@ -0,0 +1,170 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <cutter.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <pack.h>
+#include <test.h>
+#include <utils.h>
+
+char filename[] = "/tmp/cutter-tmp-file.XXXXXX";
+Pack *pack;
+List *tests;
+
+void
+cut_setup(void)
+{
+    int fd = mkstemp(filename);
+    close(fd);
+    pack = NULL;
+    tests = NULL;
+}
+
+void
+cut_teardown(void)
+{
+    unlink(filename);
+    pack_unref(pack);
+    list_destroy(tests, DESTROYFUNC(test_free));
+}
+
+static void
+write_pack(void)
+{
+    PackWriter *w = pack_writer_new(filename);
+
+    cut_assert_not_null(w);
+    pack_writer_add_test(w, "001_first");
+    pack_writer_add_part(w, 0, "input\n", 6);
+    pack_writer_add_part(w, 1, "output\n", 7);
+    pack_writer_add_part(w, 4, "3\n", 2);
+    pack_writer_add_test(w, "2_grp/001_empty");
+    pack_writer_add_part(w, 1, "", 0);
+    cut_assert_true(pack_writer_finish(w));
+}
+
+void
+test_pack_read(void)
+{
+    const char *data;
+    size_t len;
+
+    write_pack();
+    pack = pack_open(filename);
+    cut_assert_not_null(pack);
+    cut_assert_equal_uint(2, pack_get_test_num(pack));
+    cut_assert_equal_string("001_first", pack_get_name(pack, 0));
+    cut_assert_equal_int(TEST_INPUT | TEST_OUTPUT | TEST_RETVAL,
+            pack_get_parts(pack, 0));
+    data = pack_get_data(pack, 0, 1, &len);
+    cut_assert_equal_memory("output\n", 7, data, len);
+    cut_assert_null(pack_get_data(pack, 0, 2, &len));
+
+    cut_assert_equal_string("2_grp/001_empty", pack_get_name(pack, 1));
+    cut_assert_equal_int(TEST_OUTPUT, pack_get_parts(pack, 1));
+    cut_assert_not_null(pack_get_data(pack, 1, 1, &len));
+    cut_assert_equal_uint(0, len);
+}
+
+void
+test_pack_mode(void)
+{
+    struct stat info;
+    mode_t mask;
+
+    /* New packs get mode from umask, not the one of the temporary file. */
+    unlink(filename);
+    mask = umask(027);
+    write_pack();
+    umask(mask);
+    stat(filename, &info);
+    cut_assert_equal_int(0640, info.st_mode & 07777);
+}
+
+void
+test_pack_invalid(void)
+{
+    FILE *fh = fopen(filename, "w");
+
+    fputs("definitely not a pack, but long enough to contain a header\n", fh);
+    fclose(fh);
+    cut_assert_null(pack_open(filename));
+    cut_assert_null(pack_open("/nonexistent/pack"));
+}
+
+void
+test_pack_unsafe_names(void)
+{
+    const char *names[] = { "../001_up", "/tmp/001_abs", "1_grp/../../x",
+        "1_grp//001_x", "1_grp/./001_x", "1_grp/", "", NULL };
+    PackWriter *w;
+    int i;
+
+    for (i = 0; names[i] != NULL; i++) {
+        w = pack_writer_new(filename);
+        pack_writer_add_test(w, names[i]);
+        pack_writer_add_part(w, 1, "", 0);
+        cut_assert_true(pack_writer_finish(w));
+        cut_assert_null(pack_open(filename), cut_message("%s", names[i]));
+    }
+}
+
+void
+test_pack_tests(void)
+{
+    Test *test;
+    const char *data;
+    char buffer[16];
+    size_t len;
+    int fd;
+
+    write_pack();
+    tests = test_load_from_pack(filename);
+    cut_assert_equal_uint(2, list_length(tests));
+    test = tests->data;
+    cut_assert_equal_string("001_first", test->name);
+    cut_assert_equal_int(3, test_get_exit_code(test));
+    cut_assert_null(test_get_file_for_ext(test, EXT_OUTPUT));
+
+    data = test_get_data(test, EXT_OUTPUT, &len);
+    cut_assert_equal_memory("output\n", 7, data, len);
+    test_release_data(test, data, len);
+
+    fd = test_get_input_fd(test);
+    cut_assert_true(fd >= 0);
+    cut_assert_equal_int(6, read(fd, buffer, sizeof(buffer)));
+    close(fd);
+    cut_assert_equal_memory("input\n", 6, buffer, 6);
+}
+
+void
+test_pack_same_hash(void)
+{
+    char dir[] = "/tmp/cutter-tmp-dir.XXXXXX";
+    char path[64];
+    List *dir_tests;
+    FILE *fh;
+
+    write_pack();
+    tests = test_load_from_pack(filename);
+    mkdtemp(dir);
+    snprintf(path, sizeof(path), "%s/001_first.in", dir);
+    fh = fopen(path, "w"); fputs("input\n", fh); fclose(fh);
+    snprintf(path, sizeof(path), "%s/001_first.out", dir);
+    fh = fopen(path, "w"); fputs("output\n", fh); fclose(fh);
+    snprintf(path, sizeof(path), "%s/001_first.ret", dir);
+    fh = fopen(path, "w"); fputs("3\n", fh); fclose(fh);
+    dir_tests = test_load_from_dir(dir);
+
+    cut_assert_equal_uint(1, list_length(dir_tests));
+    cut_assert_true(test_hash_files(tests->data)
+            == test_hash_files(dir_tests->data));
+
+    list_destroy(dir_tests, DESTROYFUNC(test_free));
+    snprintf(path, sizeof(path), "rm -rf %s", dir);
+    system(path);
+}
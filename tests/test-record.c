@@ -0,0 +1,173 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <cutter.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <record.h>
+#include <utils.h>
+
+char inputs[] = "/tmp/cutter-tmp-dir.XXXXXX";
+char tests[] = "/tmp/cutter-tmp-dir.XXXXXX";
+
+static void
+create(const char *dir, const char *name, const char *content)
+{
+    char *path = str_printf("%s/%s", dir, name);
+    FILE *fh = fopen(path, "w");
+
+    fputs(content, fh);
+    fclose(fh);
+    free(path);
+}
+
+static char *
+content(const char *name)
+{
+    char *path = str_printf("%s/%s", tests, name), *data;
+    size_t len;
+
+    data = read_file(path, &len);
+    free(path);
+    return data;
+}
+
+void
+cut_setup(void)
+{
+    mkdtemp(inputs);
+    mkdtemp(tests);
+}
+
+void
+cut_teardown(void)
+{
+    char *cmd = str_printf("rm -rf %s %s", inputs, tests);
+
+    system(cmd);
+    free(cmd);
+    strcpy(inputs, "/tmp/cutter-tmp-dir.XXXXXX");
+    strcpy(tests, "/tmp/cutter-tmp-dir.XXXXXX");
+}
+
+void
+test_record_test_name(void)
+{
+    char *name;
+
+    name = record_test_name(7, "dir/Some File.txt");
+    cut_assert_equal_string("007_some_file", name);
+    free(name);
+    name = record_test_name(1234, "a.b.c");
+    cut_assert_equal_string("1234_a_b", name);
+    free(name);
+    name = record_test_name(1, ".hidden");
+    cut_assert_equal_string("001__hidden", name);
+    free(name);
+    name = record_test_name(2, " .x");
+    cut_assert_equal_string("002_input", name);
+    free(name);
+}
+
+void
+test_record_list_inputs(void)
+{
+    char **paths, *pattern;
+    size_t len;
+
+    create(inputs, "b.txt", "");
+    create(inputs, "a.txt", "");
+    create(inputs, "c.bin", "");
+    create(inputs, ".ignored", "");
+
+    paths = record_list_inputs(inputs, &len);
+    cut_assert_equal_uint(3, len);
+    cut_assert_true(strstr(paths[0], "/a.txt") != NULL);
+    cut_assert_true(strstr(paths[2], "/c.bin") != NULL);
+    cut_assert_null(paths[3]);
+    str_array_free(paths);
+
+    pattern = str_printf("%s/*.txt", inputs);
+    paths = record_list_inputs(pattern, &len);
+    cut_assert_equal_uint(2, len);
+    cut_assert_true(strstr(paths[1], "/b.txt") != NULL);
+    str_array_free(paths);
+    free(pattern);
+
+    pattern = str_printf("%s/*.none", inputs);
+    cut_assert_null(record_list_inputs(pattern, &len));
+    free(pattern);
+}
+
+void
+test_record_tests(void)
+{
+    char **paths, *data;
+    size_t len;
+
+    create(inputs, "one", "1\n");
+    create(inputs, "two", "2\n");
+    create(tests, "003_old.in", "");
+    paths = record_list_inputs(inputs, &len);
+    cut_assert_true(record_tests("/bin/cat", "-", paths, len, tests, 2,
+                RECORD_TIMEOUT));
+    str_array_free(paths);
+
+    data = content("004_one.out");
+    cut_assert_equal_string("1\n", data);
+    free(data);
+    data = content("005_two.in");
+    cut_assert_equal_string("2\n", data);
+    free(data);
+    data = content("005_two.err");
+    cut_assert_equal_string("", data);
+    free(data);
+    data = content("005_two.ret");
+    cut_assert_equal_string("0\n", data);
+    free(data);
+    data = content("005_two.args");
+    cut_assert_equal_string("-\n", data);
+    free(data);
+}
+
+void
+test_record_path_lookup(void)
+{
+    char **paths, *data;
+    size_t len;
+
+    create(inputs, "one", "1\n");
+    paths = record_list_inputs(inputs, &len);
+    cut_assert_true(record_tests("cat", NULL, paths, len, tests, 1,
+                RECORD_TIMEOUT));
+    str_array_free(paths);
+
+    data = content("001_one.out");
+    cut_assert_equal_string("1\n", data);
+    free(data);
+}
+
+void
+test_record_timeout(void)
+{
+    char **paths, *data;
+    double start;
+    size_t len;
+
+    create(inputs, "1_quick", "0\n");
+    create(inputs, "2_hangs", "30\n");
+    paths = record_list_inputs(inputs, &len);
+    /* The child of the shell must be killed as well. */
+    start = monotonic_time();
+    cut_assert_false(record_tests("/bin/sh", "-c 'read x; sleep $x'", paths,
+                len, tests, 2, 0.3));
+    cut_assert_true(monotonic_time() - start < 10);
+    str_array_free(paths);
+
+    data = content("001_1_quick.ret");
+    cut_assert_equal_string("0\n", data);
+    free(data);
+    cut_assert_null(content("002_2_hangs.ret"));
+}
@@ -0,0 +1,159 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <cutter.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <reporter.h>
+#include <utils.h>
+
+char filename[] = "/tmp/cutter-tmp-file.XXXXXX";
+char *output;
+TestResult result;
+Test test;
+
+void
+cut_setup(void)
+{
+    int fd = mkstemp(filename);
+    close(fd);
+    memset(&result, 0, sizeof(TestResult));
+    memset(&test, 0, sizeof(Test));
+    test.name = "001_test \"quoted\"";
+    output = NULL;
+}
+
+void
+cut_teardown(void)
+{
+    unlink(filename);
+    test_result_clear(&result);
+    free(output);
+}
+
+/**
+ * Report one result in given format and load the output.
+ */
+static const char *
+report(const char *format)
+{
+    char spec[64];
+    size_t len;
+    Reporter *r;
+
+    snprintf(spec, sizeof(spec), "%s:%s", format, filename);
+    r = reporter_new(spec);
+    cut_assert_not_null(r);
+    reporter_begin(r, 1);
+    reporter_add(r, &result);
+    reporter_end(r, 1.5);
+    reporter_free(r);
+
+    output = read_file(filename, &len);
+    return output;
+}
+
+void
+test_result_status(void)
+{
+    test_result_reset(&result, &test);
+    cut_assert_equal_int(RESULT_PASSED, result.status);
+    test_result_add_check(&result, "out", 1, NULL);
+    cut_assert_equal_int(RESULT_PASSED, result.status);
+    test_result_add_check(&result, "ret", 0, "expected exit code 1\n\n");
+    cut_assert_equal_int(RESULT_FAILED, result.status);
+    cut_assert_equal_uint(2, result.check_num);
+    cut_assert_equal_string("expected exit code 1", result.checks[1].message);
+}
+
+void
+test_bad_spec(void)
+{
+    cut_assert_null(reporter_new("xml:file"));
+    cut_assert_null(reporter_new("jsonl"));
+    cut_assert_null(reporter_new("jsonl:"));
+}
+
+void
+test_jsonl(void)
+{
+    test_result_reset(&result, &test);
+    test_result_add_check(&result, "out", 0, "stdout differs")->diff_lines = 4;
+    cut_assert_equal_string(
+            "{\"type\":\"start\",\"tests\":1}\n"
+            "{\"type\":\"test\",\"name\":\"001_test \\\"quoted\\\"\","
+            "\"status\":\"failed\",\"checks\":[{\"name\":\"out\","
+            "\"passed\":false,\"message\":\"stdout differs\","
+            "\"diff_lines\":4}]}\n"
+            "{\"type\":\"summary\",\"passed\":0,\"failed\":1,\"crashed\":0,"
+            "\"timeout\":0,\"skipped\":0,\"cached\":0,\"checks\":1,"
+            "\"failed_checks\":1,\"time\":1.500}\n",
+            report("jsonl"));
+}
+
+void
+test_tap_skip(void)
+{
+    test_result_reset(&result, &test);
+    result.status = RESULT_SKIPPED;
+    result.reason = strdup("can not execute command");
+    cut_assert_equal_string(
+            "TAP version 13\n1..1\n"
+            "ok 1 - 001_test \"quoted\" # SKIP can not execute command\n"
+            "# 1.500 seconds\n",
+            report("tap"));
+}
+
+void
+test_junit_escaping(void)
+{
+    test_result_reset(&result, &test);
+    result.status = RESULT_CRASHED;
+    result.reason = strdup("<signal> & more");
+    cut_assert_equal_string(
+            "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+            "<testsuite name=\"stest\" tests=\"1\">\n"
+            "  <testcase classname=\"stest\" name=\"001_test &quot;quoted&quot;\""
+            " time=\"0.000000\">\n"
+            "    <error type=\"crashed\" message=\"&lt;signal&gt; &amp; more\"/>\n"
+            "  </testcase>\n"
+            "  <!-- 0 failures, 1 errors, 0 skipped, 1.500 seconds -->\n"
+            "</testsuite>\n",
+            report("junit"));
+}
+
+void
+test_summary_merge(void)
+{
+    ReportSummary sum = { 0 };
+    FILE *fh;
+
+    test_result_reset(&result, &test);
+    result.status = RESULT_CRASHED;
+    free(output);
+    output = NULL;
+    report("jsonl");
+    cut_assert_true(report_summary_merge(&sum, filename));
+
+    test_result_reset(&result, &test);
+    test_result_add_check(&result, "out", 1, NULL);
+    test_result_add_check(&result, "ret", 0, NULL);
+    free(output);
+    output = NULL;
+    report("jsonl");
+    cut_assert_true(report_summary_merge(&sum, filename));
+
+    cut_assert_equal_uint(2, sum.tests);
+    cut_assert_equal_uint(1, sum.crashed);
+    cut_assert_equal_uint(2, sum.checks);
+    cut_assert_equal_uint(1, sum.failed);
+    cut_assert_equal_double(1.5, 0.0001, sum.time);
+
+    fh = fopen(filename, "w");
+    fputs("TAP version 13\n", fh);
+    fclose(fh);
+    cut_assert_false(report_summary_merge(&sum, filename));
+    cut_assert_false(report_summary_merge(&sum, "/nonexistent/report"));
+}
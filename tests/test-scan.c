@@ -0,0 +1,130 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <cutter.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <scan.h>
+
+#define BUF_SIZE (300 * 32 + 100)
+char a[BUF_SIZE], b[BUF_SIZE];
+ScanLevel best;
+
+void
+cut_setup(void)
+{
+    size_t i;
+
+    best = scan_get_level();
+    srand(42);
+    for (i = 0; i < BUF_SIZE; i++) {
+        a[i] = rand() % 4 == 0 ? '\n' : 'a' + rand() % 26;
+    }
+    memcpy(b, a, BUF_SIZE);
+}
+
+void
+cut_teardown(void)
+{
+    scan_set_level(best);
+}
+
+static size_t
+naive_count(const char *buf, size_t len)
+{
+    size_t i, num = 0;
+
+    for (i = 0; i < len; i++) {
+        if (buf[i] == '\n') num++;
+    }
+    return num;
+}
+
+/* Lengths around vector sizes and the counter overflow. */
+static const size_t lengths[] = {
+    0, 1, 15, 16, 17, 31, 32, 33, 63, 64, 65, 255 * 16, 255 * 16 + 1,
+    255 * 32, 255 * 32 + 31, BUF_SIZE - 3
+};
+#define NUM_LENGTHS (sizeof(lengths) / sizeof(lengths[0]))
+
+void
+test_scan_levels(void)
+{
+    cut_assert_true(scan_set_level(SCAN_SCALAR));
+    cut_assert_equal_int(SCAN_SCALAR, scan_get_level());
+    cut_assert_false(scan_set_level(SCAN_LEVELS));
+    cut_assert_equal_string("scalar", scan_level_name(SCAN_SCALAR));
+    cut_assert_equal_string("avx2", scan_level_name(SCAN_AVX2));
+}
+
+void
+test_scan_count_newlines(void)
+{
+    size_t i, offset;
+    int level;
+
+    memset(b, '\n', BUF_SIZE);
+    for (level = 0; level < SCAN_LEVELS; level++) {
+        if (!scan_set_level(level)) continue;
+        for (i = 0; i < NUM_LENGTHS; i++) {
+            for (offset = 0; offset < 3; offset++) {
+                cut_assert_equal_int(naive_count(a + offset, lengths[i]),
+                        scan_count_newlines(a + offset, lengths[i]));
+                /* Every byte counted would overflow byte counters. */
+                cut_assert_equal_int(lengths[i],
+                        scan_count_newlines(b + offset, lengths[i]));
+            }
+        }
+    }
+}
+
+void
+test_scan_first_difference(void)
+{
+    size_t i, pos;
+    int level;
+
+    for (level = 0; level < SCAN_LEVELS; level++) {
+        if (!scan_set_level(level)) continue;
+        for (i = 0; i < NUM_LENGTHS; i++) {
+            cut_assert_equal_int(lengths[i],
+                    scan_first_difference(a + 1, b + 1, lengths[i]));
+            for (pos = 0; pos < lengths[i]; pos += 1 + pos / 3) {
+                b[pos + 1] ^= 0x80;
+                cut_assert_equal_int(pos,
+                        scan_first_difference(a + 1, b + 1, lengths[i]));
+                b[pos + 1] ^= 0x80;
+            }
+        }
+    }
+}
+
+void
+test_scan_equal_ignoring_space(void)
+{
+    const char *text = "  int main(void)\n{\treturn 0; }\n";
+    const char *spaced = "int  main ( void )\n\n{ return 0;}";
+    int level;
+
+    for (level = 0; level < SCAN_LEVELS; level++) {
+        if (!scan_set_level(level)) continue;
+        cut_assert_true(scan_equal_ignoring_space("", 0, "", 0));
+        cut_assert_true(scan_equal_ignoring_space("", 0, " \n\t", 3));
+        cut_assert_true(scan_equal_ignoring_space(text, strlen(text),
+                    spaced, strlen(spaced)));
+        cut_assert_false(scan_equal_ignoring_space("ab", 2, "a", 1));
+        cut_assert_false(scan_equal_ignoring_space("a b", 3, "a c", 3));
+        cut_assert_false(scan_equal_ignoring_space("a", 1, "a x ", 4));
+
+        /* Space in the middle of long equal parts. */
+        memmove(b + 2001, b + 2000, BUF_SIZE - 2001);
+        b[2000] = ' ';
+        cut_assert_true(scan_equal_ignoring_space(a, BUF_SIZE - 1,
+                    b, BUF_SIZE));
+        b[5000] = b[5000] == 'x' ? 'y' : 'x';
+        cut_assert_false(scan_equal_ignoring_space(a, BUF_SIZE - 1,
+                    b, BUF_SIZE));
+        memcpy(b, a, BUF_SIZE);
+    }
+}
@@ -0,0 +1,99 @@
+#include <cutter.h>
+
+#include <stats.h>
+
+void
+test_percentile(void)
+{
+    double samples[] = { 1, 2, 3, 4, 5 };
+    cut_assert_equal_double(1, 0.0001, stats_percentile(samples, 5, 0));
+    cut_assert_equal_double(3, 0.0001, stats_percentile(samples, 5, 50));
+    cut_assert_equal_double(4.8, 0.0001, stats_percentile(samples, 5, 95));
+    cut_assert_equal_double(5, 0.0001, stats_percentile(samples, 5, 100));
+}
+
+void
+test_percentile_single(void)
+{
+    double samples[] = { 7 };
+    cut_assert_equal_double(7, 0.0001, stats_percentile(samples, 1, 50));
+    cut_assert_equal_double(7, 0.0001, stats_percentile(samples, 1, 95));
+}
+
+void
+test_drop_outliers(void)
+{
+    double samples[] = { 10, 11, 100, 12, 10, 11, 0.1 };
+    size_t len = stats_drop_outliers(samples, 7);
+    cut_assert_equal_uint(5, len);
+    cut_assert_equal_double(10, 0.0001, samples[0]);
+    cut_assert_equal_double(12, 0.0001, samples[4]);
+}
+
+void
+test_drop_outliers_few_samples(void)
+{
+    double samples[] = { 100, 1, 2 };
+    cut_assert_equal_uint(3, stats_drop_outliers(samples, 3));
+    cut_assert_equal_double(1, 0.0001, samples[0]);
+    cut_assert_equal_double(100, 0.0001, samples[2]);
+}
+
+void
+test_compute(void)
+{
+    double samples[] = { 4, 2, 5, 1, 3 };
+    Stats st;
+    stats_compute(samples, 5, &st);
+    cut_assert_equal_uint(5, st.n);
+    cut_assert_equal_double(1, 0.0001, st.min);
+    cut_assert_equal_double(3, 0.0001, st.median);
+    cut_assert_equal_double(3, 0.0001, st.mean);
+    cut_assert_equal_double(4.8, 0.0001, st.p95);
+    cut_assert_equal_double(1.5811, 0.0001, st.stddev);
+}
+
+void
+test_compute_empty(void)
+{
+    Stats st;
+    stats_compute(NULL, 0, &st);
+    cut_assert_equal_uint(0, st.n);
+    cut_assert_equal_double(0, 0.0001, st.mean);
+}
+
+void
+test_mann_whitney_same(void)
+{
+    double a[] = { 1, 2, 3, 4, 5 };
+    cut_assert_equal_double(1, 0.0001, stats_mann_whitney(a, 5, a, 5));
+}
+
+void
+test_mann_whitney_different(void)
+{
+    double a[] = { 1.1, 2.2, 3.3, 4.4, 5.5, 6.6, 7.7, 8.8 };
+    double b[] = { 5, 6, 7, 8, 9, 10, 11, 12, 13 };
+    cut_assert_equal_double(0.014138, 0.000001,
+            stats_mann_whitney(a, 8, b, 9));
+    cut_assert_equal_double(0.014138, 0.000001,
+            stats_mann_whitney(b, 9, a, 8));
+}
+
+void
+test_mann_whitney_ties(void)
+{
+    double a[] = { 1, 1, 1, 2, 2 };
+    double b[] = { 1, 2, 2, 3, 3 };
+    cut_assert_equal_double(0.146100, 0.000001,
+            stats_mann_whitney(a, 5, b, 5));
+}
+
+void
+test_mann_whitney_constant(void)
+{
+    double a[] = { 1, 1, 1 };
+    double b[] = { 1, 1 };
+    cut_assert_equal_double(1, 0.0001, stats_mann_whitney(a, 3, b, 2));
+    cut_assert_equal_double(1, 0.0001, stats_mann_whitney(a, 3, b, 0));
+}
@@ -1,5 +1,7 @@
 #include <cutter.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <utils.h>
 
@@ -52,6 +54,11 @@ test_get_test_part_ok(void)
     cut_assert_equal_uint(TEST_ERRORS, get_test_part("001_file.err"));
     cut_assert_equal_uint(TEST_ARGS, get_test_part("001_file.args"));
     cut_assert_equal_uint(TEST_RETVAL, get_test_part("001_file.ret"));
+    cut_assert_equal_uint(TEST_TIMEOUT, get_test_part("001_file.timeout"));
+    cut_assert_equal_uint(TEST_TIME, get_test_part("001_file.time"));
+    cut_assert_equal_uint(TEST_RSS, get_test_part("001_file.rss"));
+    cut_assert_equal_uint(TEST_OUTPUT_LIMIT,
+            get_test_part("001_file.outlimit"));
 }
 
 void
@@ -129,6 +136,62 @@ test_count_lines_on_fd_more_lines(void)
     close(from[PIPE_READ]);
 }
 
+void
+test_read_file(void)
+{
+    char filename[] = "/tmp/cutter-tmp-file.XXXXXX";
+    int fd = mkstemp(filename);
+    size_t len = 42;
+    char *data;
+
+    data = read_file(filename, &len);
+    cut_assert_equal_string("", data);
+    cut_assert_equal_uint(0, len);
+    free(data);
+
+    write_data(fd, "foo\nbar\n");
+    close(fd);
+    data = read_file(filename, &len);
+    cut_assert_equal_string("foo\nbar\n", data);
+    cut_assert_equal_uint(8, len);
+    free(data);
+
+    unlink(filename);
+    cut_assert_null(read_file(filename, &len));
+}
+
+void
+test_write_file(void)
+{
+    char filename[] = "/tmp/cutter-tmp-file.XXXXXX";
+    int fd = mkstemp(filename);
+    struct stat info;
+    mode_t mask;
+    size_t len;
+    char *data;
+
+    close(fd);
+    chmod(filename, 0640);
+    cut_assert_true(write_file(filename, "new\n", 4));
+    data = read_file(filename, &len);
+    cut_assert_equal_string("new\n", data);
+    free(data);
+    stat(filename, &info);
+    cut_assert_equal_int(0640, info.st_mode & 07777);
+
+    /* New files get mode from umask. */
+    unlink(filename);
+    mask = umask(027);
+    cut_assert_true(write_file(filename, "", 0));
+    umask(mask);
+    stat(filename, &info);
+    cut_assert_equal_int(0640, info.st_mode & 07777);
+
+    unlink(filename);
+    strcat(filename, "/missing");
+    cut_assert_false(write_file(filename, "", 0));
+}
+
 void
 test_parse_args_single(void)
 {
@@ -292,6 +355,20 @@ test_parse_args_len(void)
     }
 }
 
+void
+test_parse_size(void)
+{
+    cut_assert_equal_int(0, parse_size("0"));
+    cut_assert_equal_int(100, parse_size("100\n"));
+    cut_assert_equal_int(2048, parse_size("2K"));
+    cut_assert_equal_int(1536 * 1024, parse_size("1.5m"));
+    cut_assert_true(parse_size("1G") == 1024LL * 1024 * 1024);
+    cut_assert_equal_int(-1, parse_size(""));
+    cut_assert_equal_int(-1, parse_size("-1"));
+    cut_assert_equal_int(-1, parse_size("10 KB"));
+    cut_assert_equal_int(-1, parse_size("many"));
+}
+
 void
 test_timersub(void)
 {